@@ -0,0 +1,906 @@
+/**
+ * @file
+ * @brief Throughput benchmark of the BER TLV lib over synthetic corpora
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ber_tlv.h"
+#include "ber_tlv_stream.h"
+#include "ber_tlv_schema.h"
+#include "ber_tlv_batch.h"
+#include "ber_tlv_builder.h"
+#include "ber_tlv_soa.h"
+#include "ber_tlv_cache.h"
+#include "ber_tlv_extract.h"
+#if defined(__linux__)
+#include <unistd.h>
+#include "ber_tlv_file.h"
+#include "ber_tlv_pipeline.h"
+#endif
+
+//! Default size of each corpus in KiB
+#define DEFAULT_CORPUS_SIZE_KIB 2048
+//! Default number of measured repetitions
+#define DEFAULT_REPETITIONS 20
+//! Default number of warmup repetitions
+#define DEFAULT_WARMUP 3
+//! Size of the chunks fed to the stream parser, a typical TCP segment
+#define STREAM_CHUNK_SIZE 1460
+//! Size of the printer sink buffer
+#define PRINT_BUFFER_SIZE (64 * 1024)
+//! Size of the read buffers of the pipeline, larger than the split records
+#define PIPELINE_BUFFER_SIZE (128 * 1024)
+//! Number of buffers of the pipeline pool
+#define PIPELINE_BUFFER_COUNT 16
+//! Memory budget of the cache, larger than the index and text of a corpus
+#define CACHE_BUDGET (512 * 1024 * 1024)
+
+/**
+ * @brief Synthetic corpus
+ */
+typedef struct
+{
+    //! Corpus name
+    const char *name;
+    //! Raw data
+    uint8_t *data;
+    //! Data size in bytes
+    size_t size;
+    //! Number of objects, at any nesting level
+    size_t objCount;
+    //! Offset of each top-level record
+    size_t *records;
+    //! Number of top-level records
+    size_t recordCount;
+} TBenchCorpus;
+
+/**
+ * @brief Benchmarked operation
+ */
+typedef struct
+{
+    //! Operation name
+    const char *name;
+    //! Run the operation once over the whole corpus, returns a value that must not be optimized out
+    size_t (*run)(TBenchCorpus *corpus);
+} TBenchOp;
+
+//! State of the random generator of the corpora
+static uint64_t randomState = 0x2545F4914F6CDD1DULL;
+
+//! Index used by the operations
+static TBerTlvIndex benchIndex;
+//! Tag table of benchIndex, used per record
+static size_t benchTagTable[64];
+//! Struct of arrays index used by the operations
+static TBerTlvSoaIndex benchSoaIndex;
+//! Cache of the records of the corpora, the passes after the warmup find every record in it
+static TBerTlvCache benchCache;
+
+//------------------------------------------------Static fuctions declaration----------------------------------------------------//
+static uint32_t __random(uint32_t max);
+static size_t __putHeader(uint8_t *buf, uint16_t tag, size_t valueSize);
+static size_t __putPrimitive(uint8_t *buf, uint16_t tag, size_t valueSize);
+static size_t __putPadding(uint8_t *buf, size_t size);
+static size_t __putNested(uint8_t *buf, uint16_t depth, uint16_t maxDepth);
+static size_t __genEmvRecord(uint8_t *buf);
+static size_t __genDeepRecord(uint8_t *buf);
+static size_t __genTwoBytesTagsRecord(uint8_t *buf);
+static size_t __genLongLengthsRecord(uint8_t *buf);
+static size_t __genPaddedRecord(uint8_t *buf);
+static void __buildCorpus(TBenchCorpus *corpus, const char *name, size_t size, size_t (*genRecord)(uint8_t *buf));
+static size_t __opParse(TBenchCorpus *corpus);
+static size_t __opIndex(TBenchCorpus *corpus);
+static size_t __opValidate(TBenchCorpus *corpus);
+static size_t __opBatchIndex(TBenchCorpus *corpus);
+static size_t __opFind(TBenchCorpus *corpus);
+static size_t __opSoaIndex(TBenchCorpus *corpus);
+static size_t __opIndexScan(TBenchCorpus *corpus);
+static size_t __opSoaScan(TBenchCorpus *corpus);
+static size_t __opSchema(TBenchCorpus *corpus);
+static size_t __opExtract(TBenchCorpus *corpus);
+static size_t __opIterSkip(TBenchCorpus *corpus);
+static size_t __opIterRoute(TBenchCorpus *corpus);
+static size_t __opBuild(TBenchCorpus *corpus);
+static size_t __opPrint(TBenchCorpus *corpus);
+static size_t __opPrintJson(TBenchCorpus *corpus);
+static size_t __opCacheIndex(TBenchCorpus *corpus);
+static size_t __opCachePrint(TBenchCorpus *corpus);
+static size_t __opStream(TBenchCorpus *corpus);
+#if defined(__linux__)
+static size_t __opFile(TBenchCorpus *corpus);
+static size_t __opPipeline(TBenchCorpus *corpus);
+static size_t __opPipelineEpoll(TBenchCorpus *corpus);
+static size_t __runPipeline(TBenchCorpus *corpus, bool useIoUring);
+static FILE *__corpusFile(TBenchCorpus *corpus);
+static bool __countIndexed(void *userData, size_t source, size_t streamOffset, EBerTlvError error,
+                           const TBerTlvIndex *index);
+#endif
+static bool __discardWrite(void *userData, const char *str, size_t size);
+static bool __countObject(void *userData, EBerTlvStreamEvent event, const TBerTlvObj *tlvObj, size_t depth);
+static double __now(void);
+static int __compareDouble(const void *a, const void *b);
+static void __runOp(const TBenchOp *op, TBenchCorpus *corpus, int warmup, int repetitions);
+
+//! EMV tags of the flat records, as found in an authorization request
+static const uint16_t EMV_TAGS[] = {0x5A, 0x57, 0x9F02, 0x9F03, 0x82, 0x95, 0x9A, 0x9C, 0x5F2A,
+                                    0x9F1A, 0x9F26, 0x9F27, 0x9F36, 0x9F37, 0x9F10, 0x84};
+//! Value sizes of EMV_TAGS
+static const uint8_t EMV_SIZES[] = {8, 19, 6, 6, 2, 5, 3, 1, 2, 2, 8, 1, 2, 4, 18, 7};
+//! Number of EMV tags
+#define EMV_TAG_COUNT (sizeof(EMV_TAGS) / sizeof(EMV_TAGS[0]))
+
+//! Schema of the flat EMV records
+#define BENCH_EMV_SCHEMA(X)                                            \
+    X(pan, 0x5A, BER_TLV_CLASS_APPLICATION, false, 10)                 \
+    X(track2, 0x57, BER_TLV_CLASS_APPLICATION, false, 19)              \
+    X(amount, 0x9F02, BER_TLV_CLASS_CONTEXT_SPECIFIC, false, 6)        \
+    X(amountOther, 0x9F03, BER_TLV_CLASS_CONTEXT_SPECIFIC, false, 6)   \
+    X(aip, 0x82, BER_TLV_CLASS_CONTEXT_SPECIFIC, false, 2)             \
+    X(tvr, 0x95, BER_TLV_CLASS_CONTEXT_SPECIFIC, false, 5)             \
+    X(date, 0x9A, BER_TLV_CLASS_CONTEXT_SPECIFIC, false, 3)            \
+    X(type, 0x9C, BER_TLV_CLASS_CONTEXT_SPECIFIC, false, 1)            \
+    X(currency, 0x5F2A, BER_TLV_CLASS_APPLICATION, false, 2)           \
+    X(country, 0x9F1A, BER_TLV_CLASS_CONTEXT_SPECIFIC, false, 2)       \
+    X(cryptogram, 0x9F26, BER_TLV_CLASS_CONTEXT_SPECIFIC, false, 8)    \
+    X(cid, 0x9F27, BER_TLV_CLASS_CONTEXT_SPECIFIC, false, 1)           \
+    X(atc, 0x9F36, BER_TLV_CLASS_CONTEXT_SPECIFIC, false, 2)           \
+    X(unpredictable, 0x9F37, BER_TLV_CLASS_CONTEXT_SPECIFIC, false, 4) \
+    X(iad, 0x9F10, BER_TLV_CLASS_CONTEXT_SPECIFIC, false, 32)          \
+    X(aid, 0x84, BER_TLV_CLASS_CONTEXT_SPECIFIC, false, 16)
+
+BER_TLV_SCHEMA_DEFINE(BENCH_EMV_SCHEMA, TBenchEmvFields, __benchEmvExtract)
+
+//! Benchmarked operations
+static const TBenchOp BENCH_OPS[] = {
+    {"parse", __opParse},
+    {"index", __opIndex},
+    {"validate", __opValidate},
+    {"batch", __opBatchIndex},
+    {"index+find", __opFind},
+    {"soa", __opSoaIndex},
+    {"index-scan", __opIndexScan},
+    {"soa-scan", __opSoaScan},
+    {"schema", __opSchema},
+    {"extract", __opExtract},
+    {"iter-skip", __opIterSkip},
+    {"iter-route", __opIterRoute},
+    {"build", __opBuild},
+    {"print", __opPrint},
+    {"print-json", __opPrintJson},
+    {"cache-index", __opCacheIndex},
+    {"cache-print", __opCachePrint},
+    {"stream", __opStream},
+#if defined(__linux__)
+    {"file", __opFile},
+    {"pipeline", __opPipeline},
+    {"pipeline-epoll", __opPipelineEpoll},
+#endif
+};
+
+int main(int argc, char **argv)
+{
+    int repetitions = argc > 1 ? atoi(argv[1]) : DEFAULT_REPETITIONS;
+    size_t corpusSize = (argc > 2 ? (size_t)atoi(argv[2]) : DEFAULT_CORPUS_SIZE_KIB) * 1024;
+    const char *filter = argc > 3 ? argv[3] : NULL;
+
+    if (repetitions <= 0 || corpusSize == 0)
+    {
+        printf("Usage: %s [repetitions] [corpus size in KiB] [operation]\n", argv[0]);
+        return 1;
+    }
+
+    TBenchCorpus corpora[5];
+    __buildCorpus(&corpora[0], "flat EMV", corpusSize, __genEmvRecord);
+    __buildCorpus(&corpora[1], "deep nesting", corpusSize, __genDeepRecord);
+    __buildCorpus(&corpora[2], "2-byte tags", corpusSize, __genTwoBytesTagsRecord);
+    __buildCorpus(&corpora[3], "long lengths", corpusSize, __genLongLengthsRecord);
+    __buildCorpus(&corpora[4], "heavy padding", corpusSize, __genPaddedRecord);
+
+    size_t maxObjCount = 0;
+    for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); ++i)
+    {
+        if (corpora[i].objCount > maxObjCount)
+            maxObjCount = corpora[i].objCount;
+    }
+    // Twice the objects, so that the per-thread shares of berTlv_batchIndex() don't run out of space
+    berTlv_indexInit(&benchIndex, malloc(2 * maxObjCount * sizeof(TBerTlvIndexEntry)), 2 * maxObjCount);
+    berTlv_soaInit(&benchSoaIndex, malloc(maxObjCount * sizeof(uint32_t)), malloc(maxObjCount * sizeof(uint32_t)),
+                   malloc(maxObjCount * sizeof(uint32_t)), malloc(maxObjCount * sizeof(uint16_t)), maxObjCount);
+
+    // An index and a text entry for each record of the corpora
+    size_t cacheEntryCount = 0;
+    for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); ++i)
+    {
+        cacheEntryCount += 2 * corpora[i].recordCount;
+    }
+    size_t cacheBucketCount = 1;
+    while (cacheBucketCount < cacheEntryCount)
+    {
+        cacheBucketCount *= 2;
+    }
+    berTlv_cacheInit(&benchCache, malloc(cacheEntryCount * sizeof(TBerTlvCacheEntry)), cacheEntryCount,
+                     malloc(cacheBucketCount * sizeof(size_t)), cacheBucketCount, CACHE_BUDGET);
+
+    printf("%-14s %-11s %9s %10s %12s %10s %10s %10s\n",
+           "corpus", "operation", "size KiB", "MB/s", "objects/s", "p50 us", "p90 us", "p99 us");
+
+    for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); ++i)
+    {
+        for (size_t j = 0; j < sizeof(BENCH_OPS) / sizeof(BENCH_OPS[0]); ++j)
+        {
+            if (filter && strcmp(filter, BENCH_OPS[j].name))
+                continue;
+            __runOp(&BENCH_OPS[j], &corpora[i], DEFAULT_WARMUP, repetitions);
+        }
+    }
+    return 0;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Corpora generation----------------------------------------------------//
+
+/**
+ * @brief Xorshift random number in [0, max)
+ */
+static uint32_t __random(uint32_t max)
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return (uint32_t)(randomState >> 32) % max;
+}
+
+/**
+ * @brief Write a tag and a length field using the shortest length form.
+ * @return Header size in bytes.
+ */
+static size_t __putHeader(uint8_t *buf, uint16_t tag, size_t valueSize)
+{
+    uint8_t *bufP = buf;
+    uint8_t lengthBytes = 0;
+
+    if (tag > 0xFF)
+        *bufP++ = tag >> 8;
+    *bufP++ = tag & 0xFF;
+
+    if (valueSize < 0x80)
+    {
+        *bufP++ = valueSize;
+        return bufP - buf;
+    }
+    for (size_t v = valueSize; v; v >>= 8)
+    {
+        lengthBytes++;
+    }
+    *bufP++ = 0x80 | lengthBytes;
+    while (lengthBytes--)
+    {
+        *bufP++ = (valueSize >> (8 * lengthBytes)) & 0xFF;
+    }
+    return bufP - buf;
+}
+
+/**
+ * @brief Write a primitive object with a random value.
+ * @return Object size in bytes.
+ */
+static size_t __putPrimitive(uint8_t *buf, uint16_t tag, size_t valueSize)
+{
+    size_t headerSize = __putHeader(buf, tag, valueSize);
+    for (size_t i = 0; i < valueSize; ++i)
+    {
+        buf[headerSize + i] = __random(256);
+    }
+    return headerSize + valueSize;
+}
+
+/**
+ * @brief Write a run of garbage data.
+ */
+static size_t __putPadding(uint8_t *buf, size_t size)
+{
+    memset(buf, __random(2) ? 0x00 : 0xFF, size);
+    return size;
+}
+
+/**
+ * @brief Write a constructed object holding primitives and, up to maxDepth, other constructed objects.
+ */
+static size_t __putNested(uint8_t *buf, uint16_t depth, uint16_t maxDepth)
+{
+    uint8_t value[4096];
+    size_t valueSize = 0;
+    int children = 2 + __random(3);
+
+    for (int i = 0; i < children; ++i)
+    {
+        if (depth < maxDepth && i == 1)
+            valueSize += __putNested(value + valueSize, depth + 1, maxDepth);
+        else
+            valueSize += __putPrimitive(value + valueSize, 0xC1 + i, 1 + __random(8));
+    }
+    size_t headerSize = __putHeader(buf, 0xE1, valueSize);
+    memcpy(buf + headerSize, value, valueSize);
+    return headerSize + valueSize;
+}
+
+/**
+ * @brief READ RECORD like template (0x70) with the usual EMV fields.
+ */
+static size_t __genEmvRecord(uint8_t *buf)
+{
+    uint8_t value[512];
+    size_t valueSize = 0;
+
+    for (size_t i = 0; i < EMV_TAG_COUNT; ++i)
+    {
+        valueSize += __putPrimitive(value + valueSize, EMV_TAGS[i], EMV_SIZES[i]);
+    }
+    size_t headerSize = __putHeader(buf, 0x70, valueSize);
+    memcpy(buf + headerSize, value, valueSize);
+    return headerSize + valueSize;
+}
+
+/**
+ * @brief Constructed objects nested 16 levels deep, as in certificates and issuer scripts.
+ */
+static size_t __genDeepRecord(uint8_t *buf)
+{
+    return __putNested(buf, 0, 15);
+}
+
+/**
+ * @brief Flat run of primitive objects with 2 bytes tags.
+ */
+static size_t __genTwoBytesTagsRecord(uint8_t *buf)
+{
+    static const uint8_t firstTagBytes[] = {0x5F, 0x9F, 0xDF};
+    return __putPrimitive(buf, (firstTagBytes[__random(3)] << 8) | (1 + __random(0x7F)), 1 + __random(16));
+}
+
+/**
+ * @brief Primitive objects with 2 to 4 bytes length fields (issuer scripts, certificates).
+ */
+static size_t __genLongLengthsRecord(uint8_t *buf)
+{
+    static const size_t sizes[] = {200, 1000, 40000, 70000};
+    return __putPrimitive(buf, 0x9F46, sizes[__random(4)]);
+}
+
+/**
+ * @brief Small records separated by long runs of padding (EEPROM images).
+ */
+static size_t __genPaddedRecord(uint8_t *buf)
+{
+    size_t size = __putPadding(buf, 64 + __random(4096));
+    return size + __putPrimitive(buf + size, 0x5A, 8);
+}
+
+/**
+ * @brief Fill a corpus with generated records up to the requested size.
+ */
+static void __buildCorpus(TBenchCorpus *corpus, const char *name, size_t size, size_t (*genRecord)(uint8_t *buf))
+{
+    // Largest generated record plus its length field
+    const size_t maxRecordSize = 80 * 1024;
+    size_t recordCapacity = 1024;
+
+    corpus->name = name;
+    corpus->data = malloc(size + maxRecordSize);
+    corpus->size = 0;
+    corpus->records = malloc(recordCapacity * sizeof(size_t));
+    corpus->recordCount = 0;
+
+    while (corpus->size < size)
+    {
+        if (corpus->recordCount == recordCapacity)
+        {
+            recordCapacity *= 2;
+            corpus->records = realloc(corpus->records, recordCapacity * sizeof(size_t));
+        }
+        corpus->records[corpus->recordCount++] = corpus->size;
+        corpus->size += genRecord(corpus->data + corpus->size);
+    }
+
+    corpus->objCount = __opParse(corpus);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Operations------------------------------------------------------------//
+
+/**
+ * @brief Walk every object with berTlv_parseRawData(), going into constructed objects.
+ * @return Number of objects.
+ */
+static size_t __opParse(TBenchCorpus *corpus)
+{
+    uint8_t *dataPtr = corpus->data;
+    uint8_t *recordEnd = corpus->data;
+    size_t remainingSize = corpus->size;
+    size_t objCount = 0;
+    TBerTlvObj tlvObj;
+
+    while (remainingSize)
+    {
+        // Garbage data is only skipped between top-level records
+        bool isNotInConstructedObject = dataPtr >= recordEnd;
+        uint8_t *before = dataPtr + remainingSize;
+        if (berTlv_parseRawData(dataPtr, &remainingSize, &tlvObj, isNotInConstructedObject) || remainingSize == 0)
+            break;
+        uint8_t *header = before - remainingSize;
+        size_t headerSize = tlvObj.tagSize + tlvObj.lengthSize;
+        if (isNotInConstructedObject)
+            recordEnd = header + headerSize + tlvObj.valueSize;
+        // Constructed objects are nested in the value, go on parsing from there
+        size_t consumed = (header[0] & 0x20) ? headerSize : headerSize + tlvObj.valueSize;
+        dataPtr = header + consumed;
+        remainingSize -= consumed;
+        objCount++;
+    }
+    return objCount;
+}
+
+/**
+ * @brief Index the whole corpus, without tag table.
+ *
+ * The corpora repeat the same few tags, a tag table over the whole corpus would only measure probing
+ * through the duplicates. Lookups are measured per record by __opFind().
+ */
+static size_t __opIndex(TBenchCorpus *corpus)
+{
+    berTlv_indexSetTagTable(&benchIndex, NULL, 0);
+    berTlv_index(corpus->data, corpus->size, &benchIndex);
+    return benchIndex.count;
+}
+
+/**
+ * @brief Check the framing of the whole corpus.
+ */
+static size_t __opValidate(TBenchCorpus *corpus)
+{
+    size_t errorOffset;
+    return berTlv_validate(corpus->data, corpus->size, &errorOffset) == BER_TLV_OK ? corpus->objCount : 0;
+}
+
+/**
+ * @brief Index the whole corpus with one thread per CPU.
+ */
+static size_t __opBatchIndex(TBenchCorpus *corpus)
+{
+    berTlv_indexSetTagTable(&benchIndex, NULL, 0);
+    berTlv_batchIndex(corpus->data, corpus->size, &benchIndex, 0);
+    return benchIndex.count;
+}
+
+/**
+ * @brief Index each top-level record as a message and look up the EMV tags in it.
+ */
+static size_t __opFind(TBenchCorpus *corpus)
+{
+    size_t found = 0;
+    TBerTlvObj tlvObj;
+
+    // Large enough to keep the tag table of one record at most half full
+    berTlv_indexSetTagTable(&benchIndex, benchTagTable, sizeof(benchTagTable) / sizeof(benchTagTable[0]));
+    for (size_t i = 0; i < corpus->recordCount; ++i)
+    {
+        size_t end = (i + 1 < corpus->recordCount) ? corpus->records[i + 1] : corpus->size;
+        if (berTlv_index(corpus->data + corpus->records[i], end - corpus->records[i], &benchIndex))
+            continue;
+        for (size_t j = 0; j < EMV_TAG_COUNT; ++j)
+        {
+            found += berTlv_find(&benchIndex, EMV_TAGS[j], &tlvObj);
+        }
+    }
+    return found;
+}
+
+static size_t __opSoaIndex(TBenchCorpus *corpus)
+{
+    berTlv_soaIndex(corpus->data, corpus->size, &benchSoaIndex);
+    return benchSoaIndex.count;
+}
+
+/**
+ * @brief Count the entries of each EMV tag in the index of the whole corpus, built once.
+ */
+static size_t __opIndexScan(TBenchCorpus *corpus)
+{
+    size_t found = 0;
+
+    if (benchIndex.data != corpus->data || benchIndex.size != corpus->size)
+        __opIndex(corpus);
+    for (size_t j = 0; j < EMV_TAG_COUNT; ++j)
+    {
+        for (size_t i = 0; i < benchIndex.count; ++i)
+        {
+            found += (benchIndex.entries[i].obj.tag == EMV_TAGS[j]);
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Count the entries of each EMV tag in the struct of arrays index of the whole corpus, built once.
+ */
+static size_t __opSoaScan(TBenchCorpus *corpus)
+{
+    size_t found = 0;
+
+    if (benchSoaIndex.data != corpus->data)
+        __opSoaIndex(corpus);
+    for (size_t j = 0; j < EMV_TAG_COUNT; ++j)
+    {
+        found += berTlv_soaCount(&benchSoaIndex, EMV_TAGS[j]);
+    }
+    return found;
+}
+
+/**
+ * @brief Extract the EMV schema from each top-level record.
+ */
+static size_t __opSchema(TBenchCorpus *corpus)
+{
+    size_t found = 0;
+    TBenchEmvFields fields;
+
+    for (size_t i = 0; i < corpus->recordCount; ++i)
+    {
+        size_t end = (i + 1 < corpus->recordCount) ? corpus->records[i + 1] : corpus->size;
+        if (__benchEmvExtract(corpus->data + corpus->records[i], end - corpus->records[i], &fields, NULL))
+            continue;
+        found += fields.pan.data != NULL;
+    }
+    return found;
+}
+
+/**
+ * @brief Extract 4 tags of each record from the record templates only, stopping when they are found.
+ */
+static size_t __opExtract(TBenchCorpus *corpus)
+{
+    static const uint32_t tags[] = {0x5A, 0x9F02, 0x9F26, 0x84};
+    static TBerTlvTagSet set;
+    TBerTlvObj objs[4];
+    size_t found = 0;
+
+    if (set.count == 0)
+    {
+        berTlv_tagSetInit(&set, tags, 4);
+        berTlv_tagSetAddContainer(&set, 0x70);
+    }
+    for (size_t i = 0; i < corpus->recordCount; ++i)
+    {
+        size_t end = (i + 1 < corpus->recordCount) ? corpus->records[i + 1] : corpus->size;
+        if (berTlv_extractSet(corpus->data + corpus->records[i], end - corpus->records[i], &set, objs, NULL))
+            continue;
+        found += objs[0].value != NULL;
+    }
+    return found;
+}
+
+/**
+ * @brief Iterate the top-level records, jumping over their content.
+ */
+static size_t __opIterSkip(TBenchCorpus *corpus)
+{
+    TBerTlvIter iter;
+    TBerTlvObj tlvObj;
+    size_t count = 0;
+
+    berTlv_iterBegin(&iter, corpus->data, corpus->size, NULL, 0);
+    while (!berTlv_iterNext(&iter, &tlvObj) && tlvObj.value)
+    {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Find the AID (0x84) of each top-level record, only entering the record templates.
+ */
+static size_t __opIterRoute(TBenchCorpus *corpus)
+{
+    size_t endStack[1];
+    TBerTlvIter iter;
+    TBerTlvObj tlvObj;
+    size_t found = 0;
+
+    berTlv_iterBegin(&iter, corpus->data, corpus->size, endStack, 1);
+    while (!berTlv_iterNext(&iter, &tlvObj) && tlvObj.value)
+    {
+        if (iter.depth == 0)
+        {
+            berTlv_iterEnter(&iter);
+        }
+        else if (tlvObj.tag == 0x84)
+        {
+            found++;
+            berTlv_iterSkip(&iter);
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Encode again every object of the corpus with the builder, without the garbage data.
+ * @return Size of the built data.
+ */
+static size_t __opBuild(TBenchCorpus *corpus)
+{
+    static uint8_t *output;
+    static size_t outputSize;
+    size_t walkStack[32];
+    size_t openStack[32];
+    TBerTlvWalker walker;
+    TBerTlvBuilder builder;
+    TBerTlvObj tlvObj;
+    size_t depth;
+    size_t size;
+
+    if (outputSize < corpus->size)
+    {
+        outputSize = corpus->size;
+        output = realloc(output, outputSize);
+    }
+    berTlv_walkInit(&walker, corpus->data, corpus->size, walkStack, 32);
+    berTlv_builderInit(&builder, output, outputSize, openStack, 32);
+    while (!berTlv_walkNext(&walker, &tlvObj, &depth) && tlvObj.value)
+    {
+        while (builder.depth > depth)
+        {
+            berTlv_builderClose(&builder);
+        }
+        if (tlvObj.constructed)
+            berTlv_builderOpen(&builder, tlvObj.tag, tlvObj.valueSize);
+        else
+            berTlv_builderAdd(&builder, tlvObj.tag, tlvObj.value, tlvObj.valueSize);
+    }
+    berTlv_builderFinish(&builder, &size);
+    return size;
+}
+
+/**
+ * @brief Print the whole corpus into a sink that discards the text.
+ */
+static size_t __opPrint(TBenchCorpus *corpus)
+{
+    static char buffer[PRINT_BUFFER_SIZE];
+    TBerTlvSink sink;
+
+    berTlv_sinkInit(&sink, buffer, sizeof(buffer), __discardWrite, NULL);
+    return berTlv_printToSink(corpus->data, corpus->size, &sink);
+}
+
+/**
+ * @brief Print the whole corpus as JSON lines into a sink that discards the text.
+ */
+static size_t __opPrintJson(TBenchCorpus *corpus)
+{
+    static char buffer[PRINT_BUFFER_SIZE];
+    TBerTlvSink sink;
+
+    berTlv_sinkInit(&sink, buffer, sizeof(buffer), __discardWrite, NULL);
+    return berTlv_printFormatToSink(corpus->data, corpus->size, &sink, BER_TLV_FORMAT_JSON);
+}
+
+/**
+ * @brief Index the whole corpus through the cache, the records are copied from it after the warmup.
+ */
+static size_t __opCacheIndex(TBenchCorpus *corpus)
+{
+    berTlv_indexSetTagTable(&benchIndex, NULL, 0);
+    berTlv_cacheIndex(&benchCache, corpus->data, corpus->size, &benchIndex);
+    return benchIndex.count;
+}
+
+/**
+ * @brief Print the whole corpus through the cache into a sink that discards the text.
+ */
+static size_t __opCachePrint(TBenchCorpus *corpus)
+{
+    static char buffer[PRINT_BUFFER_SIZE];
+    TBerTlvSink sink;
+
+    berTlv_sinkInit(&sink, buffer, sizeof(buffer), __discardWrite, NULL);
+    return berTlv_cachePrint(&benchCache, corpus->data, corpus->size, &sink, BER_TLV_FORMAT_TEXT);
+}
+
+/**
+ * @brief Feed the whole corpus to the stream parser in TCP segment sized chunks.
+ */
+static size_t __opStream(TBenchCorpus *corpus)
+{
+    static TBerTlvStreamLevel stack[16];
+    static uint8_t valueBuffer[80 * 1024];
+    TBerTlvStream stream;
+    size_t objCount = 0;
+
+    berTlv_streamInit(&stream, stack, 16, valueBuffer, sizeof(valueBuffer), __countObject, &objCount);
+    for (size_t offset = 0; offset < corpus->size; offset += STREAM_CHUNK_SIZE)
+    {
+        size_t chunkSize = corpus->size - offset < STREAM_CHUNK_SIZE ? corpus->size - offset : STREAM_CHUNK_SIZE;
+        if (berTlv_streamFeed(&stream, corpus->data + offset, chunkSize))
+            break;
+    }
+    return objCount;
+}
+
+#if defined(__linux__)
+/**
+ * @brief Map the corpus file and parse its records, through its path in /dev/fd.
+ */
+static size_t __opFile(TBenchCorpus *corpus)
+{
+    FILE *file = __corpusFile(corpus);
+    char path[32];
+    TBerTlvFile mappedFile;
+    TBerTlvObj record;
+    size_t recordCount = 0;
+
+    snprintf(path, sizeof(path), "/dev/fd/%d", file ? fileno(file) : -1);
+    if (berTlv_fileOpen(&mappedFile, path))
+        return 0;
+    while (berTlv_fileNextRecord(&mappedFile, &record))
+    {
+        recordCount++;
+    }
+    berTlv_fileClose(&mappedFile);
+    return recordCount;
+}
+
+/**
+ * @brief Read the corpus from a file through the pipeline with io_uring.
+ */
+static size_t __opPipeline(TBenchCorpus *corpus)
+{
+    return __runPipeline(corpus, true);
+}
+
+/**
+ * @brief Read the corpus from a file through the pipeline with epoll.
+ */
+static size_t __opPipelineEpoll(TBenchCorpus *corpus)
+{
+    return __runPipeline(corpus, false);
+}
+
+/**
+ * @brief Read the corpus from its file and count the indexed objects. The worker threads are started by
+ * each pass.
+ */
+static size_t __runPipeline(TBenchCorpus *corpus, bool useIoUring)
+{
+    static uint8_t pool[PIPELINE_BUFFER_COUNT * PIPELINE_BUFFER_SIZE];
+    FILE *file = __corpusFile(corpus);
+    TBerTlvPipeline pipeline;
+    size_t objCount = 0;
+
+    if (file == NULL)
+        return 0;
+    lseek(fileno(file), 0, SEEK_SET);
+
+    berTlv_pipelineInit(&pipeline, pool, PIPELINE_BUFFER_SIZE, PIPELINE_BUFFER_COUNT, 0, __countIndexed, &objCount);
+    pipeline.useIoUring = useIoUring;
+    berTlv_pipelineAddSource(&pipeline, fileno(file), NULL);
+    berTlv_pipelineRun(&pipeline);
+    return objCount;
+}
+
+/**
+ * @brief Temporary file holding a corpus, written once per corpus.
+ * @return The file or NULL if it couldn't be written.
+ */
+static FILE *__corpusFile(TBenchCorpus *corpus)
+{
+    static const uint8_t *fileData;
+    static FILE *file;
+
+    if (fileData != corpus->data)
+    {
+        if (file)
+            fclose(file);
+        fileData = NULL;
+        file = tmpfile();
+        if (!file || fwrite(corpus->data, 1, corpus->size, file) != corpus->size || fflush(file))
+            return NULL;
+        fileData = corpus->data;
+    }
+    return file;
+}
+
+/**
+ * @brief Pipeline callback counting the indexed objects, from any worker.
+ */
+static bool __countIndexed(void *userData, size_t source, size_t streamOffset, EBerTlvError error,
+                           const TBerTlvIndex *index)
+{
+    (void)source;
+    (void)streamOffset;
+    (void)error;
+    __atomic_fetch_add((size_t *)userData, index->count, __ATOMIC_RELAXED);
+    return false;
+}
+#endif
+
+/**
+ * @brief Sink write callback that drops the text.
+ */
+static bool __discardWrite(void *userData, const char *str, size_t size)
+{
+    (void)userData;
+    (void)str;
+    (void)size;
+    return false;
+}
+
+/**
+ * @brief Stream callback counting the objects.
+ */
+static bool __countObject(void *userData, EBerTlvStreamEvent event, const TBerTlvObj *tlvObj, size_t depth)
+{
+    (void)tlvObj;
+    (void)depth;
+    if (event != BER_TLV_STREAM_CONSTRUCTED_END)
+        (*(size_t *)userData)++;
+    return false;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Measurement-----------------------------------------------------------//
+
+/**
+ * @brief Monotonic time in seconds.
+ */
+static double __now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int __compareDouble(const void *a, const void *b)
+{
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+/**
+ * @brief Run an operation over a corpus and print its throughput and latency percentiles.
+ */
+static void __runOp(const TBenchOp *op, TBenchCorpus *corpus, int warmup, int repetitions)
+{
+    double *times = malloc(repetitions * sizeof(double));
+    double total = 0;
+    volatile size_t sinkValue = 0;
+
+    for (int i = 0; i < warmup; ++i)
+    {
+        sinkValue += op->run(corpus);
+    }
+    for (int i = 0; i < repetitions; ++i)
+    {
+        double start = __now();
+        sinkValue += op->run(corpus);
+        times[i] = __now() - start;
+        total += times[i];
+    }
+    qsort(times, repetitions, sizeof(double), __compareDouble);
+
+    double mean = total / repetitions;
+    printf("%-14s %-11s %9zu %10.1f %12.0f %10.1f %10.1f %10.1f\n",
+           corpus->name,
+           op->name,
+           corpus->size / 1024,
+           corpus->size / mean / 1e6,
+           corpus->objCount / mean,
+           times[(repetitions - 1) * 50 / 100] * 1e6,
+           times[(repetitions - 1) * 90 / 100] * 1e6,
+           times[(repetitions - 1) * 99 / 100] * 1e6);
+    free(times);
+}
@@ -6,30 +6,115 @@
  */
 
 #include "ber_tlv.h"
+#include "ber_tlv_internal.h"
 
 #include <stdbool.h>
 #include <stdio.h>
 #include <assert.h>
 #include <errno.h>
+#include <stdarg.h>
 #include <string.h>
+#include <unistd.h>
 
-//! Non fatal assertion macro.
-#define BER_TLV_ASSERT_NON_FATAL(cond, format, args...)         \
-    if (!(cond))                                                \
-    {                                                           \
-        printf("ERROR: Fatal error in %s:%d %s()\n\n\t" format, \
-               __FILE__,                                        \
-               __LINE__,                                        \
-               __FUNCTION__,                                    \
-               ##args);                                         \
-        printf("\n\n");                                         \
+// Error diagnostics printed on stdout, disabled with -DBER_TLV_DIAGNOSTICS=0
+#ifndef BER_TLV_DIAGNOSTICS
+#define BER_TLV_DIAGNOSTICS 1
+#endif
+
+#if BER_TLV_DIAGNOSTICS
+//! Non fatal assertion macro, reported as raised in the given function to the diagnostics of ctx, or on stdout.
+#define BER_TLV_ASSERT_NON_FATAL_IN(ctx, function, cond, format, args...)    \
+    if (!(cond))                                                             \
+    {                                                                        \
+        __diagnostic((ctx),                                                  \
+                     "ERROR: Fatal error in %s:%d %s()\n\n\t" format "\n\n", \
+                     __FILE__,                                               \
+                     __LINE__,                                               \
+                     function,                                               \
+                     ##args);                                                \
     }
+#else
+//! Non fatal assertion macro, compiled out. The error is only reported by the returned code, ctx is still referenced.
+#define BER_TLV_ASSERT_NON_FATAL_IN(ctx, function, cond, format, args...) ((void)(ctx))
+#endif
+//! Non fatal assertion macro.
+#define BER_TLV_ASSERT_NON_FATAL(ctx, cond, format, args...) \
+    BER_TLV_ASSERT_NON_FATAL_IN(ctx, __FUNCTION__, cond, format, ##args)
+//! Non fatal assertion of the header decoder, reported as raised in its public entry point
+#define BER_TLV_ASSERT_HEADER(ctx, cond, format, args...) \
+    BER_TLV_ASSERT_NON_FATAL_IN(ctx, "berTlv_parseRawData", cond, format, ##args)
+
+// Counters of TBerTlvStats, enabled with -DBER_TLV_STATS=1
+#ifndef BER_TLV_STATS
+#define BER_TLV_STATS 0
+#endif
+
+#if BER_TLV_STATS
+//! Counters of the calling thread, updated by the functions called without context
+static _Thread_local TBerTlvStats threadStats;
+//! Counters of ctx, or of the calling thread without ctx
+#define BER_TLV_STATS_OF(ctx) ((ctx) ? &((TBerTlvCtx *)(ctx))->stats : &threadStats)
+#define BER_TLV_STATS_ADD(ctx, counter, count) (BER_TLV_STATS_OF(ctx)->counter += (count))
+#define BER_TLV_STATS_ERROR(ctx, err) (BER_TLV_STATS_OF(ctx)->errors[(err)]++)
+#define BER_TLV_STATS_DEPTH(ctx, depth) \
+    ((depth) > BER_TLV_STATS_OF(ctx)->maxDepth ? (void)(BER_TLV_STATS_OF(ctx)->maxDepth = (depth)) : (void)0)
+#else
+// ctx is still referenced, so that functions taking it only for the counters don't get unused parameters
+#define BER_TLV_STATS_ADD(ctx, counter, count) ((void)(ctx))
+#define BER_TLV_STATS_ERROR(ctx, err) ((void)(ctx))
+#define BER_TLV_STATS_DEPTH(ctx, depth) ((void)(ctx))
+#endif
+
+/*
+ * Tracing hooks around the parsing and printing entry points, with the entry point name, the data
+ * and its size on begin and the result on end. They are defined by a header given with
+ * -DBER_TLV_TRACE_HEADER="my_trace.h", as USDT probes (provider bertlv) with -DBER_TLV_USDT=1,
+ * or compiled out.
+ */
+#if defined(BER_TLV_TRACE_HEADER)
+#include BER_TLV_TRACE_HEADER
+#elif defined(BER_TLV_USDT) && BER_TLV_USDT
+#include <sys/sdt.h>
+#define BER_TLV_TRACE_BEGIN(point, data, size) DTRACE_PROBE2(bertlv, point##__begin, data, size)
+#define BER_TLV_TRACE_END(point, result) DTRACE_PROBE1(bertlv, point##__end, result)
+#endif
+#ifndef BER_TLV_TRACE_BEGIN
+#define BER_TLV_TRACE_BEGIN(point, data, size) ((void)0)
+#endif
+#ifndef BER_TLV_TRACE_END
+#define BER_TLV_TRACE_END(point, result) ((void)0)
+#endif
+
+//! Description of each error code
+static const char *BER_TLV_ERROR_STRINGS[BER_TLV_ERR_COUNT] = {"no error",
+                                                              "truncated header",
+                                                              "truncated value",
+                                                              "bad length form",
+                                                              "nesting depth overflow",
+                                                              "no space left",
+                                                              "interrupted",
+                                                              "tag too long",
+                                                              "schema violation",
+                                                              "invalid argument"};
+
+//! Maximum nesting level of berTlv_validate(), which keeps one end offset per level on the stack
+#ifndef BER_TLV_VALIDATE_MAX_DEPTH
+#define BER_TLV_VALIDATE_MAX_DEPTH 256
+#endif
+
+//! Size of the buffer a diagnostic written to the sink of a context is formatted in
+#ifndef BER_TLV_DIAGNOSTIC_MAX_SIZE
+#define BER_TLV_DIAGNOSTIC_MAX_SIZE 512
+#endif
+
+//! Maximum nesting level of the printer, which keeps one end offset per level on the stack
+#ifndef BER_TLV_PRINT_MAX_DEPTH
+#define BER_TLV_PRINT_MAX_DEPTH 256
+#endif
 
 //! Minimum header size in bytes
 const uint8_t MIN_HEADER_SIZE = 2;
 
-//! Bit position of TLV object class in the Tag field
-const uint8_t TAG_CLASS_BIT_POS = 6;
 //! Bit mask to extract the object class
 const uint8_t TAG_CLASS_MASK = 0xC0;
 
@@ -43,13 +128,14 @@ const uint8_t CONTEXT_SPECIFIC_CLASS = 2;
 const uint8_t PRIVATE_CLASS = 3;
 
 //! Object class string values
-const char *BER_TLV_CLASSES[] = {"universal class",
-                                 "application class",
-                                 "context-specific class",
-                                 "private class"};
-
-//! Bit mask to extract the tag size from first byte of tag value
-const uint8_t TWO_BYTES_TAG_MASK = 0x1F;
+#define UNIVERSAL_CLASS_STR "universal class"
+#define APPLICATION_CLASS_STR "application class"
+#define CONTEXT_SPECIFIC_CLASS_STR "context-specific class"
+#define PRIVATE_CLASS_STR "private class"
+const char *BER_TLV_CLASSES[] = {UNIVERSAL_CLASS_STR,
+                                 APPLICATION_CLASS_STR,
+                                 CONTEXT_SPECIFIC_CLASS_STR,
+                                 PRIVATE_CLASS_STR};
 
 //! Bit position of object type (primitive or constructed) in first byte of tag field
 const uint8_t TAG_OBJ_TYPE_BIT_POS = 5;
@@ -60,318 +146,1606 @@ const uint8_t PRIMITIVE_DATA_OBJECT = 0;
 //! Constructed data object type
 const uint8_t CONSTRUCTED_DATA_OBJECT = 1;
 //! String definition of tlv object types
-const char *BER_TLV_OBJECTS_TYPES[] = {"primitive",
-                                       "constructed"};
-//! Bit mask used to know if the lenght field has multiple bytes.
-const uint8_t MULTPLES_BYTES_LENGTH_MASK = 0x80;
+#define PRIMITIVE_DATA_OBJECT_STR "primitive"
+#define CONSTRUCTED_DATA_OBJECT_STR "constructed"
+const char *BER_TLV_OBJECTS_TYPES[] = {PRIMITIVE_DATA_OBJECT_STR,
+                                       CONSTRUCTED_DATA_OBJECT_STR};
+//! Maximum size of the length field (4 subsequent bytes, value field up to 4 GiB)
+const uint8_t MAX_LENGTH_FIELD_SIZE = 5;
+//! Length field sizes decoded from a single 4 bytes load: 0x81 and 0x82 forms
+#define FAST_LENGTH_FIELD_SIZES 4
+//! Shift of the value size in the big-endian 4 bytes load of the length field, by length field size
+static const uint8_t FAST_LENGTH_FIELD_SHIFTS[FAST_LENGTH_FIELD_SIZES] = {0, 24, 16, 8};
+//! Mask of the value size in the shifted 4 bytes load of the length field, by length field size
+static const uint32_t FAST_LENGTH_FIELD_MASKS[FAST_LENGTH_FIELD_SIZES] = {0, 0xFF, 0xFF, 0xFFFF};
+
+//! Constant text chunk of the printed output
+typedef struct
+{
+    const char *str;
+    uint8_t size;
+} TBerTlvText;
+
+#define BER_TLV_TEXT(str) {str, sizeof(str) - 1}
+#define BER_TLV_TAG_SUFFIX(classStr, typeStr) BER_TLV_TEXT(" (" classStr ", " typeStr ")\n")
+
+//! End of the TAG line for each combination of class and object type
+static const TBerTlvText TAG_LINE_SUFFIXES[4][2] = {
+    {BER_TLV_TAG_SUFFIX(UNIVERSAL_CLASS_STR, PRIMITIVE_DATA_OBJECT_STR),
+     BER_TLV_TAG_SUFFIX(UNIVERSAL_CLASS_STR, CONSTRUCTED_DATA_OBJECT_STR)},
+    {BER_TLV_TAG_SUFFIX(APPLICATION_CLASS_STR, PRIMITIVE_DATA_OBJECT_STR),
+     BER_TLV_TAG_SUFFIX(APPLICATION_CLASS_STR, CONSTRUCTED_DATA_OBJECT_STR)},
+    {BER_TLV_TAG_SUFFIX(CONTEXT_SPECIFIC_CLASS_STR, PRIMITIVE_DATA_OBJECT_STR),
+     BER_TLV_TAG_SUFFIX(CONTEXT_SPECIFIC_CLASS_STR, CONSTRUCTED_DATA_OBJECT_STR)},
+    {BER_TLV_TAG_SUFFIX(PRIVATE_CLASS_STR, PRIMITIVE_DATA_OBJECT_STR),
+     BER_TLV_TAG_SUFFIX(PRIVATE_CLASS_STR, CONSTRUCTED_DATA_OBJECT_STR)}};
+
+//! Beginning of the TAG line
+static const TBerTlvText TAG_LINE_PREFIX = BER_TLV_TEXT("TAG - 0x");
+//! Beginning of the LEN line
+static const TBerTlvText LEN_LINE_PREFIX = BER_TLV_TEXT("LEN - ");
+//! End of the LEN line
+static const TBerTlvText LEN_LINE_SUFFIX = BER_TLV_TEXT(" bytes\n");
+//! Beginning of the VAL line
+static const TBerTlvText VAL_LINE_PREFIX = BER_TLV_TEXT("VAL - ");
+
+//! Maximum size of the TAG line plus the LEN line, without indentation
+#define HEADER_LINES_MAX_SIZE 96
+//! Maximum size of a HEX or JSON line without the value bytes
+#define FORMAT_LINE_MAX_SIZE 192
+//! Size of the fields of a BINARY record before the value bytes
+#define BINARY_RECORD_HEADER_SIZE 11
+
+//! Class names of the JSON lines
+static const TBerTlvText JSON_CLASSES[4] = {BER_TLV_TEXT("\"universal\""),
+                                           BER_TLV_TEXT("\"application\""),
+                                           BER_TLV_TEXT("\"context-specific\""),
+                                           BER_TLV_TEXT("\"private\"")};
+//! Fields of the JSON lines, in order
+static const TBerTlvText JSON_OFFSET = BER_TLV_TEXT("{\"offset\":");
+static const TBerTlvText JSON_DEPTH = BER_TLV_TEXT(",\"depth\":");
+static const TBerTlvText JSON_TAG = BER_TLV_TEXT(",\"tag\":\"");
+static const TBerTlvText JSON_CLASS = BER_TLV_TEXT("\",\"class\":");
+static const TBerTlvText JSON_CONSTRUCTED = BER_TLV_TEXT(",\"constructed\":true,\"length\":");
+static const TBerTlvText JSON_PRIMITIVE = BER_TLV_TEXT(",\"constructed\":false,\"length\":");
+static const TBerTlvText JSON_VALUE = BER_TLV_TEXT(",\"value\":\"");
+
+//! Hexadecimal digits
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+//! Size of each byte representation in HEX_BYTE_STRINGS
+#define HEX_BYTE_STRING_SIZE 5
+#define HEX_BYTE_ROW(h) "0x" h "0 0x" h "1 0x" h "2 0x" h "3 0x" h "4 0x" h "5 0x" h "6 0x" h "7 " \
+                        "0x" h "8 0x" h "9 0x" h "A 0x" h "B 0x" h "C 0x" h "D 0x" h "E 0x" h "F "
+//! "0xHH " representation of every byte value, as written in the VAL line
+static const char HEX_BYTE_STRINGS[256 * HEX_BYTE_STRING_SIZE + 1] =
+    HEX_BYTE_ROW("0") HEX_BYTE_ROW("1") HEX_BYTE_ROW("2") HEX_BYTE_ROW("3")
+    HEX_BYTE_ROW("4") HEX_BYTE_ROW("5") HEX_BYTE_ROW("6") HEX_BYTE_ROW("7")
+    HEX_BYTE_ROW("8") HEX_BYTE_ROW("9") HEX_BYTE_ROW("A") HEX_BYTE_ROW("B")
+    HEX_BYTE_ROW("C") HEX_BYTE_ROW("D") HEX_BYTE_ROW("E") HEX_BYTE_ROW("F");
 
 //------------------------------------------------Static fuctions declaration----------------------------------------------------//
-static bool __isConstructed(TBerTlvObj *tlvObj);
-static uint32_t __getValueSize(uint8_t *data);
-static uint16_t __getLength(uint8_t *data);
-static uint16_t __getLengthFieldSize(uint8_t *data);
-static uint16_t __getTag(uint8_t *data);
-static uint8_t __getTagSize(uint8_t fistTagByte);
-static const char *__getObjTypeString(TBerTlvObj *tlvObj);
-static const char *__getClassString(TBerTlvObj *tlvObj);
-static uint8_t __getObjTypeIndex(uint8_t tagByte);
-static uint8_t __getClassIndex(uint8_t tagByte);
-static uint16_t __addIndentation(char *str, uint16_t constructedLevels);
-static uint16_t __skipGarbageData(uint8_t *data, uint16_t size);
+static EBerTlvError __parseRawData(TBerTlvCtx *ctx, uint8_t *data, size_t *size, TBerTlvObj *tlvObjOut,
+                                   bool isNotInConstructedObject);
+static EBerTlvError __walkNext(TBerTlvCtx *ctx, TBerTlvWalker *walker, TBerTlvObj *tlvObjOut, size_t *depthOut);
+static EBerTlvError __indexData(TBerTlvCtx *ctx, uint8_t *data, size_t size, TBerTlvIndex *index);
+static EBerTlvError __validateData(TBerTlvCtx *ctx, const uint8_t *data, size_t size, size_t *errorOffset);
+static size_t __printData(TBerTlvCtx *ctx, TBerTlvWalker *walker, TBerTlvSink *sink, EBerTlvFormat format,
+                          TBerTlvPrintObjectFn printObject, void *userData, EBerTlvError *errorOut);
+static EBerTlvError __ctxSetError(TBerTlvCtx *ctx, EBerTlvError error, size_t errorOffset);
+#if BER_TLV_DIAGNOSTICS
+static void __diagnostic(TBerTlvCtx *ctx, const char *format, ...) __attribute__((format(printf, 2, 3)));
+#endif
+static EBerTlvError __decodeHeader(TBerTlvCtx *ctx, uint8_t *data, size_t size, TBerTlvObj *tlvObjOut);
+static EBerTlvError __scanHeader(const uint8_t *data, size_t size, size_t *headerSizeOut, size_t *valueSizeOut);
+static inline size_t __readValueSize(const uint8_t *lengthField, size_t available, uint8_t lengthSize)
+    __attribute__((always_inline));
+static size_t __addIndentation(char *str, size_t constructedLevels);
+static uint16_t __addText(char *str, const TBerTlvText *text);
+static uint16_t __formatHex(char *str, uint32_t value);
+static uint16_t __formatDecimal(char *str, uint64_t value);
+static uint16_t __formatTagLine(char *str, TBerTlvObj *tlvObj);
+static uint16_t __formatLengthLine(char *str, TBerTlvObj *tlvObj);
+static size_t __formatValueBytes(char *str, uint8_t *data, size_t size);
+static char *__sinkReserve(TBerTlvSink *sink, size_t size);
+static void __sinkCommit(TBerTlvSink *sink, size_t size);
+static void __sinkWrite(TBerTlvSink *sink, const char *str, size_t size);
+static void __sinkFill(TBerTlvSink *sink, char c, size_t count);
+static void __sinkTerminate(TBerTlvSink *sink);
+static void __printHeaderLines(TBerTlvSink *sink, TBerTlvObj *tlvObj, size_t constructedLevels);
+static void __printValueLine(TBerTlvSink *sink, uint8_t *data, size_t size, size_t constructedLevels);
+static void __printHexBytes(TBerTlvSink *sink, uint8_t *data, size_t size);
+static void __printHexLine(TBerTlvSink *sink, TBerTlvObj *tlvObj, size_t depth);
+static void __printJsonLine(TBerTlvSink *sink, TBerTlvObj *tlvObj, size_t offset, size_t depth);
+static void __printBinaryRecord(TBerTlvSink *sink, TBerTlvObj *tlvObj, size_t depth);
+static bool __fileSinkWrite(void *userData, const char *str, size_t size);
+static bool __fdSinkWrite(void *userData, const char *str, size_t size);
+static size_t __skipGarbageData(uint8_t *data, size_t size);
+static size_t __skipGarbageDataScalar(const uint8_t *data, size_t size);
+#if defined(BER_TLV_SIMD_X86)
+static size_t __skipGarbageDataSse2(const uint8_t *data, size_t size);
+static size_t __skipGarbageDataAvx2(const uint8_t *data, size_t size);
+#elif defined(BER_TLV_SIMD_NEON)
+static size_t __skipGarbageDataNeon(const uint8_t *data, size_t size);
+#endif
+static size_t __tagTableSlot(const TBerTlvIndex *index, uint32_t tag);
+static bool __tagTableInsert(TBerTlvIndex *index, size_t entryIndex);
+static size_t __findEntry(const TBerTlvIndex *index, uint32_t tag, size_t *cursor);
+static bool __matchPath(const TBerTlvIndex *index, size_t entryIndex, const uint32_t *path, size_t pathSize);
 
 //-----------------------------------------------------------------------------------------------------------------------------//
 //-------------------------------------------------------Public functions------------------------------------------------------//
 
-uint16_t berTlv_printFromRawData(uint8_t *data, uint16_t size, char *outputStr)
+void berTlv_sinkInit(TBerTlvSink *sink, char *buffer, size_t capacity, TBerTlvSinkWriteFn write, void *userData)
 {
-    TBerTlvObj tlvObj;
-    char *strP = outputStr;
-    uint8_t *dataPtr = data;
-    uint16_t remainingSize = size;
-    uint16_t bytesWriten = 0;
+    sink->buffer = buffer;
+    sink->capacity = capacity;
+    sink->used = 0;
+    sink->write = write;
+    sink->userData = userData;
+    sink->bytesWriten = 0;
+    sink->truncated = false;
+    sink->error = false;
+}
 
-    uint16_t constructedSizeStack[5] = {0};
-    uint8_t constructedLevels = 0;
+void berTlv_sinkInitFile(TBerTlvSink *sink, char *buffer, size_t capacity, FILE *file)
+{
+    berTlv_sinkInit(sink, buffer, capacity, __fileSinkWrite, file);
+}
 
-    bool isNotInConstructedObject = true;
+void berTlv_sinkInitFd(TBerTlvSink *sink, char *buffer, size_t capacity, int fd)
+{
+    // The descriptor is stored in the user data pointer itself
+    berTlv_sinkInit(sink, buffer, capacity, __fdSinkWrite, (void *)(intptr_t)fd);
+}
 
-    while (remainingSize)
+bool berTlv_sinkFlush(TBerTlvSink *sink)
+{
+    if (sink->write && sink->used && !sink->error)
     {
-        bool err = berTlv_parseRawData(dataPtr, &remainingSize, &tlvObj, isNotInConstructedObject);
-        if (err)
-            return bytesWriten;
-        // This means that all remaining bytes were garbage data and were skipped by the parse function
-        if (remainingSize == 0)
-            break;
+        sink->error = sink->write(sink->userData, sink->buffer, sink->used);
+        sink->used = 0;
+    }
+    return sink->error;
+}
 
-        char *startPos = strP;
+void berTlv_sinkWrite(TBerTlvSink *sink, const char *str, size_t size)
+{
+    __sinkWrite(sink, str, size);
+    __sinkTerminate(sink);
+}
 
-        strP += __addIndentation(strP, constructedLevels);
+size_t berTlv_printToSink(uint8_t *data, size_t size, TBerTlvSink *sink)
+{
+    return berTlv_printFormatToSink(data, size, sink, BER_TLV_FORMAT_TEXT);
+}
 
-        strP += sprintf(strP, "TAG - 0x%02X (%s, %s)\n",
-                        tlvObj.tag,
-                        __getClassString(&tlvObj),
-                        __getObjTypeString(&tlvObj));
+size_t berTlv_printFormatToSink(uint8_t *data, size_t size, TBerTlvSink *sink, EBerTlvFormat format)
+{
+    EBerTlvError err;
+    return berTlv_printFormatWithError(data, size, sink, format, &err);
+}
 
-        strP += __addIndentation(strP, constructedLevels);
+size_t berTlv_printFormatWithError(uint8_t *data, size_t size, TBerTlvSink *sink, EBerTlvFormat format,
+                                   EBerTlvError *errorOut)
+{
+    TBerTlvWalker walker;
+    size_t endStack[BER_TLV_PRINT_MAX_DEPTH];
 
-        strP += sprintf(strP, "LEN - %d bytes\n", tlvObj.lengthValue);
+    berTlv_walkInit(&walker, data, size, endStack, BER_TLV_PRINT_MAX_DEPTH);
+    return __printData(NULL, &walker, sink, format, NULL, NULL, errorOut);
+}
 
-        dataPtr = tlvObj.value;
+size_t berTlv_printFormatWithHook(uint8_t *data, size_t size, TBerTlvSink *sink, EBerTlvFormat format,
+                                  TBerTlvPrintObjectFn printObject, void *userData)
+{
+    TBerTlvWalker walker;
+    size_t endStack[BER_TLV_PRINT_MAX_DEPTH];
+    EBerTlvError err;
 
-        uint16_t headerSize = (tlvObj.tagSize + tlvObj.lengthSize);
+    berTlv_walkInit(&walker, data, size, endStack, BER_TLV_PRINT_MAX_DEPTH);
+    return __printData(NULL, &walker, sink, format, printObject, userData, &err);
+}
 
-        if (__isConstructed(&tlvObj))
-        {
-            remainingSize -= headerSize;
-            if (constructedLevels)
-            {
-                constructedSizeStack[constructedLevels - 1] -= (+headerSize + tlvObj.valueSize);
-                if (constructedSizeStack[constructedLevels - 1] == 0)
-                {
-                    constructedLevels--;
-                }
-            }
-            constructedSizeStack[constructedLevels] = tlvObj.valueSize;
-            constructedLevels++;
-            strP += sprintf(strP, "\n");
-            isNotInConstructedObject = false;
-        }
-        else
-        {
-            uint16_t fullObjSize = headerSize + tlvObj.valueSize;
-            remainingSize -= fullObjSize;
-            if (tlvObj.valueSize)
-            {
-                strP += __addIndentation(strP, constructedLevels);
-                strP += sprintf(strP, "VAL - ");
-                for (int i = 0; i < tlvObj.valueSize; ++i)
-                {
-                    strP += sprintf(strP, "0x%02X ", *dataPtr++);
-                }
-                strP += sprintf(strP, "\n");
-            }
-            strP += sprintf(strP, "\n");
+size_t berTlv_printToBuffer(uint8_t *data, size_t size, char *outputStr, size_t capacity)
+{
+    TBerTlvSink sink;
 
-            if (constructedLevels)
-            {
-                constructedSizeStack[constructedLevels - 1] -= fullObjSize;
-                if (constructedSizeStack[constructedLevels - 1] == 0)
-                {
-                    constructedLevels--;
-                    isNotInConstructedObject = true;
-                }
-            }
-            else
-            {
-                isNotInConstructedObject = true;
-            }
-        }
-        bytesWriten += (strP - startPos);
+    // Keep one byte for the string terminator
+    berTlv_sinkInit(&sink, outputStr, capacity ? capacity - 1 : 0, NULL, NULL);
+    berTlv_printToSink(data, size, &sink);
+    if (capacity)
+        outputStr[sink.used] = '\0';
+    return sink.bytesWriten;
+}
+
+size_t berTlv_printFromRawData(uint8_t *data, size_t size, char *outputStr)
+{
+    TBerTlvSink sink;
+
+    berTlv_sinkInit(&sink, outputStr, SIZE_MAX, NULL, NULL);
+    return berTlv_printToSink(data, size, &sink);
+}
+
+const char *berTlv_errorString(EBerTlvError error)
+{
+    if ((unsigned)error >= BER_TLV_ERR_COUNT)
+        return "unknown error";
+    return BER_TLV_ERROR_STRINGS[error];
+}
+
+void berTlv_statsGet(TBerTlvStats *statsOut)
+{
+#if BER_TLV_STATS
+    *statsOut = threadStats;
+#else
+    memset(statsOut, 0, sizeof(*statsOut));
+#endif
+}
+
+void berTlv_statsReset(void)
+{
+#if BER_TLV_STATS
+    memset(&threadStats, 0, sizeof(threadStats));
+#endif
+}
+
+void berTlv_statsAddFormatted(size_t count)
+{
+#if BER_TLV_STATS
+    threadStats.bytesFormatted += count;
+#else
+    (void)count;
+#endif
+}
+
+EBerTlvError berTlv_parseRawData(uint8_t *data, size_t *size, TBerTlvObj *tlvObjOut, bool isNotInConstructedObject)
+{
+    return __parseRawData(NULL, data, size, tlvObjOut, isNotInConstructedObject);
+}
+
+void berTlv_indexInit(TBerTlvIndex *index, TBerTlvIndexEntry *entries, size_t capacity)
+{
+    index->data = NULL;
+    index->size = 0;
+    index->entries = entries;
+    index->capacity = capacity;
+    index->count = 0;
+    index->errorOffset = 0;
+    index->tagTable = NULL;
+    index->tagTableSize = 0;
+}
+
+void berTlv_indexSetTagTable(TBerTlvIndex *index, size_t *slots, size_t slotCount)
+{
+    index->tagTable = slots;
+    index->tagTableSize = slotCount;
+}
+
+EBerTlvError berTlv_index(uint8_t *data, size_t size, TBerTlvIndex *index)
+{
+    BER_TLV_TRACE_BEGIN(index, data, size);
+    EBerTlvError err = __indexData(NULL, data, size, index);
+    BER_TLV_TRACE_END(index, err);
+    return err;
+}
+
+EBerTlvError berTlv_validate(const uint8_t *data, size_t size, size_t *errorOffset)
+{
+    return __validateData(NULL, data, size, errorOffset);
+}
+
+EBerTlvError berTlv_indexFillTagTable(TBerTlvIndex *index)
+{
+    for (size_t i = 0; i < index->tagTableSize; ++i)
+    {
+        index->tagTable[i] = BER_TLV_EMPTY_SLOT;
+    }
+    for (size_t i = 0; i < index->count; ++i)
+    {
+        if (__tagTableInsert(index, i))
+            return BER_TLV_ERR_NO_SPACE;
     }
+    return BER_TLV_OK;
+}
 
-    return bytesWriten;
+void berTlv_walkInit(TBerTlvWalker *walker, uint8_t *data, size_t size, size_t *endStack, size_t stackCapacity)
+{
+    walker->data = data;
+    walker->size = size;
+    walker->position = 0;
+    walker->endStack = endStack;
+    walker->stackCapacity = stackCapacity;
+    walker->depth = 0;
+    walker->errorOffset = 0;
 }
 
-bool berTlv_parseRawData(uint8_t *data, uint16_t *size, TBerTlvObj *tlvObjOut, bool isNotInConstructedObject)
+EBerTlvError berTlv_walkNext(TBerTlvWalker *walker, TBerTlvObj *tlvObjOut, size_t *depthOut)
 {
-    uint8_t *dataP = data;
-    uint8_t minHeaderSize = MIN_HEADER_SIZE;
-    bool error = false;
+    return __walkNext(NULL, walker, tlvObjOut, depthOut);
+}
+
+void berTlv_iterBegin(TBerTlvIter *iter, uint8_t *data, size_t size, size_t *endStack, size_t stackCapacity)
+{
+    iter->data = data;
+    iter->size = size;
+    iter->position = 0;
+    iter->endStack = endStack;
+    iter->stackCapacity = stackCapacity;
+    iter->depth = 0;
+    iter->obj.value = NULL;
+    iter->obj.constructed = false;
+    iter->objOffset = 0;
+    iter->errorOffset = 0;
+}
 
-    uint16_t skippedBytes = 0;
+EBerTlvError berTlv_iterNext(TBerTlvIter *iter, TBerTlvObj *tlvObjOut)
+{
+    tlvObjOut->value = NULL;
+    iter->obj.value = NULL;
 
-    if (isNotInConstructedObject)
+    // Leave every entered constructed object that ends at the current position
+    while (iter->depth && iter->endStack[iter->depth - 1] == iter->position)
     {
-        skippedBytes = __skipGarbageData(dataP, *size);
-        *size = *size - skippedBytes;
-        if (*size == 0)
-            return 0;
-        dataP += skippedBytes;
+        iter->depth--;
+    }
+
+    bool isNotInConstructedObject = (iter->depth == 0);
+    size_t limit = isNotInConstructedObject ? iter->size : iter->endStack[iter->depth - 1];
+    size_t remainingSize = limit - iter->position;
+
+    if (remainingSize == 0)
+        return BER_TLV_OK;
+
+    EBerTlvError err = __parseRawData(NULL, iter->data + iter->position, &remainingSize, &iter->obj,
+                                           isNotInConstructedObject);
+    // Garbage data was skipped, even on error
+    iter->position = limit - remainingSize;
+    if (err)
+    {
+        iter->obj.value = NULL;
+        iter->errorOffset = iter->position;
+        return err;
     }
+    // All remaining bytes were garbage data
+    if (remainingSize == 0)
+        return BER_TLV_OK;
 
-    tlvObjOut->tagSize = __getTagSize(dataP[0]);
+    // The value is jumped over unless the object is entered
+    iter->objOffset = iter->position;
+    iter->position = (iter->obj.value - iter->data) + iter->obj.valueSize;
+    BER_TLV_STATS_DEPTH(NULL, iter->depth);
+    *tlvObjOut = iter->obj;
+    return BER_TLV_OK;
+}
+
+EBerTlvError berTlv_iterEnter(TBerTlvIter *iter)
+{
+    if (iter->obj.value == NULL || !iter->obj.constructed)
+        return BER_TLV_OK;
 
-    if (tlvObjOut->tagSize == 2)
+    size_t valueOffset = iter->obj.value - iter->data;
+    // Already entered
+    if (iter->position != valueOffset + iter->obj.valueSize)
+        return BER_TLV_OK;
+    if (iter->depth == iter->stackCapacity)
     {
-        minHeaderSize += 1;
+        BER_TLV_STATS_ERROR(NULL, BER_TLV_ERR_DEPTH_OVERFLOW);
+        return BER_TLV_ERR_DEPTH_OVERFLOW;
     }
 
-    error = *size < minHeaderSize;
-    BER_TLV_ASSERT_NON_FATAL(*size >= minHeaderSize, "Invalid size (%d). It should be at "
-                                                     "least the minimum header size (%d). Interrupting data parsing.\n",
-                             *size,
-                             minHeaderSize);
-    if (error)
-        return true;
+    iter->endStack[iter->depth++] = iter->position;
+    iter->position = valueOffset;
+    return BER_TLV_OK;
+}
 
-    tlvObjOut->tag = __getTag(dataP);
-    dataP += tlvObjOut->tagSize;
-    tlvObjOut->lengthSize = __getLengthFieldSize(dataP);
-    tlvObjOut->lengthValue = __getLength(dataP);
-    tlvObjOut->valueSize = __getValueSize(dataP);
-
-    uint8_t fullObjSize = tlvObjOut->tagSize + tlvObjOut->lengthSize + tlvObjOut->valueSize;
-    error = *size < fullObjSize;
-    BER_TLV_ASSERT_NON_FATAL(*size >= fullObjSize, "Invalid size (%d). It should be at least %d bytes -> tag size(%d) +"
-                                                   "length size(%d) + value size(%d).\n Interrupting data parsing.",
-                             *size,
-                             fullObjSize,
-                             tlvObjOut->tagSize,
-                             tlvObjOut->lengthSize,
-                             tlvObjOut->valueSize);
-    if (error)
-        return true;
+void berTlv_iterSkip(TBerTlvIter *iter)
+{
+    iter->position = iter->depth ? iter->endStack[iter->depth - 1] : iter->size;
+    iter->obj.value = NULL;
+}
+
+bool berTlv_find(const TBerTlvIndex *index, uint32_t tag, TBerTlvObj *tlvObjOut)
+{
+    size_t cursor = 0;
+    size_t entryIndex = __findEntry(index, tag, &cursor);
+
+    if (entryIndex == BER_TLV_EMPTY_SLOT)
+        return false;
+    if (tlvObjOut)
+        *tlvObjOut = index->entries[entryIndex].obj;
+    return true;
+}
 
-    dataP += tlvObjOut->lengthSize;
+bool berTlv_findPath(const TBerTlvIndex *index, const uint32_t *path, size_t pathSize, TBerTlvObj *tlvObjOut)
+{
+    size_t cursor = 0;
+    size_t entryIndex;
 
-    tlvObjOut->value = dataP;
+    if (pathSize == 0)
+        return false;
 
+    while ((entryIndex = __findEntry(index, path[pathSize - 1], &cursor)) != BER_TLV_EMPTY_SLOT)
+    {
+        if (__matchPath(index, entryIndex, path, pathSize))
+        {
+            if (tlvObjOut)
+                *tlvObjOut = index->entries[entryIndex].obj;
+            return true;
+        }
+    }
     return false;
 }
 
-//-----------------------------------------------------------------------------------------------------------------------------//
-//-------------------------------------------------------Ptivate functions------------------------------------------------------//
-static uint8_t __getClassIndex(uint8_t tagByte)
+void berTlv_ctxInit(TBerTlvCtx *ctx, size_t *endStack, size_t stackCapacity, TBerTlvSink *diagnostics)
 {
-    return ((tagByte & TAG_CLASS_MASK) >> TAG_CLASS_BIT_POS);
+    berTlv_walkInit(&ctx->walker, NULL, 0, endStack, stackCapacity);
+    ctx->error = BER_TLV_OK;
+    ctx->errorOffset = 0;
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    ctx->diagnostics = diagnostics;
 }
 
-static uint8_t __getObjTypeIndex(uint8_t tagByte)
+void berTlv_ctxBegin(TBerTlvCtx *ctx, uint8_t *data, size_t size)
 {
-    return ((tagByte & TAG_OBJ_TYPE_MASk) >> TAG_OBJ_TYPE_BIT_POS);
+    berTlv_walkInit(&ctx->walker, data, size, ctx->walker.endStack, ctx->walker.stackCapacity);
+    __ctxSetError(ctx, BER_TLV_OK, 0);
 }
 
-static const char *__getClassString(TBerTlvObj *tlvObj)
+EBerTlvError berTlv_ctxNext(TBerTlvCtx *ctx, TBerTlvObj *tlvObjOut, size_t *depthOut)
 {
-    uint8_t *tagByte = (uint8_t *)&tlvObj->tag;
-    tagByte += (tlvObj->tagSize - 1);
-    uint8_t index = __getClassIndex(*tagByte);
-    return BER_TLV_CLASSES[index];
+    EBerTlvError err = __walkNext(ctx, &ctx->walker, tlvObjOut, depthOut);
+    return __ctxSetError(ctx, err, ctx->walker.errorOffset);
 }
 
-static const char *__getObjTypeString(TBerTlvObj *tlvObj)
+EBerTlvError berTlv_ctxIndex(TBerTlvCtx *ctx, uint8_t *data, size_t size, TBerTlvIndex *index)
 {
-    uint8_t *tagByte = (uint8_t *)&tlvObj->tag;
-    tagByte += (tlvObj->tagSize - 1);
-    uint8_t index = __getObjTypeIndex(*tagByte);
-    return BER_TLV_OBJECTS_TYPES[index];
+    BER_TLV_TRACE_BEGIN(index, data, size);
+    EBerTlvError err = __indexData(ctx, data, size, index);
+    BER_TLV_TRACE_END(index, err);
+    return __ctxSetError(ctx, err, index->errorOffset);
 }
 
-static uint8_t __getTagSize(uint8_t fistTagByte)
+EBerTlvError berTlv_ctxValidate(TBerTlvCtx *ctx, const uint8_t *data, size_t size)
 {
-    return (((fistTagByte & TWO_BYTES_TAG_MASK) == TWO_BYTES_TAG_MASK) ? 2 : 1);
+    size_t errorOffset;
+    EBerTlvError err = __validateData(ctx, data, size, &errorOffset);
+    return __ctxSetError(ctx, err, errorOffset);
 }
 
-static uint16_t __getTag(uint8_t *data)
+size_t berTlv_ctxPrint(TBerTlvCtx *ctx, uint8_t *data, size_t size, TBerTlvSink *sink, EBerTlvFormat format)
 {
-    uint16_t tag = 0;
-    bool twoBytesTag = ((*data & TWO_BYTES_TAG_MASK) == TWO_BYTES_TAG_MASK);
-    tag = *data;
-    if (twoBytesTag)
-    {
-        tag <<= 8;
-        tag |= *(data + 1);
-    }
-    return tag;
+    TBerTlvWalker walker;
+    size_t endStack[BER_TLV_PRINT_MAX_DEPTH];
+    EBerTlvError err;
+
+    berTlv_walkInit(&walker, data, size, endStack, BER_TLV_PRINT_MAX_DEPTH);
+    size_t bytesWriten = __printData(ctx, &walker, sink, format, NULL, NULL, &err);
+    __ctxSetError(ctx, err, walker.errorOffset);
+    return bytesWriten;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Ptivate functions------------------------------------------------------//
+/**
+ * @brief Keep the result of a context function and its offset in the context.
+ * @return error
+ */
+static EBerTlvError __ctxSetError(TBerTlvCtx *ctx, EBerTlvError error, size_t errorOffset)
+{
+    ctx->error = error;
+    ctx->errorOffset = error ? errorOffset : 0;
+    return error;
 }
 
-static uint16_t __getLengthFieldSize(uint8_t *data)
+#if BER_TLV_DIAGNOSTICS
+/**
+ * @brief Write a diagnostic to the sink of ctx, truncated to BER_TLV_DIAGNOSTIC_MAX_SIZE bytes, or
+ * on stdout without ctx.
+ */
+static void __diagnostic(TBerTlvCtx *ctx, const char *format, ...)
 {
-    /* 
-    *  Spec definition of the length field size:
-    *
-    *  When bit b8 of the most significant byte of the length field is set to 1, 
-    * the subsequent bits b7 to b1 of the most significant byte code the number of 
-    *  subsequent bytes in the length field. The subsequent bytes code an integer 
-    * representing the number of bytes in the value field. Two bytes are necessary 
-    * to express up to 255 bytes in the value field.
-    */
-    if (*data & MULTPLES_BYTES_LENGTH_MASK)
+    va_list args;
+
+    va_start(args, format);
+    if (ctx == NULL)
+    {
+        vprintf(format, args);
+    }
+    else if (ctx->diagnostics)
     {
-        return (*data & (~MULTPLES_BYTES_LENGTH_MASK)) + 1;
+        char message[BER_TLV_DIAGNOSTIC_MAX_SIZE];
+        int length = vsnprintf(message, sizeof(message), format, args);
+
+        if (length > 0)
+        {
+            size_t messageSize = ((size_t)length < sizeof(message)) ? (size_t)length : sizeof(message) - 1;
+            __sinkWrite(ctx->diagnostics, message, messageSize);
+            berTlv_sinkFlush(ctx->diagnostics);
+        }
     }
-    return 1;
+    va_end(args);
 }
+#endif
 
-static uint16_t __getLength(uint8_t *data)
+/**
+ * @brief Print the objects of a walk started with berTlv_walkInit(), see berTlv_printFormatToSink().
+ * @param printObject Called with each top-level constructed object, see berTlv_printFormatWithHook(). May be NULL.
+ * The text it writes is counted by the callback.
+ * @param errorOut Receives the error that interrupted the printing, BER_TLV_OK if all data was printed.
+ */
+static size_t __printData(TBerTlvCtx *ctx, TBerTlvWalker *walker, TBerTlvSink *sink, EBerTlvFormat format,
+                          TBerTlvPrintObjectFn printObject, void *userData, EBerTlvError *errorOut)
 {
-    uint32_t length = 0;
-    uint8_t size = __getLengthFieldSize(data);
-    uint8_t *dataPtr = data;
-    while (size)
+    TBerTlvObj tlvObj;
+    size_t depth = 0;
+    size_t startCount = sink->bytesWriten;
+    size_t objectFnCount = 0;
+
+    *errorOut = BER_TLV_OK;
+    BER_TLV_TRACE_BEGIN(print, walker->data, walker->size);
+    while (!sink->error)
     {
-        length <<= 8;
-        length |= *dataPtr;
-        ++dataPtr;
-        --size;
+        EBerTlvError err = __walkNext(ctx, walker, &tlvObj, &depth);
+        BER_TLV_ASSERT_NON_FATAL_IN(ctx, "berTlv_printFormatToSink", err != BER_TLV_ERR_DEPTH_OVERFLOW,
+                                    "More than %zu nested constructed objects. Interrupting data printing.\n",
+                                    walker->stackCapacity);
+        *errorOut = err;
+        // All remaining bytes were garbage data or were printed
+        if (err || tlvObj.value == NULL)
+            break;
+
+        if (printObject && depth == 0 && tlvObj.constructed)
+        {
+            size_t headerSize = tlvObj.tagSize + tlvObj.lengthSize;
+            size_t bytesWriten = sink->bytesWriten;
+            if (printObject(userData, tlvObj.value - headerSize, headerSize + tlvObj.valueSize, sink, format, &err))
+            {
+                objectFnCount += sink->bytesWriten - bytesWriten;
+                *errorOut = err;
+                if (err)
+                    break;
+                // Leave the object, its text is written
+                walker->position = walker->endStack[--walker->depth];
+                continue;
+            }
+        }
+
+        switch (format)
+        {
+        case BER_TLV_FORMAT_HEX:
+            __printHexLine(sink, &tlvObj, depth);
+            break;
+        case BER_TLV_FORMAT_JSON:
+            __printJsonLine(sink, &tlvObj, tlvObj.value - walker->data - tlvObj.tagSize - tlvObj.lengthSize, depth);
+            break;
+        case BER_TLV_FORMAT_BINARY:
+            __printBinaryRecord(sink, &tlvObj, depth);
+            break;
+        default:
+            __printHeaderLines(sink, &tlvObj, depth);
+            if (!tlvObj.constructed && tlvObj.valueSize)
+                __printValueLine(sink, tlvObj.value, tlvObj.valueSize, depth);
+            __sinkWrite(sink, "\n", 1);
+            break;
+        }
+        __sinkTerminate(sink);
     }
 
-    return length;
+    berTlv_sinkFlush(sink);
+    BER_TLV_STATS_ADD(ctx, bytesFormatted, sink->bytesWriten - startCount - objectFnCount);
+    BER_TLV_TRACE_END(print, sink->bytesWriten - startCount);
+    return sink->bytesWriten - startCount;
 }
 
-static uint32_t __getValueSize(uint8_t *data)
+
+/**
+ * @brief Parse the header of the next object, see berTlv_parseRawData().
+ */
+static EBerTlvError __parseRawData(TBerTlvCtx *ctx, uint8_t *data, size_t *size, TBerTlvObj *tlvObjOut,
+                                   bool isNotInConstructedObject)
 {
-    uint32_t valueSize = 0;
-    uint8_t size = __getLengthFieldSize(data);
-    uint8_t *dataPtr = data;
+    uint8_t *dataP = data;
+    size_t skippedBytes = 0;
+    EBerTlvError err = BER_TLV_OK;
 
-    if (size == 1)
-        return *data;
-    --size;
-    dataPtr++;
+    BER_TLV_TRACE_BEGIN(parse, data, *size);
+    if (isNotInConstructedObject)
+    {
+        skippedBytes = __skipGarbageData(dataP, *size);
+        *size = *size - skippedBytes;
+        dataP += skippedBytes;
+        BER_TLV_STATS_ADD(ctx, garbageBytesSkipped, skippedBytes);
+    }
 
-    while (size)
+    if (*size)
     {
-        valueSize |= *dataPtr;
-        ++dataPtr;
-        --size;
-        if (size)
-            valueSize <<= 8;
+        err = __decodeHeader(ctx, dataP, *size, tlvObjOut);
+        if (err)
+            BER_TLV_STATS_ERROR(ctx, err);
+        else
+            BER_TLV_STATS_ADD(ctx, objectsParsed, 1);
     }
-    return valueSize;
+    BER_TLV_TRACE_END(parse, err);
+    return err;
 }
 
-static bool __isConstructed(TBerTlvObj *tlvObj)
+
+/**
+ * @brief Parse the next object of a walk, see berTlv_walkNext().
+ */
+static EBerTlvError __walkNext(TBerTlvCtx *ctx, TBerTlvWalker *walker, TBerTlvObj *tlvObjOut, size_t *depthOut)
 {
-    uint8_t *tagPtr = (uint8_t *)&tlvObj->tag;
-    if (tlvObj->tagSize > 1)
+    tlvObjOut->value = NULL;
+
+    // Leave every constructed object that ends at the current position
+    while (walker->depth && walker->endStack[walker->depth - 1] == walker->position)
+    {
+        walker->depth--;
+    }
+
+    bool isNotInConstructedObject = (walker->depth == 0);
+    size_t limit = isNotInConstructedObject ? walker->size : walker->endStack[walker->depth - 1];
+    size_t remainingSize = limit - walker->position;
+
+    if (remainingSize == 0)
+        return BER_TLV_OK;
+
+    EBerTlvError err = __parseRawData(ctx, walker->data + walker->position, &remainingSize, tlvObjOut,
+                                      isNotInConstructedObject);
+    // Garbage data was skipped, even on error
+    walker->position = limit - remainingSize;
+    if (err)
+    {
+        walker->errorOffset = walker->position;
+        return err;
+    }
+    // All remaining bytes were garbage data
+    if (remainingSize == 0)
+        return BER_TLV_OK;
+
+    if (depthOut)
+        *depthOut = walker->depth;
+    BER_TLV_STATS_DEPTH(ctx, walker->depth);
+
+    size_t headerSize = tlvObjOut->tagSize + tlvObjOut->lengthSize;
+    if (tlvObjOut->constructed)
+    {
+        if (walker->depth == walker->stackCapacity)
+        {
+            BER_TLV_STATS_ERROR(ctx, BER_TLV_ERR_DEPTH_OVERFLOW);
+            walker->errorOffset = walker->position;
+            return BER_TLV_ERR_DEPTH_OVERFLOW;
+        }
+        walker->endStack[walker->depth++] = walker->position + headerSize + tlvObjOut->valueSize;
+        walker->position += headerSize;
+    }
+    else
     {
-        tagPtr += (tlvObj->tagSize - 1);
+        walker->position += headerSize + tlvObjOut->valueSize;
     }
-    return ((*tagPtr & TAG_OBJ_TYPE_MASk) >> TAG_OBJ_TYPE_BIT_POS) == 1;
+    return BER_TLV_OK;
 }
 
+
 /**
- * @brief Add a 2 space indentation into str for each level
- * @param str string pointer
- * @param constructedLevels Level of nested constructed objects.
- * @return Amount of black space written
+ * @brief Fill the index entries, see berTlv_index().
  */
-static uint16_t __addIndentation(char *str, uint16_t constructedLevels)
+static EBerTlvError __indexData(TBerTlvCtx *ctx, uint8_t *data, size_t size, TBerTlvIndex *index)
 {
-    uint8_t spaceCount = constructedLevels * 2;
-    uint8_t writeCount = spaceCount;
-    while (spaceCount--)
+    TBerTlvIndexEntry *entries = index->entries;
+    size_t pos = 0;
+    size_t parent = BER_TLV_NO_PARENT;
+    uint16_t depth = 0;
+
+    index->data = data;
+    index->size = size;
+    index->count = 0;
+    index->errorOffset = 0;
+
+    for (size_t i = 0; i < index->tagTableSize; ++i)
     {
-        *str++ = ' ';
+        index->tagTable[i] = BER_TLV_EMPTY_SLOT;
     }
-    return writeCount;
+
+    while (pos < size)
+    {
+        // Leave every constructed object that ends at the current position
+        while (parent != BER_TLV_NO_PARENT && entries[parent].end == pos)
+        {
+            parent = entries[parent].parent;
+            depth--;
+        }
+
+        bool isNotInConstructedObject = (parent == BER_TLV_NO_PARENT);
+        size_t limit = isNotInConstructedObject ? size : entries[parent].end;
+        size_t remainingSize = limit - pos;
+        TBerTlvObj tlvObj;
+
+        EBerTlvError err = __parseRawData(ctx, data + pos, &remainingSize, &tlvObj, isNotInConstructedObject);
+        // Garbage data was skipped, even on error
+        pos = limit - remainingSize;
+        if (err)
+        {
+            index->errorOffset = pos;
+            return err;
+        }
+        // All remaining bytes were garbage data
+        if (remainingSize == 0)
+            break;
+
+        size_t headerSize = tlvObj.tagSize + tlvObj.lengthSize;
+        size_t fullObjSize = headerSize + tlvObj.valueSize;
+
+        BER_TLV_ASSERT_NON_FATAL_IN(ctx, "berTlv_index", index->count < index->capacity,
+                                    "Index is full (%zu entries). Interrupting data parsing.\n", index->capacity);
+        if (index->count >= index->capacity)
+        {
+            BER_TLV_STATS_ERROR(ctx, BER_TLV_ERR_NO_SPACE);
+            index->errorOffset = pos;
+            return BER_TLV_ERR_NO_SPACE;
+        }
+
+        TBerTlvIndexEntry *entry = &entries[index->count];
+        entry->obj = tlvObj;
+        entry->offset = pos;
+        entry->valueOffset = pos + headerSize;
+        entry->end = pos + fullObjSize;
+        entry->depth = depth;
+        entry->parent = parent;
+        BER_TLV_STATS_DEPTH(ctx, depth);
+
+        bool tagTableFull = __tagTableInsert(index, index->count);
+        BER_TLV_ASSERT_NON_FATAL_IN(ctx, "berTlv_index", !tagTableFull,
+                                    "Tag table is full (%zu slots). Interrupting data parsing.\n", index->tagTableSize);
+        if (tagTableFull)
+        {
+            BER_TLV_STATS_ERROR(ctx, BER_TLV_ERR_NO_SPACE);
+            index->errorOffset = pos;
+            return BER_TLV_ERR_NO_SPACE;
+        }
+
+        if (tlvObj.constructed)
+        {
+            if (depth == UINT16_MAX)
+            {
+                BER_TLV_STATS_ERROR(ctx, BER_TLV_ERR_DEPTH_OVERFLOW);
+                index->errorOffset = pos;
+                return BER_TLV_ERR_DEPTH_OVERFLOW;
+            }
+            parent = index->count;
+            depth++;
+            pos = entry->valueOffset;
+        }
+        else
+        {
+            pos = entry->end;
+        }
+        index->count++;
+    }
+
+    return BER_TLV_OK;
 }
 
 /**
- * Skip garbage data (0x00 or OxFF) in begining of data.
+ * @brief Check the framing of raw data, see berTlv_validate().
  */
-static uint16_t __skipGarbageData(uint8_t *data, uint16_t size)
+static EBerTlvError __validateData(TBerTlvCtx *ctx, const uint8_t *data, size_t size, size_t *errorOffset)
 {
-    uint8_t *dataPtr = data;
-    uint16_t skippedBytes = 0;
+    size_t endStack[BER_TLV_VALIDATE_MAX_DEPTH];
+    size_t depth = 0;
+    size_t pos = 0;
+    EBerTlvError err = BER_TLV_OK;
 
-    while (size && (*dataPtr == 0 || *dataPtr == 0xFF))
+    BER_TLV_TRACE_BEGIN(validate, data, size);
+    while (true)
     {
-        ++dataPtr;
+        // Leave every constructed object that ends at the current position
+        while (depth && endStack[depth - 1] == pos)
+        {
+            depth--;
+        }
+        if (depth == 0)
+            pos += __skipGarbageData((uint8_t *)data + pos, size - pos);
+
+        size_t limit = depth ? endStack[depth - 1] : size;
+        if (pos == limit)
+            break;
+
+        size_t headerSize;
+        size_t valueSize;
+        err = __scanHeader(data + pos, limit - pos, &headerSize, &valueSize);
+        if (err)
+            break;
+
+        if (data[pos] & TAG_OBJ_TYPE_MASk)
+        {
+            if (depth == BER_TLV_VALIDATE_MAX_DEPTH)
+            {
+                err = BER_TLV_ERR_DEPTH_OVERFLOW;
+                break;
+            }
+            endStack[depth++] = pos + headerSize + valueSize;
+            pos += headerSize;
+        }
+        else
+        {
+            pos += headerSize + valueSize;
+        }
+    }
+
+    if (err)
+        BER_TLV_STATS_ERROR(ctx, err);
+    if (errorOffset)
+        *errorOffset = err ? pos : 0;
+    BER_TLV_TRACE_END(validate, err);
+    return err;
+}
+
+
+/**
+ * @brief Decode the tag and the length field of an object in a single pass over the header bytes.
+ * 
+ * Class, object type, tag, length field and value size are stored in tlvObjOut, so no other
+ * function has to read the header bytes again.
+ * @param data Pointer to the first tag byte
+ * @param size Bytes available from data
+ * @return BER_TLV_OK or the error found in the header.
+ */
+static EBerTlvError __decodeHeader(TBerTlvCtx *ctx, uint8_t *data, size_t size, TBerTlvObj *tlvObjOut)
+{
+    uint8_t *dataP = data;
+    uint8_t firstTagByte = size ? *dataP : 0;
+    bool error = false;
+
+    tlvObjOut->tagClass = (firstTagByte & TAG_CLASS_MASK) >> TAG_CLASS_BIT_POS;
+    tlvObjOut->constructed = (firstTagByte & TAG_OBJ_TYPE_MASk) != 0;
+    tlvObjOut->tag = firstTagByte;
+    tlvObjOut->tagSize = 1;
+
+    // Subsequent tag bytes are packed after the first one while their bit b8 is set
+    bool subsequentTagByte = (firstTagByte & MULTIPLE_BYTES_TAG_MASK) == MULTIPLE_BYTES_TAG_MASK;
+    while (subsequentTagByte && tlvObjOut->tagSize < size && tlvObjOut->tagSize < MAX_TAG_SIZE)
+    {
+        uint8_t tagByte = dataP[tlvObjOut->tagSize++];
+        tlvObjOut->tag = (tlvObjOut->tag << 8) | tagByte;
+        subsequentTagByte = (tagByte & SUBSEQUENT_TAG_BYTE_MASK) != 0;
+    }
+
+    error = subsequentTagByte && tlvObjOut->tagSize == MAX_TAG_SIZE;
+    BER_TLV_ASSERT_HEADER(ctx, !error, "Tag field longer than %d bytes. Interrupting data parsing.\n", MAX_TAG_SIZE);
+    if (error)
+        return BER_TLV_ERR_TAG_TOO_LONG;
+
+    // One more tag byte is needed if the data ended within the tag
+    size_t minHeaderSize = MIN_HEADER_SIZE + tlvObjOut->tagSize - 1 + subsequentTagByte;
+    error = size < minHeaderSize;
+    BER_TLV_ASSERT_HEADER(ctx, size >= minHeaderSize, "Invalid size (%zu). It should be at least the "
+                                                         "minimum header size (%zu). Interrupting data parsing.\n",
+                                  size,
+                                  minHeaderSize);
+    if (error)
+        return BER_TLV_ERR_TRUNCATED_HEADER;
+
+    dataP += tlvObjOut->tagSize;
+
+    /* 
+    *  Spec definition of the length field size:
+    *
+    *  When bit b8 of the most significant byte of the length field is set to 1, 
+    * the subsequent bits b7 to b1 of the most significant byte code the number of 
+    *  subsequent bytes in the length field. The subsequent bytes code an integer 
+    * representing the number of bytes in the value field. Two bytes are necessary 
+    * to express up to 255 bytes in the value field.
+    */
+    uint8_t lengthByte = *dataP;
+    tlvObjOut->lengthSize = (lengthByte & MULTPLES_BYTES_LENGTH_MASK) ? (lengthByte & ~MULTPLES_BYTES_LENGTH_MASK) + 1 : 1;
+
+    // The indefinite form (0x80) is not allowed in BER-TLV data objects
+    error = (lengthByte == MULTPLES_BYTES_LENGTH_MASK) || (tlvObjOut->lengthSize > MAX_LENGTH_FIELD_SIZE);
+    BER_TLV_ASSERT_HEADER(ctx, !error, "Unsupported length field (0x%02X). Only the short form and up to %d "
+                                          "subsequent length bytes are allowed. Interrupting data parsing.\n",
+                                  lengthByte,
+                                  MAX_LENGTH_FIELD_SIZE - 1);
+    if (error)
+        return BER_TLV_ERR_BAD_LENGTH_FORM;
+
+    size_t headerSize = tlvObjOut->tagSize + tlvObjOut->lengthSize;
+    error = size < headerSize;
+    BER_TLV_ASSERT_HEADER(ctx, size >= headerSize, "Invalid size (%zu). It should be at "
+                                                      "least the header size (%zu). Interrupting data parsing.\n",
+                                  size,
+                                  headerSize);
+    if (error)
+        return BER_TLV_ERR_TRUNCATED_HEADER;
+
+    // The length field value keeps the first length byte, the value size only the subsequent bytes
+    tlvObjOut->valueSize = __readValueSize(dataP, size - tlvObjOut->tagSize, tlvObjOut->lengthSize);
+    tlvObjOut->lengthValue = ((uint64_t)lengthByte << (8 * (tlvObjOut->lengthSize - 1))) | tlvObjOut->valueSize;
+
+    error = (size - headerSize) < tlvObjOut->valueSize;
+    BER_TLV_ASSERT_HEADER(ctx, !error, "Invalid size (%zu). It should be at least %zu bytes -> tag size(%d) +"
+                                          "length size(%d) + value size(%zu).\n Interrupting data parsing.",
+                                  size,
+                                  headerSize + tlvObjOut->valueSize,
+                                  tlvObjOut->tagSize,
+                                  tlvObjOut->lengthSize,
+                                  tlvObjOut->valueSize);
+    if (error)
+        return BER_TLV_ERR_TRUNCATED_VALUE;
+
+    tlvObjOut->value = dataP + tlvObjOut->lengthSize;
+    return BER_TLV_OK;
+}
+
+/**
+ * @brief Check the tag and the length field of an object, as __decodeHeader() without filling an object.
+ * @param data Pointer to the first tag byte
+ * @param size Bytes available from data, at least 1
+ * @param headerSizeOut Receives the size of the tag and length fields.
+ * @param valueSizeOut Receives the value size.
+ * @return BER_TLV_OK or the error found in the header.
+ */
+static EBerTlvError __scanHeader(const uint8_t *data, size_t size, size_t *headerSizeOut, size_t *valueSizeOut)
+{
+    uint8_t tagSize = 1;
+
+    bool subsequentTagByte = (*data & MULTIPLE_BYTES_TAG_MASK) == MULTIPLE_BYTES_TAG_MASK;
+    while (subsequentTagByte && tagSize < size && tagSize < MAX_TAG_SIZE)
+    {
+        subsequentTagByte = (data[tagSize++] & SUBSEQUENT_TAG_BYTE_MASK) != 0;
+    }
+    if (subsequentTagByte && tagSize == MAX_TAG_SIZE)
+        return BER_TLV_ERR_TAG_TOO_LONG;
+    if (size < (size_t)(MIN_HEADER_SIZE + tagSize - 1 + subsequentTagByte))
+        return BER_TLV_ERR_TRUNCATED_HEADER;
+
+    uint8_t lengthByte = data[tagSize];
+    uint8_t lengthSize = (lengthByte & MULTPLES_BYTES_LENGTH_MASK) ? (lengthByte & ~MULTPLES_BYTES_LENGTH_MASK) + 1 : 1;
+    if (lengthByte == MULTPLES_BYTES_LENGTH_MASK || lengthSize > MAX_LENGTH_FIELD_SIZE)
+        return BER_TLV_ERR_BAD_LENGTH_FORM;
+
+    size_t headerSize = tagSize + lengthSize;
+    if (size < headerSize)
+        return BER_TLV_ERR_TRUNCATED_HEADER;
+
+    size_t valueSize = __readValueSize(data + tagSize, size - tagSize, lengthSize);
+    if (size - headerSize < valueSize)
+        return BER_TLV_ERR_TRUNCATED_VALUE;
+
+    *headerSizeOut = headerSize;
+    *valueSizeOut = valueSize;
+    return BER_TLV_OK;
+}
+
+/**
+ * @brief Read the value size from the length field.
+ * 
+ * The short form is the first length byte. The 0x81 and 0x82 forms are read with one unaligned
+ * big-endian load, shifted and masked by field size, only the longer forms one byte at a time.
+ * @param lengthField Pointer to the first length byte
+ * @param available Bytes available from lengthField, at least lengthSize
+ * @param lengthSize Size of the length field, from 1 to MAX_LENGTH_FIELD_SIZE
+ * @return Value size
+ */
+static inline size_t __readValueSize(const uint8_t *lengthField, size_t available, uint8_t lengthSize)
+{
+    if (lengthSize == 1)
+        return lengthField[0];
+    if (lengthSize < FAST_LENGTH_FIELD_SIZES && available >= sizeof(uint32_t))
+    {
+        uint32_t word;
+        memcpy(&word, lengthField, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        word = __builtin_bswap32(word);
+#endif
+        return (word >> FAST_LENGTH_FIELD_SHIFTS[lengthSize]) & FAST_LENGTH_FIELD_MASKS[lengthSize];
+    }
+
+    size_t valueSize = 0;
+    for (uint8_t i = 1; i < lengthSize; ++i)
+    {
+        valueSize = (valueSize << 8) | lengthField[i];
+    }
+    return valueSize;
+}
+
+/**
+ * @brief Add a 2 space indentation into str for each level
+ * @param str string pointer
+ * @param constructedLevels Level of nested constructed objects.
+ * @return Amount of black space written
+ */
+static size_t __addIndentation(char *str, size_t constructedLevels)
+{
+    size_t spaceCount = constructedLevels * 2;
+    memset(str, ' ', spaceCount);
+    return spaceCount;
+}
+
+/**
+ * @brief Copy a constant text chunk into str
+ * @return Amount of characters written
+ */
+static uint16_t __addText(char *str, const TBerTlvText *text)
+{
+    memcpy(str, text->str, text->size);
+    return text->size;
+}
+
+/**
+ * @brief Write value in uppercase hexadecimal with at least two digits (same as "%02X")
+ * @return Amount of characters written
+ */
+static uint16_t __formatHex(char *str, uint32_t value)
+{
+    uint16_t digits = 2;
+    while (digits < 8 && (value >> (4 * digits)))
+    {
+        digits++;
+    }
+    for (uint16_t i = digits; i > 0; --i)
+    {
+        str[i - 1] = HEX_DIGITS[value & 0x0F];
+        value >>= 4;
+    }
+    return digits;
+}
+
+/**
+ * @brief Write value in decimal (same as "%zu")
+ * @return Amount of characters written
+ */
+static uint16_t __formatDecimal(char *str, uint64_t value)
+{
+    char digits[20];
+    uint16_t count = 0;
+    do
+    {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    for (uint16_t i = 0; i < count; ++i)
+    {
+        str[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+/**
+ * @brief Write the TAG line of an object, without indentation
+ * @return Amount of characters written
+ */
+static uint16_t __formatTagLine(char *str, TBerTlvObj *tlvObj)
+{
+    char *strP = str;
+
+    strP += __addText(strP, &TAG_LINE_PREFIX);
+    strP += __formatHex(strP, tlvObj->tag);
+    strP += __addText(strP, &TAG_LINE_SUFFIXES[tlvObj->tagClass][tlvObj->constructed]);
+    return strP - str;
+}
+
+/**
+ * @brief Write the LEN line of an object, without indentation
+ * @return Amount of characters written
+ */
+static uint16_t __formatLengthLine(char *str, TBerTlvObj *tlvObj)
+{
+    char *strP = str;
+
+    strP += __addText(strP, &LEN_LINE_PREFIX);
+    strP += __formatDecimal(strP, tlvObj->valueSize);
+    strP += __addText(strP, &LEN_LINE_SUFFIX);
+    return strP - str;
+}
+
+/**
+ * @brief Write the "0xHH " representation of each byte of data
+ * @return Amount of characters written
+ */
+static size_t __formatValueBytes(char *str, uint8_t *data, size_t size)
+{
+    char *strP = str;
+    while (size--)
+    {
+        memcpy(strP, &HEX_BYTE_STRINGS[*data++ * HEX_BYTE_STRING_SIZE], HEX_BYTE_STRING_SIZE);
+        strP += HEX_BYTE_STRING_SIZE;
+    }
+    return strP - str;
+}
+
+/**
+ * Skip garbage data (0x00 or OxFF) in begining of data.
+ * 
+ * Most objects aren't preceded by garbage data, so the first byte is checked before dispatching
+ * long runs of padding to the widest vector implementation supported by the CPU.
+ */
+static size_t __skipGarbageData(uint8_t *data, size_t size)
+{
+    if (size == 0 || (*data != 0 && *data != 0xFF))
+        return 0;
+
+#if defined(BER_TLV_SIMD_X86)
+    if (size >= 32 && __builtin_cpu_supports("avx2"))
+        return __skipGarbageDataAvx2(data, size);
+    return __skipGarbageDataSse2(data, size);
+#elif defined(BER_TLV_SIMD_NEON)
+    return __skipGarbageDataNeon(data, size);
+#else
+    return __skipGarbageDataScalar(data, size);
+#endif
+}
+
+/**
+ * @brief Byte by byte garbage data skipping, also used for the tail of vector implementations.
+ */
+static size_t __skipGarbageDataScalar(const uint8_t *data, size_t size)
+{
+    const uint8_t *dataPtr = data;
+    size_t skippedBytes = 0;
+
+    while (size && (*dataPtr == 0 || *dataPtr == 0xFF))
+    {
+        ++dataPtr;
         ++skippedBytes;
         size--;
     }
     return skippedBytes;
-}
\ No newline at end of file
+}
+
+#if defined(BER_TLV_SIMD_X86)
+/**
+ * @brief Garbage data skipping comparing 16 bytes per step (SSE2, always available on x86-64).
+ */
+static size_t __skipGarbageDataSse2(const uint8_t *data, size_t size)
+{
+    const __m128i zeros = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi8((char)0xFF);
+    size_t skippedBytes = 0;
+
+    while (size - skippedBytes >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(data + skippedBytes));
+        __m128i garbage = _mm_or_si128(_mm_cmpeq_epi8(chunk, zeros), _mm_cmpeq_epi8(chunk, ones));
+        uint32_t dataMask = ~(uint32_t)_mm_movemask_epi8(garbage) & 0xFFFF;
+        if (dataMask)
+            return skippedBytes + __builtin_ctz(dataMask);
+        skippedBytes += 16;
+    }
+    return skippedBytes + __skipGarbageDataScalar(data + skippedBytes, size - skippedBytes);
+}
+
+/**
+ * @brief Garbage data skipping comparing 32 bytes per step (AVX2, checked at runtime).
+ */
+__attribute__((target("avx2"))) static size_t __skipGarbageDataAvx2(const uint8_t *data, size_t size)
+{
+    const __m256i zeros = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi8((char)0xFF);
+    size_t skippedBytes = 0;
+
+    while (size - skippedBytes >= 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(data + skippedBytes));
+        __m256i garbage = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, zeros), _mm256_cmpeq_epi8(chunk, ones));
+        uint32_t dataMask = ~(uint32_t)_mm256_movemask_epi8(garbage);
+        if (dataMask)
+            return skippedBytes + __builtin_ctz(dataMask);
+        skippedBytes += 32;
+    }
+    return skippedBytes + __skipGarbageDataSse2(data + skippedBytes, size - skippedBytes);
+}
+
+#elif defined(BER_TLV_SIMD_NEON)
+/**
+ * @brief Garbage data skipping comparing 16 bytes per step (NEON).
+ */
+static size_t __skipGarbageDataNeon(const uint8_t *data, size_t size)
+{
+    const uint8x16_t zeros = vdupq_n_u8(0x00);
+    const uint8x16_t ones = vdupq_n_u8(0xFF);
+    size_t skippedBytes = 0;
+
+    while (size - skippedBytes >= 16)
+    {
+        uint8x16_t chunk = vld1q_u8(data + skippedBytes);
+        uint8x16_t garbage = vorrq_u8(vceqq_u8(chunk, zeros), vceqq_u8(chunk, ones));
+        // Every lane is 0xFF only if the whole chunk is garbage data
+        if (vminvq_u8(garbage) != 0xFF)
+            break;
+        skippedBytes += 16;
+    }
+    return skippedBytes + __skipGarbageDataScalar(data + skippedBytes, size - skippedBytes);
+}
+#endif
+
+/**
+ * @brief Home slot of a tag in the index tag table (multiplicative hashing).
+ */
+static size_t __tagTableSlot(const TBerTlvIndex *index, uint32_t tag)
+{
+    return (size_t)(((uint64_t)tag * 0x9E3779B97F4A7C15u) >> 32) & (index->tagTableSize - 1);
+}
+
+/**
+ * @brief Insert an entry in the index tag table using linear probing.
+ * 
+ * Entries with the same tag are inserted in data order, so probing visits them in data order too.
+ * @return true if the table is full.
+ */
+static bool __tagTableInsert(TBerTlvIndex *index, size_t entryIndex)
+{
+    if (index->tagTableSize == 0)
+        return false;
+    if (entryIndex >= index->tagTableSize)
+        return true;
+
+    size_t mask = index->tagTableSize - 1;
+    size_t slot = __tagTableSlot(index, index->entries[entryIndex].obj.tag);
+
+    while (index->tagTable[slot] != BER_TLV_EMPTY_SLOT)
+    {
+        slot = (slot + 1) & mask;
+    }
+    index->tagTable[slot] = entryIndex;
+    return false;
+}
+
+/**
+ * @brief Find the next entry with a given tag.
+ * @param cursor Search state, must be 0 on the first call.
+ * @return Entry index or BER_TLV_EMPTY_SLOT when there are no more entries with this tag.
+ */
+static size_t __findEntry(const TBerTlvIndex *index, uint32_t tag, size_t *cursor)
+{
+    if (index->tagTableSize == 0)
+    {
+        // No tag table, the cursor is the next entry to be checked
+        while (*cursor < index->count)
+        {
+            size_t entryIndex = (*cursor)++;
+            if (index->entries[entryIndex].obj.tag == tag)
+                return entryIndex;
+        }
+        return BER_TLV_EMPTY_SLOT;
+    }
+
+    // Tag table, the cursor is the number of probed slots
+    size_t mask = index->tagTableSize - 1;
+    size_t homeSlot = __tagTableSlot(index, tag);
+
+    while (*cursor < index->tagTableSize)
+    {
+        size_t entryIndex = index->tagTable[(homeSlot + *cursor) & mask];
+        (*cursor)++;
+        if (entryIndex == BER_TLV_EMPTY_SLOT)
+            break;
+        if (index->entries[entryIndex].obj.tag == tag)
+            return entryIndex;
+    }
+    *cursor = index->tagTableSize;
+    return BER_TLV_EMPTY_SLOT;
+}
+
+/**
+ * @brief Check if an entry and its ancestors match a path of tags starting at top-level.
+ */
+static bool __matchPath(const TBerTlvIndex *index, size_t entryIndex, const uint32_t *path, size_t pathSize)
+{
+    if (index->entries[entryIndex].depth != pathSize - 1)
+        return false;
+
+    while (pathSize--)
+    {
+        const TBerTlvIndexEntry *entry = &index->entries[entryIndex];
+        if (entry->obj.tag != path[pathSize])
+            return false;
+        entryIndex = entry->parent;
+    }
+    return true;
+}
+
+/**
+ * @brief Get contiguous space in the sink buffer, flushing it if needed.
+ * @return Pointer to at least size free bytes or NULL if the buffer can't provide them.
+ */
+static char *__sinkReserve(TBerTlvSink *sink, size_t size)
+{
+    if (sink->capacity - sink->used < size)
+    {
+        if (sink->write == NULL || berTlv_sinkFlush(sink) || sink->capacity < size)
+            return NULL;
+    }
+    return sink->buffer + sink->used;
+}
+
+/**
+ * @brief Account for size bytes written in the space returned by __sinkReserve().
+ */
+static void __sinkCommit(TBerTlvSink *sink, size_t size)
+{
+    sink->used += size;
+    sink->bytesWriten += size;
+}
+
+/**
+ * @brief Copy a string into the sink, flushing the buffer as often as needed.
+ * 
+ * When a fixed buffer is full, the text is only counted.
+ */
+static void __sinkWrite(TBerTlvSink *sink, const char *str, size_t size)
+{
+    if (sink->truncated)
+    {
+        sink->bytesWriten += size;
+        return;
+    }
+
+    while (size && !sink->error)
+    {
+        size_t freeSize = sink->capacity - sink->used;
+        if (freeSize == 0)
+        {
+            if (sink->write == NULL)
+            {
+                sink->truncated = true;
+                sink->bytesWriten += size;
+                return;
+            }
+            if (berTlv_sinkFlush(sink))
+                return;
+            continue;
+        }
+        size_t chunkSize = size < freeSize ? size : freeSize;
+        memcpy(sink->buffer + sink->used, str, chunkSize);
+        __sinkCommit(sink, chunkSize);
+        str += chunkSize;
+        size -= chunkSize;
+    }
+}
+
+/**
+ * @brief Write count times the character c into the sink.
+ */
+static void __sinkFill(TBerTlvSink *sink, char c, size_t count)
+{
+    char chunk[32];
+
+    memset(chunk, c, sizeof(chunk));
+    while (count)
+    {
+        size_t chunkSize = count < sizeof(chunk) ? count : sizeof(chunk);
+        __sinkWrite(sink, chunk, chunkSize);
+        count -= chunkSize;
+    }
+}
+
+/**
+ * @brief Keep the text of a fixed buffer NUL-terminated, as sprintf() would.
+ */
+static void __sinkTerminate(TBerTlvSink *sink)
+{
+    if (sink->write == NULL && sink->used < sink->capacity)
+    {
+        sink->buffer[sink->used] = '\0';
+    }
+}
+
+/**
+ * @brief Print the indented TAG and LEN lines of an object.
+ */
+static void __printHeaderLines(TBerTlvSink *sink, TBerTlvObj *tlvObj, size_t constructedLevels)
+{
+    size_t indentationSize = constructedLevels * 2;
+    char *strP = __sinkReserve(sink, 2 * indentationSize + HEADER_LINES_MAX_SIZE);
+
+    if (strP)
+    {
+        char *startPos = strP;
+        strP += __addIndentation(strP, constructedLevels);
+        strP += __formatTagLine(strP, tlvObj);
+        strP += __addIndentation(strP, constructedLevels);
+        strP += __formatLengthLine(strP, tlvObj);
+        __sinkCommit(sink, strP - startPos);
+        return;
+    }
+
+    // Small or full sink buffer, format each line apart and copy it in chunks
+    char line[HEADER_LINES_MAX_SIZE];
+    __sinkFill(sink, ' ', indentationSize);
+    __sinkWrite(sink, line, __formatTagLine(line, tlvObj));
+    __sinkFill(sink, ' ', indentationSize);
+    __sinkWrite(sink, line, __formatLengthLine(line, tlvObj));
+}
+
+/**
+ * @brief Print the indented VAL line of a primitive object.
+ */
+static void __printValueLine(TBerTlvSink *sink, uint8_t *data, size_t size, size_t constructedLevels)
+{
+    __sinkFill(sink, ' ', constructedLevels * 2);
+    __sinkWrite(sink, VAL_LINE_PREFIX.str, VAL_LINE_PREFIX.size);
+
+    while (size && !sink->error)
+    {
+        size_t chunkSize = (sink->capacity - sink->used) / HEX_BYTE_STRING_SIZE;
+        if (chunkSize == 0 || sink->truncated)
+        {
+            if (sink->write == NULL)
+            {
+                // Fixed buffer is full: the beginning of the next byte fills it, the remaining text is only counted
+                __sinkWrite(sink, &HEX_BYTE_STRINGS[*data * HEX_BYTE_STRING_SIZE], HEX_BYTE_STRING_SIZE);
+                sink->truncated = true;
+                sink->bytesWriten += (size - 1) * HEX_BYTE_STRING_SIZE;
+                break;
+            }
+            if (sink->used == 0)
+            {
+                // Buffer smaller than a single byte representation
+                __sinkWrite(sink, &HEX_BYTE_STRINGS[*data++ * HEX_BYTE_STRING_SIZE], HEX_BYTE_STRING_SIZE);
+                size--;
+                continue;
+            }
+            berTlv_sinkFlush(sink);
+            continue;
+        }
+        if (chunkSize > size)
+            chunkSize = size;
+        __sinkCommit(sink, __formatValueBytes(sink->buffer + sink->used, data, chunkSize));
+        data += chunkSize;
+        size -= chunkSize;
+    }
+    __sinkWrite(sink, "\n", 1);
+}
+
+/**
+ * @brief Print data bytes as uppercase hexadecimal digits, without separators.
+ */
+static void __printHexBytes(TBerTlvSink *sink, uint8_t *data, size_t size)
+{
+    while (size && !sink->error)
+    {
+        size_t chunkSize = (sink->capacity - sink->used) / 2;
+        if (chunkSize == 0 || sink->truncated)
+        {
+            char digits[2] = {HEX_DIGITS[*data >> 4], HEX_DIGITS[*data & 0x0F]};
+            if (sink->write == NULL)
+            {
+                // Fixed buffer is full: the first digit may fill it, the remaining text is only counted
+                __sinkWrite(sink, digits, 2);
+                sink->truncated = true;
+                sink->bytesWriten += (size - 1) * 2;
+                break;
+            }
+            if (sink->used == 0)
+            {
+                // Buffer smaller than a single byte representation
+                __sinkWrite(sink, digits, 2);
+                data++;
+                size--;
+                continue;
+            }
+            berTlv_sinkFlush(sink);
+            continue;
+        }
+        if (chunkSize > size)
+            chunkSize = size;
+
+        char *strP = sink->buffer + sink->used;
+        for (size_t i = 0; i < chunkSize; ++i)
+        {
+            *strP++ = HEX_DIGITS[data[i] >> 4];
+            *strP++ = HEX_DIGITS[data[i] & 0x0F];
+        }
+        __sinkCommit(sink, chunkSize * 2);
+        data += chunkSize;
+        size -= chunkSize;
+    }
+}
+
+/**
+ * @brief Print the HEX line of an object.
+ */
+static void __printHexLine(TBerTlvSink *sink, TBerTlvObj *tlvObj, size_t depth)
+{
+    char line[FORMAT_LINE_MAX_SIZE];
+    char *strP = line;
+
+    strP += __formatDecimal(strP, depth);
+    *strP++ = ' ';
+    strP += __formatHex(strP, tlvObj->tag);
+    *strP++ = ' ';
+    strP += __formatDecimal(strP, tlvObj->valueSize);
+    if (!tlvObj->constructed && tlvObj->valueSize)
+        *strP++ = ' ';
+    __sinkWrite(sink, line, strP - line);
+
+    if (!tlvObj->constructed)
+        __printHexBytes(sink, tlvObj->value, tlvObj->valueSize);
+    __sinkWrite(sink, "\n", 1);
+}
+
+/**
+ * @brief Print the JSON line of an object.
+ */
+static void __printJsonLine(TBerTlvSink *sink, TBerTlvObj *tlvObj, size_t offset, size_t depth)
+{
+    char line[FORMAT_LINE_MAX_SIZE];
+    char *strP = line;
+
+    strP += __addText(strP, &JSON_OFFSET);
+    strP += __formatDecimal(strP, offset);
+    strP += __addText(strP, &JSON_DEPTH);
+    strP += __formatDecimal(strP, depth);
+    strP += __addText(strP, &JSON_TAG);
+    strP += __formatHex(strP, tlvObj->tag);
+    strP += __addText(strP, &JSON_CLASS);
+    strP += __addText(strP, &JSON_CLASSES[tlvObj->tagClass & 0x03]);
+    strP += __addText(strP, tlvObj->constructed ? &JSON_CONSTRUCTED : &JSON_PRIMITIVE);
+    strP += __formatDecimal(strP, tlvObj->valueSize);
+    if (tlvObj->constructed)
+    {
+        *strP++ = '}';
+        *strP++ = '\n';
+        __sinkWrite(sink, line, strP - line);
+        return;
+    }
+
+    strP += __addText(strP, &JSON_VALUE);
+    __sinkWrite(sink, line, strP - line);
+    __printHexBytes(sink, tlvObj->value, tlvObj->valueSize);
+    __sinkWrite(sink, "\"}\n", 3);
+}
+
+/**
+ * @brief Print the BINARY record of an object.
+ */
+static void __printBinaryRecord(TBerTlvSink *sink, TBerTlvObj *tlvObj, size_t depth)
+{
+    uint8_t record[BINARY_RECORD_HEADER_SIZE];
+
+    record[0] = (depth >> 8) & 0xFF;
+    record[1] = depth & 0xFF;
+    for (uint8_t i = 0; i < 4; ++i)
+    {
+        record[2 + i] = (tlvObj->tag >> (8 * (3 - i))) & 0xFF;
+        record[7 + i] = (tlvObj->valueSize >> (8 * (3 - i))) & 0xFF;
+    }
+    record[6] = tlvObj->constructed;
+    __sinkWrite(sink, (const char *)record, sizeof(record));
+
+    if (!tlvObj->constructed && tlvObj->valueSize)
+        __sinkWrite(sink, (const char *)tlvObj->value, tlvObj->valueSize);
+}
+
+/**
+ * @brief Sink write callback of berTlv_sinkInitFile().
+ */
+static bool __fileSinkWrite(void *userData, const char *str, size_t size)
+{
+    return fwrite(str, 1, size, (FILE *)userData) != size;
+}
+
+/**
+ * @brief Sink write callback of berTlv_sinkInitFd().
+ */
+static bool __fdSinkWrite(void *userData, const char *str, size_t size)
+{
+    int fd = (int)(intptr_t)userData;
+
+    while (size)
+    {
+        ssize_t writen = write(fd, str, size);
+        if (writen < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return true;
+        }
+        str += writen;
+        size -= writen;
+    }
+    return false;
+}
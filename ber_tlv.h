@@ -10,48 +10,603 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief Linkage of the public functions
+ *
+ * Exported from the shared library even when it is built with -fvisibility=hidden. Define it as
+ * `static inline` before including ber_tlv_amalgamation.c to compile the whole lib into a single
+ * translation unit.
+ */
+#ifndef BER_TLV_API
+#if defined(__GNUC__)
+#define BER_TLV_API __attribute__((visibility("default")))
+#else
+#define BER_TLV_API
+#endif
+#endif
+
+/**
+ * @brief Error codes returned by the parsing functions
+ */
+typedef enum
+{
+    //! No error
+    BER_TLV_OK = 0,
+    //! Data ends within the tag or the length field of an object
+    BER_TLV_ERR_TRUNCATED_HEADER,
+    //! Value field goes past the end of the data or of the enclosing constructed object
+    BER_TLV_ERR_TRUNCATED_VALUE,
+    //! Indefinite length form (0x80) or more than 4 subsequent length bytes
+    BER_TLV_ERR_BAD_LENGTH_FORM,
+    //! Constructed objects nested deeper than supported
+    BER_TLV_ERR_DEPTH_OVERFLOW,
+    //! Caller supplied storage (index, tag table, buffer) is full
+    BER_TLV_ERR_NO_SPACE,
+    //! Parsing interrupted by a callback
+    BER_TLV_ERR_INTERRUPTED,
+    //! Tag field longer than 4 bytes
+    BER_TLV_ERR_TAG_TOO_LONG,
+    //! Object longer than allowed by its schema (see ber_tlv_schema.h)
+    BER_TLV_ERR_SCHEMA_VIOLATION,
+    //! Invalid argument, e.g. patching the value of a constructed object
+    BER_TLV_ERR_INVALID_ARGUMENT,
+    //! Number of error codes
+    BER_TLV_ERR_COUNT
+} EBerTlvError;
+
+/**
+ * @brief Class of a BER TLV object, coded in bits b8 and b7 of the first tag byte
+ */
+typedef enum
+{
+    BER_TLV_CLASS_UNIVERSAL = 0,
+    BER_TLV_CLASS_APPLICATION,
+    BER_TLV_CLASS_CONTEXT_SPECIFIC,
+    BER_TLV_CLASS_PRIVATE
+} EBerTlvClass;
 
 /**
  * @brief BER TLV object
  */
 typedef struct
 {
-    //! tag value
-    uint16_t tag; 
+    //! tag value, with the tag bytes packed big-endian (e.g. 0x9F02, 0xDF8101)
+    uint32_t tag;
     //! size of tag field in bytes
     uint16_t tagSize;
     //! Length field value
-    uint32_t lengthValue; 
+    uint64_t lengthValue; 
     //! Size of length field in bytes
     uint8_t lengthSize;
+    //! Object class (EBerTlvClass)
+    uint8_t tagClass;
+    //! Constructed object, its value holds other objects
+    bool constructed;
     //! Size of value field in byts
-    uint16_t valueSize;
+    size_t valueSize;
     //! Pointer to the value field
     uint8_t * value;
 } TBerTlvObj;
 
+//! Parent index of top-level objects in a TBerTlvIndex
+#define BER_TLV_NO_PARENT SIZE_MAX
+//! Value of an unused slot of an index tag table
+#define BER_TLV_EMPTY_SLOT SIZE_MAX
+
+/**
+ * @brief Entry of a flat BER TLV index
+ */
+typedef struct
+{
+    //! Parsed object. Its value pointer points into the indexed data.
+    TBerTlvObj obj;
+    //! Offset of the first tag byte from the start of the indexed data
+    size_t offset;
+    //! Offset of the first value byte from the start of the indexed data
+    size_t valueOffset;
+    //! Offset of the first byte after the object
+    size_t end;
+    //! Index of the enclosing constructed object entry or BER_TLV_NO_PARENT
+    size_t parent;
+    //! Nesting level of the object, 0 for top-level objects
+    uint16_t depth;
+} TBerTlvIndexEntry;
+
+/**
+ * @brief Flat index of all BER TLV objects of a raw data array
+ * 
+ * Entries are stored in the order the objects appear in the data, so the children of a
+ * constructed object always follow their parent entry.
+ */
+typedef struct
+{
+    //! Indexed raw data
+    uint8_t *data;
+    //! Indexed data size in bytes
+    size_t size;
+    //! Caller supplied entries array
+    TBerTlvIndexEntry *entries;
+    //! Number of elements of the entries array
+    size_t capacity;
+    //! Number of entries filled by berTlv_index()
+    size_t count;
+    //! Offset of the object that caused the error returned by berTlv_index()
+    size_t errorOffset;
+    //! Optional open addressing tag table, holds entry indexes
+    size_t *tagTable;
+    //! Number of slots of the tag table (power of two), 0 if there is no tag table
+    size_t tagTableSize;
+} TBerTlvIndex;
+
+/**
+ * @brief Depth-first traversal of the objects of a raw data array
+ * 
+ * The end offset of each open constructed object is kept in a caller supplied stack, so the
+ * nesting depth is only limited by the stack capacity and no other memory is used.
+ */
+typedef struct
+{
+    //! Walked raw data
+    uint8_t *data;
+    //! Data size in bytes
+    size_t size;
+    //! Offset of the next object
+    size_t position;
+    //! Caller supplied stack, end offset of each open constructed object
+    size_t *endStack;
+    //! Number of elements of the stack, which is the maximum nesting level
+    size_t stackCapacity;
+    //! Number of open constructed objects
+    size_t depth;
+    //! Offset of the object that caused the error returned by berTlv_walkNext()
+    size_t errorOffset;
+} TBerTlvWalker;
+
+/**
+ * @brief Lazy iterator over the objects of a raw data array
+ * 
+ * Only the headers of the returned objects are decoded. The children of a constructed object are
+ * iterated only if berTlv_iterEnter() is called, otherwise they are jumped over using its value size.
+ */
+typedef struct
+{
+    //! Iterated raw data
+    uint8_t *data;
+    //! Data size in bytes
+    size_t size;
+    //! Offset of the next object to be parsed
+    size_t position;
+    //! Caller supplied stack, end offset of each entered constructed object
+    size_t *endStack;
+    //! Number of elements of the stack, which is the maximum nesting level
+    size_t stackCapacity;
+    //! Number of entered constructed objects, it is the nesting level of the last returned object
+    size_t depth;
+    //! Last object returned by berTlv_iterNext()
+    TBerTlvObj obj;
+    //! Offset of the last object returned by berTlv_iterNext()
+    size_t objOffset;
+    //! Offset of the object that caused the error returned by berTlv_iterNext()
+    size_t errorOffset;
+} TBerTlvIter;
+
+/**
+ * @brief Write callback of an output sink.
+ * @param userData User data given to berTlv_sinkInit().
+ * @param str Text to be written, not NUL-terminated.
+ * @param size Text size in bytes.
+ * @return true if an error happened. Printing is interrupted.
+ */
+typedef bool (*TBerTlvSinkWriteFn)(void *userData, const char *str, size_t size);
+
+/**
+ * @brief Output sink of the printer
+ * 
+ * Text is formatted into a fixed buffer. When the buffer is full it is flushed through the write
+ * callback, so an output of any size can be printed with a small buffer. Without write callback the 
+ * buffer is a bounded output string: text that doesn't fit is dropped and only counted.
+ */
+typedef struct
+{
+    //! Buffer where the text is formatted
+    char *buffer;
+    //! Buffer size in bytes
+    size_t capacity;
+    //! Bytes currently stored in the buffer
+    size_t used;
+    //! Write callback, NULL for a buffer that is never flushed
+    TBerTlvSinkWriteFn write;
+    //! User data given to the write callback
+    void *userData;
+    //! Total bytes of text printed into the sink, including dropped ones
+    size_t bytesWriten;
+    //! Set when text was dropped because a buffer without write callback is full
+    bool truncated;
+    //! Set when the write callback failed
+    bool error;
+} TBerTlvSink;
+
+/**
+ * @brief Initialize an output sink.
+ * @param sink Sink to be initialized.
+ * @param buffer Buffer where the text is formatted.
+ * @param capacity Buffer size in bytes.
+ * @param write Write callback or NULL for an output string that is never flushed.
+ * @param userData User data given to the write callback.
+ */
+BER_TLV_API void berTlv_sinkInit(TBerTlvSink *sink, char *buffer, size_t capacity, TBerTlvSinkWriteFn write,
+                                 void *userData);
+
+/**
+ * @brief Initialize an output sink that flushes its buffer into a stdio stream.
+ */
+BER_TLV_API void berTlv_sinkInitFile(TBerTlvSink *sink, char *buffer, size_t capacity, FILE *file);
+
+/**
+ * @brief Initialize an output sink that flushes its buffer into a file descriptor.
+ */
+BER_TLV_API void berTlv_sinkInitFd(TBerTlvSink *sink, char *buffer, size_t capacity, int fd);
+
+/**
+ * @brief Write the buffered text through the sink write callback.
+ * @return true if the sink is in error.
+ */
+BER_TLV_API bool berTlv_sinkFlush(TBerTlvSink *sink);
+
+/**
+ * @brief Write text into an output sink, e.g. text printed earlier.
+ * @param sink Output sink.
+ * @param str Text to be written, not NUL-terminated.
+ * @param size Text size in bytes.
+ */
+BER_TLV_API void berTlv_sinkWrite(TBerTlvSink *sink, const char *str, size_t size);
+
+/**
+ * @brief Print raw data as BER TLV objects into an output sink.
+ * 
+ * The sink is flushed before returning.
+ * @param data pointer to raw data.
+ * @param size Data size in bytes.
+ * @param sink Output sink.
+ * @return Total bytes printed.
+ */
+BER_TLV_API size_t berTlv_printToSink(uint8_t *data, size_t size, TBerTlvSink *sink);
+
+/**
+ * @brief Output formats of the printer
+ */
+typedef enum
+{
+    //! TAG, LEN and VAL lines, indented by nesting level
+    BER_TLV_FORMAT_TEXT = 0,
+    //! One line per object with the nesting level, the tag, the value size and the value bytes of a
+    //! primitive object in hexadecimal, e.g. "1 9F02 6 000000001000"
+    BER_TLV_FORMAT_HEX,
+    //! One JSON object per line with the offset, nesting level, tag, class, object type, value size
+    //! and the value bytes of a primitive object in hexadecimal
+    BER_TLV_FORMAT_JSON,
+    //! One record per object: nesting level (2 bytes), tag (4 bytes), 1 for a constructed object or
+    //! 0 (1 byte) and value size (4 bytes), all big-endian, then the value bytes of a primitive object
+    BER_TLV_FORMAT_BINARY,
+    //! Number of formats
+    BER_TLV_FORMAT_COUNT
+} EBerTlvFormat;
+
+/**
+ * @brief Print raw data as BER TLV objects into an output sink, in the given format.
+ * 
+ * Each object is formatted straight into the sink while the data is walked once. The sink is
+ * flushed before returning.
+ * @param data pointer to raw data.
+ * @param size Data size in bytes.
+ * @param sink Output sink.
+ * @param format Output format. berTlv_printToSink() is BER_TLV_FORMAT_TEXT.
+ * @return Total bytes printed.
+ */
+BER_TLV_API size_t berTlv_printFormatToSink(uint8_t *data, size_t size, TBerTlvSink *sink, EBerTlvFormat format);
+
+/**
+ * @brief Print raw data as BER TLV objects into a bounded output string.
+ * 
+ * The output is always NUL-terminated. Like snprintf(), the returned value is the size of the
+ * whole text, so a value greater or equal to capacity means that the output was truncated.
+ * @param data pointer to raw data.
+ * @param size Data size in bytes.
+ * @param outputStr pointer to output string.
+ * @param capacity Size of the output string in bytes, including the terminator.
+ * @return Total bytes of text, excluding the terminator.
+ */
+BER_TLV_API size_t berTlv_printToBuffer(uint8_t *data, size_t size, char *outputStr, size_t capacity);
 
 /**
  * Prints raw data as BER TLV objects
+ * @warning outputStr must be large enough for the whole text, see berTlv_printToBuffer() for a 
+ * bounded alternative.
  * @param data pointer to raw data.
  * @param size Data size in bytes.
  * @param outputStr pointer to output string.
  * @return Total bytes writen.
  */
-uint16_t berTlv_printFromRawData(uint8_t *data, uint16_t size, char *outputStr);
+BER_TLV_API size_t berTlv_printFromRawData(uint8_t *data, size_t size, char *outputStr);
+
+/**
+ * @brief Get a short description of an error code.
+ */
+BER_TLV_API const char *berTlv_errorString(EBerTlvError error);
+
+/**
+ * @brief Counters of the calling thread or of a context, only updated when the library is built with
+ * -DBER_TLV_STATS=1
+ */
+typedef struct
+{
+    //! Objects whose header was parsed
+    uint64_t objectsParsed;
+    //! Garbage bytes (0x00 and 0xFF) skipped between top-level objects
+    uint64_t garbageBytesSkipped;
+    //! Errors returned, by error code
+    uint64_t errors[BER_TLV_ERR_COUNT];
+    //! Deepest nesting level of a parsed object, 0 for top-level objects
+    size_t maxDepth;
+    //! Text bytes formatted by the printing functions, also when written from a cache
+    uint64_t bytesFormatted;
+} TBerTlvStats;
+
+/**
+ * @brief Get the counters of the calling thread. They are all 0 without BER_TLV_STATS.
+ */
+BER_TLV_API void berTlv_statsGet(TBerTlvStats *statsOut);
+
+/**
+ * @brief Set the counters of the calling thread to 0.
+ */
+BER_TLV_API void berTlv_statsReset(void);
 
 /**
  * @brief Parse an raw data array.
  * @warning: As garbage data is allowed before, between and after tlv objects, this function will 
- * skip garbage data and update size accordingly.
+ * skip garbage data and update size accordingly. This is done before any error check, so on 
+ * error the faulty object starts at offset (original size - size) of data.
  * @param data Raw data pointer
  * @param size Data size in bytes
  * @param tlvObjOut Pointer to tlv object that will be filled with parsed data.
  * @param isNotInConstructedObject  Infors if the current object is within a constructed object.
- * @return true if an error happened during the data parsing.
+ * @return BER_TLV_OK (0) or the error that happened during the data parsing.
+ */
+BER_TLV_API EBerTlvError berTlv_parseRawData(uint8_t *data, size_t *size, TBerTlvObj *tlvObjOut,
+                                             bool isNotInConstructedObject);
+
+/**
+ * @brief Initialize an index over a caller supplied entries array.
+ * @param index Index to be initialized.
+ * @param entries Entries array.
+ * @param capacity Number of elements of the entries array.
+ */
+BER_TLV_API void berTlv_indexInit(TBerTlvIndex *index, TBerTlvIndexEntry *entries, size_t capacity);
+
+/**
+ * @brief Attach a tag table to an index, so tags can be found without scanning the entries.
+ * 
+ * The table is filled by berTlv_index() while the entries are parsed. Use at least twice the 
+ * number of entries to keep the lookup probes short.
+ * @param index Index initialized with berTlv_indexInit().
+ * @param slots Tag table slots array.
+ * @param slotCount Number of slots. It must be a power of two greater than the index capacity.
+ */
+BER_TLV_API void berTlv_indexSetTagTable(TBerTlvIndex *index, size_t *slots, size_t slotCount);
+
+/**
+ * @brief Parse a whole raw data array into a flat index in a single pass.
+ * 
+ * Nothing is copied: every entry points into data, which must outlive the index.
+ * Garbage data is skipped only between top-level objects.
+ * @param data Raw data pointer
+ * @param size Data size in bytes
+ * @param index Index initialized with berTlv_indexInit().
+ * @return BER_TLV_OK or the error that happened during the data parsing, BER_TLV_ERR_NO_SPACE if
+ * the index or its tag table is full. On error errorOffset is set and the entries parsed before 
+ * the error are kept in the index.
+ */
+BER_TLV_API EBerTlvError berTlv_index(uint8_t *data, size_t size, TBerTlvIndex *index);
+
+/**
+ * @brief Check the framing of a raw data array without parsing the objects.
+ * 
+ * Only the tag and length fields are read, in a single loop: no object is filled, nothing is
+ * printed and no diagnostics are written. The result is the same as berTlv_index() with enough
+ * entries, for up to BER_TLV_VALIDATE_MAX_DEPTH (256 by default) nested constructed objects.
+ * @param data Raw data pointer
+ * @param size Data size in bytes
+ * @param errorOffset Receives the offset of the object that caused the error. May be NULL.
+ * @return BER_TLV_OK if the data is well formed, the parsing error otherwise, or
+ * BER_TLV_ERR_DEPTH_OVERFLOW if the objects are nested too deep.
  */
-bool berTlv_parseRawData(uint8_t *data, uint16_t *size, TBerTlvObj *tlvObjOut, bool isNotInConstructedObject);
+BER_TLV_API EBerTlvError berTlv_validate(const uint8_t *data, size_t size, size_t *errorOffset);
 
+/**
+ * @brief Fill the tag table of an index from its entries.
+ * 
+ * berTlv_index() fills the tag table by itself, this is needed for entries filled some other way,
+ * e.g. merged by berTlv_batchIndex().
+ * @param index Index with entries and a tag table.
+ * @return BER_TLV_OK or BER_TLV_ERR_NO_SPACE if the tag table is full.
+ */
+BER_TLV_API EBerTlvError berTlv_indexFillTagTable(TBerTlvIndex *index);
+/**
+ * @brief Find the first object with a given tag in an index.
+ * @param index Index filled by berTlv_index().
+ * @param tag Tag value.
+ * @param tlvObjOut Pointer to the tlv object that will receive the found object. May be NULL.
+ * @return true if the tag was found.
+ */
+BER_TLV_API bool berTlv_find(const TBerTlvIndex *index, uint32_t tag, TBerTlvObj *tlvObjOut);
+
+/**
+ * @brief Find the first object matching a path of nested tags in an index.
+ * 
+ * path[0] is the tag of a top-level object and every following tag is the one of a direct child
+ * of the previous object, e.g. (uint32_t[]){0x70, 0x57} finds the track 2 data inside a READ 
+ * RECORD response template.
+ * @param index Index filled by berTlv_index().
+ * @param path Array of tag values.
+ * @param pathSize Number of tags in path.
+ * @param tlvObjOut Pointer to the tlv object that will receive the found object. May be NULL.
+ * @return true if the path was found.
+ */
+BER_TLV_API bool berTlv_findPath(const TBerTlvIndex *index, const uint32_t *path, size_t pathSize,
+                                 TBerTlvObj *tlvObjOut);
+
+/**
+ * @brief Start a depth-first traversal of raw data.
+ * @param walker Walker to be initialized.
+ * @param data pointer to raw data.
+ * @param size Data size in bytes.
+ * @param endStack Caller supplied stack of end offsets.
+ * @param stackCapacity Number of elements of endStack.
+ */
+BER_TLV_API void berTlv_walkInit(TBerTlvWalker *walker, uint8_t *data, size_t size, size_t *endStack,
+                                 size_t stackCapacity);
+
+/**
+ * @brief Parse the next object of a traversal, in data order.
+ * 
+ * The value of a constructed object is walked right after it. Garbage data is skipped between
+ * top-level objects and each object must fit in its enclosing constructed object.
+ * @param walker Walker started with berTlv_walkInit().
+ * @param tlvObjOut Pointer to the tlv object that will be filled. Its value is NULL when all data
+ * was walked.
+ * @param depthOut Nesting level of the object, 0 for top-level objects. May be NULL.
+ * @return BER_TLV_OK, BER_TLV_ERR_DEPTH_OVERFLOW if the stack is full or a parsing error. 
+ * walker->errorOffset is then the offset of the object that caused it.
+ */
+BER_TLV_API EBerTlvError berTlv_walkNext(TBerTlvWalker *walker, TBerTlvObj *tlvObjOut, size_t *depthOut);
+
+/**
+ * @brief Start a lazy iteration over the top-level objects of raw data.
+ * @param iter Iterator to be initialized.
+ * @param data pointer to raw data.
+ * @param size Data size in bytes.
+ * @param endStack Caller supplied stack of end offsets, used by berTlv_iterEnter(). May be NULL.
+ * @param stackCapacity Number of elements of endStack.
+ */
+BER_TLV_API void berTlv_iterBegin(TBerTlvIter *iter, uint8_t *data, size_t size, size_t *endStack,
+                                  size_t stackCapacity);
+
+/**
+ * @brief Parse the header of the next object.
+ * 
+ * The next object follows the last returned one, or is its first child after berTlv_iterEnter().
+ * When the entered constructed object ends, the iteration goes on with the objects that follow it.
+ * @param iter Iterator started with berTlv_iterBegin().
+ * @param tlvObjOut Pointer to the tlv object that will be filled. Its value is NULL when all data
+ * was iterated.
+ * @return BER_TLV_OK or the parsing error, iter->errorOffset is then the offset of the object that
+ * caused it.
+ */
+BER_TLV_API EBerTlvError berTlv_iterNext(TBerTlvIter *iter, TBerTlvObj *tlvObjOut);
+
+/**
+ * @brief Go into the last constructed object returned by berTlv_iterNext().
+ * 
+ * Nothing is done if the last returned object is primitive or was already entered.
+ * @param iter Iterator started with berTlv_iterBegin().
+ * @return BER_TLV_OK or BER_TLV_ERR_DEPTH_OVERFLOW if the stack is full.
+ */
+BER_TLV_API EBerTlvError berTlv_iterEnter(TBerTlvIter *iter);
+
+/**
+ * @brief Leave the innermost entered constructed object without parsing its remaining children.
+ * 
+ * The next berTlv_iterNext() returns the object that follows it. At top-level the remaining data
+ * is skipped.
+ * @param iter Iterator started with berTlv_iterBegin().
+ */
+BER_TLV_API void berTlv_iterSkip(TBerTlvIter *iter);
+
+/**
+ * @brief Parser context, holding all the traversal, error and statistics state of its owner
+ *
+ * The functions taking a context use no other state: no thread local counters and no stdout. A
+ * context is safe to use from one thread at a time, e.g. one context pinned to each worker thread
+ * runs without locks. The data, index and sinks given to a context must not be shared either.
+ */
+typedef struct
+{
+    //! Traversal of berTlv_ctxBegin() and berTlv_ctxNext()
+    TBerTlvWalker walker;
+    //! Error returned by the last context function, BER_TLV_OK if none
+    EBerTlvError error;
+    //! Offset of the object that caused the last error, in the data given with it
+    size_t errorOffset;
+    //! Counters of the context, only updated when the library is built with -DBER_TLV_STATS=1
+    TBerTlvStats stats;
+    //! Sink of the diagnostics, NULL to drop them. Nothing is written with -DBER_TLV_DIAGNOSTICS=0.
+    TBerTlvSink *diagnostics;
+} TBerTlvCtx;
+
+/**
+ * @brief Initialize a context, with no error and its counters set to 0.
+ * @param ctx Context to be initialized.
+ * @param endStack Caller supplied stack of end offsets of the traversal.
+ * @param stackCapacity Number of elements of endStack.
+ * @param diagnostics Sink of the diagnostics, flushed after each of them. May be NULL.
+ */
+BER_TLV_API void berTlv_ctxInit(TBerTlvCtx *ctx, size_t *endStack, size_t stackCapacity, TBerTlvSink *diagnostics);
+
+/**
+ * @brief Start a traversal of raw data, the nesting state is kept by the context.
+ * @param ctx Context initialized with berTlv_ctxInit().
+ * @param data pointer to raw data.
+ * @param size Data size in bytes.
+ */
+BER_TLV_API void berTlv_ctxBegin(TBerTlvCtx *ctx, uint8_t *data, size_t size);
+
+/**
+ * @brief Parse the next object of the traversal, see berTlv_walkNext().
+ * @param ctx Context started with berTlv_ctxBegin().
+ * @param tlvObjOut Pointer to the tlv object that will be filled. Its value is NULL when all data
+ * was walked.
+ * @param depthOut Nesting level of the object, 0 for top-level objects. May be NULL.
+ * @return BER_TLV_OK, BER_TLV_ERR_DEPTH_OVERFLOW if the stack is full or a parsing error, also
+ * stored in ctx->error with its offset.
+ */
+BER_TLV_API EBerTlvError berTlv_ctxNext(TBerTlvCtx *ctx, TBerTlvObj *tlvObjOut, size_t *depthOut);
+
+/**
+ * @brief Parse a whole raw data array into a flat index, see berTlv_index().
+ * @param ctx Context initialized with berTlv_ctxInit().
+ * @param data Raw data pointer
+ * @param size Data size in bytes
+ * @param index Index initialized with berTlv_indexInit().
+ * @return BER_TLV_OK or the error, also stored in ctx->error with its offset.
+ */
+BER_TLV_API EBerTlvError berTlv_ctxIndex(TBerTlvCtx *ctx, uint8_t *data, size_t size, TBerTlvIndex *index);
+
+/**
+ * @brief Check the framing of a raw data array, see berTlv_validate().
+ * @param ctx Context initialized with berTlv_ctxInit().
+ * @param data Raw data pointer
+ * @param size Data size in bytes
+ * @return BER_TLV_OK if the data is well formed or the error, also stored in ctx->error with its
+ * offset.
+ */
+BER_TLV_API EBerTlvError berTlv_ctxValidate(TBerTlvCtx *ctx, const uint8_t *data, size_t size);
+
+/**
+ * @brief Print raw data, see berTlv_printFormatToSink().
+ * @param ctx Context initialized with berTlv_ctxInit().
+ * @param data Raw data pointer
+ * @param size Data size in bytes
+ * @param sink Sink initialized with berTlv_sinkInit().
+ * @param format Output format.
+ * @return Number of bytes written. The error that interrupted the printing, if any, is stored in
+ * ctx->error with its offset.
+ */
+BER_TLV_API size_t berTlv_ctxPrint(TBerTlvCtx *ctx, uint8_t *data, size_t size, TBerTlvSink *sink,
+                                   EBerTlvFormat format);
 
 #endif
 
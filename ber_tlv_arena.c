@@ -0,0 +1,210 @@
+/**
+ * @file
+ * @brief Bump arena for the parse results of one message
+ */
+
+#include "ber_tlv_arena.h"
+
+#include <stdlib.h>
+
+//------------------------------------------------Static fuctions declaration----------------------------------------------------//
+static uint8_t *__blockData(TBerTlvArenaBlock *block);
+static size_t __alignedOffset(TBerTlvArenaBlock *block, size_t used, size_t align);
+static TBerTlvArenaBlock *__newBlock(TBerTlvArena *arena, size_t size, size_t align);
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Public functions------------------------------------------------------//
+
+void berTlv_arenaInit(TBerTlvArena *arena, void *buffer, size_t size)
+{
+    uintptr_t start = ((uintptr_t)buffer + _Alignof(TBerTlvArenaBlock) - 1) & ~(uintptr_t)(_Alignof(TBerTlvArenaBlock) - 1);
+    size_t padding = start - (uintptr_t)buffer;
+
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->used = 0;
+    arena->blockSize = 0;
+    arena->firstIsExternal = true;
+
+    if (size < padding + sizeof(TBerTlvArenaBlock))
+        return;
+    arena->first = (TBerTlvArenaBlock *)start;
+    arena->first->next = NULL;
+    arena->first->size = size - padding - sizeof(TBerTlvArenaBlock);
+    arena->current = arena->first;
+}
+
+void berTlv_arenaInitGrowable(TBerTlvArena *arena, size_t blockSize)
+{
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->used = 0;
+    arena->blockSize = blockSize;
+    arena->firstIsExternal = false;
+}
+
+void *berTlv_arenaAlloc(TBerTlvArena *arena, size_t size, size_t align)
+{
+    TBerTlvArenaBlock *block = arena->current;
+
+    if (block)
+    {
+        size_t offset = __alignedOffset(block, arena->used, align);
+        if (offset <= block->size && size <= block->size - offset)
+        {
+            arena->used = offset + size;
+            return __blockData(block) + offset;
+        }
+
+        // Blocks kept from before the last reset
+        if (block->next)
+        {
+            offset = __alignedOffset(block->next, 0, align);
+            if (offset <= block->next->size && size <= block->next->size - offset)
+            {
+                arena->current = block->next;
+                arena->used = offset + size;
+                return __blockData(block->next) + offset;
+            }
+        }
+    }
+
+    TBerTlvArenaBlock *newBlock = __newBlock(arena, size, align);
+    if (newBlock == NULL)
+        return NULL;
+
+    size_t offset = __alignedOffset(newBlock, 0, align);
+    arena->current = newBlock;
+    arena->used = offset + size;
+    return __blockData(newBlock) + offset;
+}
+
+void berTlv_arenaReset(TBerTlvArena *arena)
+{
+    arena->current = arena->first;
+    arena->used = 0;
+}
+
+void berTlv_arenaFree(TBerTlvArena *arena)
+{
+    TBerTlvArenaBlock *block = arena->first;
+
+    if (block && arena->firstIsExternal)
+    {
+        block = block->next;
+        arena->first->next = NULL;
+    }
+    else
+    {
+        arena->first = NULL;
+    }
+    while (block)
+    {
+        TBerTlvArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    berTlv_arenaReset(arena);
+}
+
+EBerTlvError berTlv_arenaIndexInit(TBerTlvArena *arena, TBerTlvIndex *index, size_t capacity, size_t tagTableSize)
+{
+    TBerTlvIndexEntry *entries = berTlv_arenaAlloc(arena, capacity * sizeof(TBerTlvIndexEntry),
+                                                   _Alignof(TBerTlvIndexEntry));
+    size_t *tagTable = NULL;
+
+    if (entries == NULL)
+        return BER_TLV_ERR_NO_SPACE;
+    if (tagTableSize)
+    {
+        tagTable = berTlv_arenaAlloc(arena, tagTableSize * sizeof(size_t), _Alignof(size_t));
+        if (tagTable == NULL)
+            return BER_TLV_ERR_NO_SPACE;
+    }
+
+    berTlv_indexInit(index, entries, capacity);
+    berTlv_indexSetTagTable(index, tagTable, tagTableSize);
+    return BER_TLV_OK;
+}
+
+char *berTlv_arenaPrint(TBerTlvArena *arena, uint8_t *data, size_t size, size_t *lengthOut)
+{
+    char *str = NULL;
+    size_t length = 0;
+
+    // Print in the free space of the current block, a fresh arena has none and only measures the text
+    if (arena->current)
+    {
+        str = (char *)__blockData(arena->current) + arena->used;
+        length = berTlv_printToBuffer(data, size, str, arena->current->size - arena->used);
+        if (length < arena->current->size - arena->used)
+            arena->used += length + 1;
+        else
+            str = NULL;
+    }
+    else
+    {
+        length = berTlv_printToBuffer(data, size, NULL, 0);
+    }
+
+    // Printed again in a new allocation of the measured size
+    if (str == NULL)
+    {
+        str = berTlv_arenaAlloc(arena, length + 1, 1);
+        if (str == NULL)
+            return NULL;
+        berTlv_printToBuffer(data, size, str, length + 1);
+    }
+
+    if (lengthOut)
+        *lengthOut = length;
+    return str;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Ptivate functions------------------------------------------------------//
+
+static uint8_t *__blockData(TBerTlvArenaBlock *block)
+{
+    return (uint8_t *)(block + 1);
+}
+
+/**
+ * @brief Offset of the first address aligned to align at or after used bytes of a block.
+ */
+static size_t __alignedOffset(TBerTlvArenaBlock *block, size_t used, size_t align)
+{
+    uintptr_t address = (uintptr_t)__blockData(block) + used;
+    return used + (((address + align - 1) & ~(uintptr_t)(align - 1)) - address);
+}
+
+/**
+ * @brief Allocate a new block for an allocation and link it after the current block.
+ * @return The new block or NULL if the arena can't grow.
+ */
+static TBerTlvArenaBlock *__newBlock(TBerTlvArena *arena, size_t size, size_t align)
+{
+    size_t blockSize = arena->blockSize;
+
+    if (blockSize == 0)
+        return NULL;
+    if (blockSize < size + align)
+        blockSize = size + align;
+
+    TBerTlvArenaBlock *block = malloc(sizeof(TBerTlvArenaBlock) + blockSize);
+    if (block == NULL)
+        return NULL;
+    block->size = blockSize;
+
+    if (arena->current)
+    {
+        block->next = arena->current->next;
+        arena->current->next = block;
+    }
+    else
+    {
+        block->next = NULL;
+        arena->first = block;
+    }
+    return block;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file
+ * @brief Bump arena for the parse results of one message
+ */
+
+#ifndef __BER_TLV_ARENA_H
+#define __BER_TLV_ARENA_H
+
+#include "ber_tlv.h"
+
+/**
+ * @brief Memory block of an arena
+ */
+typedef struct TBerTlvArenaBlock
+{
+    //! Next block, kept allocated across resets
+    struct TBerTlvArenaBlock *next;
+    //! Bytes available after this header
+    size_t size;
+} TBerTlvArenaBlock;
+
+/**
+ * @brief Bump arena
+ *
+ * Allocations are taken one after the other from a fixed buffer or from blocks allocated when
+ * needed. Nothing is freed until berTlv_arenaReset(), which makes all the memory available again
+ * in O(1). An arena is not thread safe, it is meant to be used per thread.
+ */
+typedef struct
+{
+    //! First block, NULL until the first allocation of a growable arena
+    TBerTlvArenaBlock *first;
+    //! Block of the next allocation
+    TBerTlvArenaBlock *current;
+    //! Bytes used in the current block
+    size_t used;
+    //! Size of the blocks allocated when the arena grows, 0 if it can't grow
+    size_t blockSize;
+    //! The first block is the caller buffer and must not be freed
+    bool firstIsExternal;
+} TBerTlvArena;
+
+/**
+ * @brief Initialize an arena over a fixed buffer. It never allocates memory.
+ * @param arena Arena to be initialized.
+ * @param buffer Caller supplied buffer, a few bytes are used for the block header.
+ * @param size Buffer size in bytes.
+ */
+BER_TLV_API void berTlv_arenaInit(TBerTlvArena *arena, void *buffer, size_t size);
+
+/**
+ * @brief Initialize an arena that grows with malloc(), one block at a time.
+ * @param arena Arena to be initialized.
+ * @param blockSize Minimum size of each block in bytes.
+ */
+BER_TLV_API void berTlv_arenaInitGrowable(TBerTlvArena *arena, size_t blockSize);
+
+/**
+ * @brief Allocate memory from an arena.
+ * @param arena Arena.
+ * @param size Size in bytes.
+ * @param align Alignment, power of two.
+ * @return Pointer to the memory or NULL if a fixed arena is full or malloc() failed.
+ */
+BER_TLV_API void *berTlv_arenaAlloc(TBerTlvArena *arena, size_t size, size_t align);
+
+/**
+ * @brief Release all allocations at once. The blocks are kept for the next message.
+ */
+BER_TLV_API void berTlv_arenaReset(TBerTlvArena *arena);
+
+/**
+ * @brief Free the blocks allocated by a growable arena.
+ */
+BER_TLV_API void berTlv_arenaFree(TBerTlvArena *arena);
+
+/**
+ * @brief Initialize an index whose entries and tag table are allocated from an arena.
+ * @param arena Arena.
+ * @param index Index to be initialized.
+ * @param capacity Number of entries.
+ * @param tagTableSize Number of slots of the tag table (power of two), 0 for no tag table.
+ * @return BER_TLV_OK or BER_TLV_ERR_NO_SPACE if the arena is full.
+ */
+BER_TLV_API EBerTlvError berTlv_arenaIndexInit(TBerTlvArena *arena, TBerTlvIndex *index, size_t capacity,
+                                               size_t tagTableSize);
+
+/**
+ * @brief Print raw data as BER TLV objects into a string allocated from an arena.
+ * @param arena Arena.
+ * @param data pointer to raw data.
+ * @param size Data size in bytes.
+ * @param lengthOut Receives the text size, excluding the terminator. May be NULL.
+ * @return NUL-terminated text or NULL if the arena is full.
+ */
+BER_TLV_API char *berTlv_arenaPrint(TBerTlvArena *arena, uint8_t *data, size_t size, size_t *lengthOut);
+
+#endif
@@ -0,0 +1,178 @@
+/**
+ * @file
+ * @brief Multithreaded indexing of independent top-level BER-TLV records
+ */
+
+#include "ber_tlv_batch.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @brief Chunk of records indexed by one thread
+ */
+typedef struct
+{
+    //! Whole data
+    uint8_t *data;
+    //! Offset of the first record of the chunk
+    size_t start;
+    //! Offset of the first byte after the chunk
+    size_t end;
+    //! Index of the chunk, offsets are relative to start
+    TBerTlvIndex index;
+    //! Error returned by berTlv_index()
+    EBerTlvError error;
+} TBerTlvBatchChunk;
+
+//------------------------------------------------Static fuctions declaration----------------------------------------------------//
+static size_t __splitChunks(uint8_t *data, size_t size, size_t *starts, size_t chunkCount);
+static void *__indexChunk(void *arg);
+static void __mergeChunk(TBerTlvIndex *index, TBerTlvBatchChunk *chunk);
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Public functions------------------------------------------------------//
+
+EBerTlvError berTlv_batchIndex(uint8_t *data, size_t size, TBerTlvIndex *index, unsigned threadCount)
+{
+    TBerTlvBatchChunk chunks[BER_TLV_BATCH_MAX_THREADS];
+    pthread_t threads[BER_TLV_BATCH_MAX_THREADS];
+    size_t starts[BER_TLV_BATCH_MAX_THREADS + 1];
+    EBerTlvError err = BER_TLV_OK;
+
+    if (threadCount == 0)
+    {
+        long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cpuCount > 0 ? (unsigned)cpuCount : 1;
+    }
+    if (threadCount > BER_TLV_BATCH_MAX_THREADS)
+        threadCount = BER_TLV_BATCH_MAX_THREADS;
+
+    size_t chunkCount = __splitChunks(data, size, starts, threadCount);
+
+    // A chunk of n bytes holds at most n / 2 objects, an index too small for all the shares is
+    // filled by a single chunk
+    size_t shareTotal = 0;
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        shareTotal += (starts[i + 1] - starts[i]) / 2;
+    }
+    if (shareTotal > index->capacity)
+    {
+        chunkCount = size ? 1 : 0;
+        starts[chunkCount] = size;
+    }
+
+    size_t firstEntry = 0;
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        TBerTlvBatchChunk *chunk = &chunks[i];
+        // The shares follow each other, the last chunk takes the remaining entries
+        size_t shareSize = i + 1 < chunkCount ? (starts[i + 1] - starts[i]) / 2 : index->capacity - firstEntry;
+
+        chunk->data = data;
+        chunk->start = starts[i];
+        chunk->end = starts[i + 1];
+        berTlv_indexInit(&chunk->index, index->entries + firstEntry, shareSize);
+        firstEntry += shareSize;
+    }
+
+    // The first chunk is indexed by the calling thread
+    size_t startedCount = 1;
+    for (; startedCount < chunkCount; ++startedCount)
+    {
+        if (pthread_create(&threads[startedCount], NULL, __indexChunk, &chunks[startedCount]))
+            break;
+    }
+    // Chunks without thread are indexed here too
+    for (size_t i = startedCount; i < chunkCount; ++i)
+    {
+        __indexChunk(&chunks[i]);
+    }
+    if (chunkCount)
+        __indexChunk(&chunks[0]);
+    for (size_t i = 1; i < startedCount; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    index->data = data;
+    index->size = size;
+    index->count = 0;
+    index->errorOffset = 0;
+    for (size_t i = 0; i < chunkCount && !err; ++i)
+    {
+        __mergeChunk(index, &chunks[i]);
+        err = chunks[i].error;
+        if (err)
+            index->errorOffset = chunks[i].start + chunks[i].index.errorOffset;
+    }
+
+    if (!err && index->tagTableSize)
+        err = berTlv_indexFillTagTable(index);
+    return err;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Ptivate functions------------------------------------------------------//
+
+/**
+ * @brief Split data into chunks of whole top-level records of about the same size.
+ *
+ * Records are found by jumping over their values, their content is not parsed. If the data is
+ * malformed the remaining bytes go into the last chunk, where berTlv_index() reports the error.
+ * @param starts Receives the start offset of each chunk, followed by the data size.
+ * @return Number of chunks.
+ */
+static size_t __splitChunks(uint8_t *data, size_t size, size_t *starts, size_t chunkCount)
+{
+    TBerTlvIter iter;
+    TBerTlvObj tlvObj;
+    size_t count = 1;
+
+    starts[0] = 0;
+    berTlv_iterBegin(&iter, data, size, NULL, 0);
+    while (count < chunkCount && !berTlv_iterNext(&iter, &tlvObj) && tlvObj.value)
+    {
+        if (iter.objOffset >= size / chunkCount * count)
+            starts[count++] = iter.objOffset;
+    }
+    if (size == 0)
+        count = 0;
+    starts[count] = size;
+    return count;
+}
+
+/**
+ * @brief Thread function indexing a chunk.
+ */
+static void *__indexChunk(void *arg)
+{
+    TBerTlvBatchChunk *chunk = arg;
+    chunk->error = berTlv_index(chunk->data + chunk->start, chunk->end - chunk->start, &chunk->index);
+    return NULL;
+}
+
+/**
+ * @brief Append the entries of a chunk to the index, offsets relative to the whole data.
+ */
+static void __mergeChunk(TBerTlvIndex *index, TBerTlvBatchChunk *chunk)
+{
+    TBerTlvIndexEntry *entries = index->entries + index->count;
+    size_t parentBase = index->count;
+
+    // The shares follow each other, so entries only move towards the start
+    if (entries != chunk->index.entries)
+        memmove(entries, chunk->index.entries, chunk->index.count * sizeof(TBerTlvIndexEntry));
+
+    for (size_t i = 0; i < chunk->index.count; ++i)
+    {
+        entries[i].offset += chunk->start;
+        entries[i].valueOffset += chunk->start;
+        entries[i].end += chunk->start;
+        if (entries[i].parent != BER_TLV_NO_PARENT)
+            entries[i].parent += parentBase;
+    }
+    index->count += chunk->index.count;
+}
@@ -0,0 +1,35 @@
+/**
+ * @file
+ * @brief Multithreaded indexing of independent top-level BER-TLV records
+ */
+
+#ifndef __BER_TLV_BATCH_H
+#define __BER_TLV_BATCH_H
+
+#include "ber_tlv.h"
+
+//! Maximum number of threads used by berTlv_batchIndex()
+#define BER_TLV_BATCH_MAX_THREADS 64
+
+/**
+ * @brief Index a large array of concatenated top-level records using several threads.
+ *
+ * The top-level record boundaries are first found by jumping from length to length, then the data
+ * is split into one chunk of records per thread. Each thread indexes its chunk into its own share
+ * of the index entries, chunk size / 2 entries, and the shares are merged in record order.
+ * The result is the same as berTlv_index() on the whole data.
+ *
+ * Each object takes at least 2 bytes, so an index with size / 2 entries never runs out of space.
+ * A smaller index that can't hold all the shares is filled by the calling thread alone.
+ * @param data pointer to raw data.
+ * @param size Data size in bytes.
+ * @param index Index initialized with berTlv_indexInit(). Its tag table, if any, is filled after
+ * the merge.
+ * @param threadCount Number of threads, up to BER_TLV_BATCH_MAX_THREADS. 0 uses one thread per
+ * online CPU.
+ * @return BER_TLV_OK or the error of the first malformed record. index->count is then the number
+ * of entries before the error and index->errorOffset is the offset of the object that caused it.
+ */
+BER_TLV_API EBerTlvError berTlv_batchIndex(uint8_t *data, size_t size, TBerTlvIndex *index, unsigned threadCount);
+
+#endif
@@ -0,0 +1,207 @@
+/**
+ * @file
+ * @brief Encoder of BER-TLV data into a caller buffer
+ */
+
+#include "ber_tlv_builder.h"
+#include "ber_tlv_internal.h"
+#include "ber_tlv_schema.h"
+
+#include <string.h>
+
+//------------------------------------------------Static fuctions declaration----------------------------------------------------//
+static uint8_t *__writeHeader(TBerTlvBuilder *builder, uint32_t tag, size_t valueSize, size_t reservedSize);
+static uint8_t __reservedLengthSize(uint8_t firstLengthByte);
+static bool __isTagWritable(uint32_t tag, size_t depth);
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Public functions------------------------------------------------------//
+
+void berTlv_builderInit(TBerTlvBuilder *builder, uint8_t *buffer, size_t capacity, size_t *openStack,
+                        size_t stackCapacity)
+{
+    builder->buffer = buffer;
+    builder->capacity = capacity;
+    builder->size = 0;
+    builder->openStack = openStack;
+    builder->stackCapacity = stackCapacity;
+    builder->depth = 0;
+    builder->error = BER_TLV_OK;
+}
+
+EBerTlvError berTlv_builderAdd(TBerTlvBuilder *builder, uint32_t tag, const uint8_t *value, size_t valueSize)
+{
+    uint8_t *valueP = berTlv_builderReserve(builder, tag, valueSize);
+
+    if (valueP && valueSize)
+        memcpy(valueP, value, valueSize);
+    return builder->error;
+}
+
+uint8_t *berTlv_builderReserve(TBerTlvBuilder *builder, uint32_t tag, size_t valueSize)
+{
+    uint8_t *valueP = __writeHeader(builder, tag, valueSize, valueSize);
+
+    if (valueP)
+        builder->size += valueSize;
+    return valueP;
+}
+
+EBerTlvError berTlv_builderOpen(TBerTlvBuilder *builder, uint32_t tag, size_t expectedValueSize)
+{
+    if (builder->error)
+        return builder->error;
+    if (builder->depth == builder->stackCapacity)
+        return builder->error = BER_TLV_ERR_DEPTH_OVERFLOW;
+
+    if (!BER_TLV_TAG_IS_CONSTRUCTED(tag))
+        return builder->error = BER_TLV_ERR_INVALID_ARGUMENT;
+
+    if (expectedValueSize > MAX_VALUE_SIZE)
+        expectedValueSize = MAX_VALUE_SIZE;
+    // The value is not reserved, it is made of the following objects
+    if (__writeHeader(builder, tag, expectedValueSize, 0))
+        builder->openStack[builder->depth++] = builder->size - berTlv_lengthFieldSize(expectedValueSize);
+    return builder->error;
+}
+
+EBerTlvError berTlv_builderClose(TBerTlvBuilder *builder)
+{
+    if (builder->error)
+        return builder->error;
+    if (builder->depth == 0)
+        return builder->error = BER_TLV_ERR_DEPTH_OVERFLOW;
+
+    size_t lengthOffset = builder->openStack[builder->depth - 1];
+    uint8_t reservedSize = __reservedLengthSize(builder->buffer[lengthOffset]);
+    size_t valueOffset = lengthOffset + reservedSize;
+    size_t valueSize = builder->size - valueOffset;
+
+    if (valueSize > MAX_VALUE_SIZE)
+        return builder->error = BER_TLV_ERR_BAD_LENGTH_FORM;
+
+    uint8_t lengthSize = berTlv_lengthFieldSize(valueSize);
+    if (lengthSize != reservedSize)
+    {
+        // Wrong guess of the value size, move the value once to keep the minimum length form
+        if (lengthSize > reservedSize && builder->capacity - builder->size < (size_t)(lengthSize - reservedSize))
+            return builder->error = BER_TLV_ERR_NO_SPACE;
+        memmove(builder->buffer + lengthOffset + lengthSize, builder->buffer + valueOffset, valueSize);
+        builder->size = lengthOffset + lengthSize + valueSize;
+    }
+    berTlv_writeLength(builder->buffer + lengthOffset, valueSize, lengthSize);
+    builder->depth--;
+    return BER_TLV_OK;
+}
+
+EBerTlvError berTlv_builderFinish(TBerTlvBuilder *builder, size_t *sizeOut)
+{
+    while (builder->depth && !builder->error)
+    {
+        berTlv_builderClose(builder);
+    }
+    if (sizeOut)
+        *sizeOut = builder->size;
+    return builder->error;
+}
+
+uint8_t berTlv_tagFieldSize(uint32_t tag)
+{
+    uint8_t size = 1;
+    while (size < 4 && (tag >> (8 * size)))
+    {
+        size++;
+    }
+    return size;
+}
+
+uint8_t berTlv_lengthFieldSize(size_t valueSize)
+{
+    uint8_t size = 1;
+    if (valueSize < MULTPLES_BYTES_LENGTH_MASK)
+        return size;
+    while (valueSize)
+    {
+        size++;
+        valueSize >>= 8;
+    }
+    return size;
+}
+
+void berTlv_writeLength(uint8_t *data, size_t valueSize, uint8_t lengthSize)
+{
+    if (lengthSize == 1)
+    {
+        *data = (uint8_t)valueSize;
+        return;
+    }
+    *data = MULTPLES_BYTES_LENGTH_MASK | (lengthSize - 1);
+    for (uint8_t i = lengthSize - 1; i > 0; --i)
+    {
+        data[i] = valueSize & 0xFF;
+        valueSize >>= 8;
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Ptivate functions------------------------------------------------------//
+
+/**
+ * @brief Write the tag and the minimum length field for valueSize.
+ * @param reservedSize Bytes that must fit after the header.
+ * @return Pointer to the value field or NULL on error.
+ */
+static uint8_t *__writeHeader(TBerTlvBuilder *builder, uint32_t tag, size_t valueSize, size_t reservedSize)
+{
+    if (builder->error)
+        return NULL;
+    if (!__isTagWritable(tag, builder->depth))
+    {
+        builder->error = BER_TLV_ERR_INVALID_ARGUMENT;
+        return NULL;
+    }
+    if (valueSize > MAX_VALUE_SIZE)
+    {
+        builder->error = BER_TLV_ERR_BAD_LENGTH_FORM;
+        return NULL;
+    }
+
+    uint8_t tagSize = berTlv_tagFieldSize(tag);
+    uint8_t lengthSize = berTlv_lengthFieldSize(valueSize);
+    size_t available = builder->capacity - builder->size;
+    if (available < (size_t)(tagSize + lengthSize) || available - tagSize - lengthSize < reservedSize)
+    {
+        builder->error = BER_TLV_ERR_NO_SPACE;
+        return NULL;
+    }
+
+    uint8_t *dataP = builder->buffer + builder->size;
+    for (uint8_t i = tagSize; i > 0; --i)
+    {
+        *dataP++ = (tag >> (8 * (i - 1))) & 0xFF;
+    }
+    berTlv_writeLength(dataP, valueSize, lengthSize);
+    dataP += lengthSize;
+    builder->size += tagSize + lengthSize;
+    return dataP;
+}
+
+/**
+ * @brief Size of the length field written when a constructed object was opened.
+ */
+static uint8_t __reservedLengthSize(uint8_t firstLengthByte)
+{
+    if (firstLengthByte & MULTPLES_BYTES_LENGTH_MASK)
+        return (firstLengthByte & ~MULTPLES_BYTES_LENGTH_MASK) + 1;
+    return 1;
+}
+
+/**
+ * @brief true if a packed tag value is written as a tag that reads back, with the packing rules of the schemas.
+ * Readers skip 0x00 and 0xFF bytes between top-level objects as padding, so no top-level tag starts with them.
+ */
+static bool __isTagWritable(uint32_t tag, size_t depth)
+{
+    uint8_t firstByte = BER_TLV_TAG_FIRST_BYTE(tag);
+    return (depth || (firstByte != 0x00 && firstByte != 0xFF)) && BER_TLV_TAG_IS_WELL_FORMED(tag);
+}
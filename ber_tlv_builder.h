@@ -0,0 +1,119 @@
+/**
+ * @file
+ * @brief Encoder of BER-TLV data into a caller buffer
+ */
+
+#ifndef __BER_TLV_BUILDER_H
+#define __BER_TLV_BUILDER_H
+
+#include "ber_tlv.h"
+
+/**
+ * @brief Builder of BER TLV data
+ *
+ * Objects are written in place, one after the other, into a caller buffer. The length field of a
+ * constructed object is reserved when it is opened, from the expected value size, and fixed up
+ * when it is closed. Only if the reserved length field has not the minimum size for the final
+ * value size, the value is moved once.
+ *
+ * The first error is kept, and every following call does nothing and returns it.
+ */
+typedef struct
+{
+    //! Caller supplied output buffer
+    uint8_t *buffer;
+    //! Size of the output buffer in bytes
+    size_t capacity;
+    //! Bytes written
+    size_t size;
+    //! Caller supplied stack, offset of the length field of each open constructed object
+    size_t *openStack;
+    //! Number of elements of the stack, which is the maximum nesting level
+    size_t stackCapacity;
+    //! Number of open constructed objects
+    size_t depth;
+    //! First error
+    EBerTlvError error;
+} TBerTlvBuilder;
+
+/**
+ * @brief Start building BER TLV data.
+ * @param builder Builder to be initialized.
+ * @param buffer Output buffer.
+ * @param capacity Size of the output buffer in bytes.
+ * @param openStack Caller supplied stack, one element per nesting level.
+ * @param stackCapacity Number of elements of openStack.
+ */
+BER_TLV_API void berTlv_builderInit(TBerTlvBuilder *builder, uint8_t *buffer, size_t capacity, size_t *openStack,
+                                    size_t stackCapacity);
+
+/**
+ * @brief Write a primitive object.
+ * @param builder Builder.
+ * @param tag Tag value, with the tag bytes packed as in TBerTlvObj.
+ * @param value Value bytes. May be NULL if valueSize is 0.
+ * @param valueSize Value size in bytes.
+ * @return BER_TLV_OK, BER_TLV_ERR_NO_SPACE if the buffer is full or BER_TLV_ERR_INVALID_ARGUMENT if the tag
+ * is not a well formed tag, or is a top-level tag starting with a 0x00 or 0xFF padding byte.
+ */
+BER_TLV_API EBerTlvError berTlv_builderAdd(TBerTlvBuilder *builder, uint32_t tag, const uint8_t *value,
+                                           size_t valueSize);
+
+/**
+ * @brief Write the header of a primitive object and reserve its value, to be written by the caller.
+ *
+ * The pointer is invalid once an enclosing object is closed, berTlv_builderClose() may move its value.
+ * @param builder Builder.
+ * @param tag Tag value, checked as by berTlv_builderAdd().
+ * @param valueSize Value size in bytes.
+ * @return Pointer to the value field in the output buffer or NULL on error.
+ */
+BER_TLV_API uint8_t *berTlv_builderReserve(TBerTlvBuilder *builder, uint32_t tag, size_t valueSize);
+
+/**
+ * @brief Open a constructed object. The following objects are written in its value.
+ * @param builder Builder.
+ * @param tag Tag value, checked as by berTlv_builderAdd(), with the constructed bit (0x20 of the first
+ * tag byte) set.
+ * @param expectedValueSize Expected value size, used to reserve the length field. With the exact
+ * size, or any size coded with as many length bytes, nothing is moved on close.
+ * @return BER_TLV_OK, BER_TLV_ERR_NO_SPACE, BER_TLV_ERR_DEPTH_OVERFLOW if the stack is full or
+ * BER_TLV_ERR_INVALID_ARGUMENT if the tag is not a constructed one.
+ */
+BER_TLV_API EBerTlvError berTlv_builderOpen(TBerTlvBuilder *builder, uint32_t tag, size_t expectedValueSize);
+
+/**
+ * @brief Close the innermost open constructed object and write its length field.
+ * @param builder Builder.
+ * @return BER_TLV_OK, BER_TLV_ERR_NO_SPACE if the value had to be moved and the buffer is full,
+ * or BER_TLV_ERR_DEPTH_OVERFLOW if no object is open.
+ */
+BER_TLV_API EBerTlvError berTlv_builderClose(TBerTlvBuilder *builder);
+
+/**
+ * @brief Close every open constructed object.
+ * @param builder Builder.
+ * @param sizeOut Receives the size of the built data in bytes. May be NULL.
+ * @return BER_TLV_OK or the first error.
+ */
+BER_TLV_API EBerTlvError berTlv_builderFinish(TBerTlvBuilder *builder, size_t *sizeOut);
+
+/**
+ * @brief Size of the tag field of a packed tag value.
+ */
+BER_TLV_API uint8_t berTlv_tagFieldSize(uint32_t tag);
+
+/**
+ * @brief Size of the minimum length field for a value size.
+ */
+BER_TLV_API uint8_t berTlv_lengthFieldSize(size_t valueSize);
+
+/**
+ * @brief Encode a length field with the given size.
+ * @param data Output, lengthSize bytes.
+ * @param valueSize Value size to be coded.
+ * @param lengthSize Size of the length field, at least berTlv_lengthFieldSize(valueSize).
+ */
+BER_TLV_API void berTlv_writeLength(uint8_t *data, size_t valueSize, uint8_t lengthSize);
+
+#endif
@@ -0,0 +1,468 @@
+/**
+ * @file
+ * @brief Cache of the index and printed text of repeated constructed BER-TLV objects
+ */
+
+#include "ber_tlv_cache.h"
+#include "ber_tlv_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//! Size of the buffer the text of an object added to the cache is printed in
+#ifndef BER_TLV_CACHE_CAPTURE_BUFFER_SIZE
+#define BER_TLV_CACHE_CAPTURE_BUFFER_SIZE 1024
+#endif
+
+//! Kind of the cached index entries, printed text is 1 + its format
+#define BER_TLV_CACHE_KIND_INDEX 0
+
+//! Multipliers of the hash, odd 64 bits constants with well mixed bits
+static const uint64_t HASH_PRIME_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t HASH_PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t HASH_PRIME_3 = 0x165667B19E3779F9ULL;
+
+/**
+ * @brief Text of an object printed into the output sink and kept for the cache
+ */
+typedef struct
+{
+    //! Output sink of the caller
+    TBerTlvSink *sink;
+    //! Text printed so far
+    char *text;
+    //! Text size in bytes
+    size_t size;
+    //! Allocated size of text
+    size_t capacity;
+    //! Largest kept text
+    size_t limit;
+    //! Set when the text is too large or could not be allocated, it is not cached
+    bool dropped;
+} TBerTlvCacheCapture;
+
+//------------------------------------------------Static fuctions declaration----------------------------------------------------//
+static uint64_t __hashMix(uint64_t hash, uint64_t word);
+static size_t __lookup(TBerTlvCache *cache, uint8_t kind, const uint8_t *data, size_t size, uint64_t hash);
+static void *__store(TBerTlvCache *cache, uint8_t kind, const uint8_t *data, size_t size, uint64_t hash,
+                     const void *result, size_t resultSize);
+static void __insert(TBerTlvCache *cache, uint8_t kind, uint8_t *blob, size_t size, uint64_t hash, size_t resultSize);
+static void __remove(TBerTlvCache *cache, size_t entryIndex);
+static void __lruUnlink(TBerTlvCache *cache, size_t entryIndex);
+static void __lruPushFront(TBerTlvCache *cache, size_t entryIndex);
+static EBerTlvError __indexRun(TBerTlvIndex *index, size_t start, size_t end);
+static bool __copyEntries(TBerTlvIndex *index, const TBerTlvCacheEntry *cached, size_t start);
+static void __moveEntries(TBerTlvIndexEntry *entries, size_t count, size_t offsetDelta, size_t parentDelta);
+static bool __printCached(void *userData, uint8_t *data, size_t size, TBerTlvSink *sink, EBerTlvFormat format,
+                          EBerTlvError *errorOut);
+static bool __captureWrite(void *userData, const char *str, size_t size);
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Public functions------------------------------------------------------//
+
+uint64_t berTlv_hash(const uint8_t *data, size_t size)
+{
+    uint64_t hash = HASH_PRIME_3 ^ (size * HASH_PRIME_1);
+    uint64_t word;
+
+    while (size >= sizeof(word))
+    {
+        memcpy(&word, data, sizeof(word));
+        hash = __hashMix(hash, word);
+        data += sizeof(word);
+        size -= sizeof(word);
+    }
+    word = 0;
+    memcpy(&word, data, size);
+    hash = __hashMix(hash, word);
+
+    // Final avalanche, so that the low bits used for the buckets depend on all bytes
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+void berTlv_cacheInit(TBerTlvCache *cache, TBerTlvCacheEntry *entries, size_t entryCount, size_t *buckets,
+                      size_t bucketCount, size_t budget)
+{
+    cache->entries = entries;
+    cache->entryCount = entryCount;
+    cache->buckets = buckets;
+    cache->bucketCount = bucketCount;
+    cache->budget = budget;
+    cache->used = 0;
+    cache->lruHead = BER_TLV_CACHE_NONE;
+    cache->lruTail = BER_TLV_CACHE_NONE;
+    cache->freeHead = entryCount ? 0 : BER_TLV_CACHE_NONE;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+
+    for (size_t i = 0; i < bucketCount; ++i)
+    {
+        buckets[i] = BER_TLV_CACHE_NONE;
+    }
+    for (size_t i = 0; i < entryCount; ++i)
+    {
+        entries[i].blob = NULL;
+        entries[i].lruNext = (i + 1 < entryCount) ? i + 1 : BER_TLV_CACHE_NONE;
+    }
+}
+
+void berTlv_cacheClear(TBerTlvCache *cache)
+{
+    for (size_t i = 0; i < cache->entryCount; ++i)
+    {
+        free(cache->entries[i].blob);
+    }
+    berTlv_cacheInit(cache, cache->entries, cache->entryCount, cache->buckets, cache->bucketCount, cache->budget);
+}
+
+EBerTlvError berTlv_cacheIndex(TBerTlvCache *cache, uint8_t *data, size_t size, TBerTlvIndex *index)
+{
+    TBerTlvIter iter;
+    TBerTlvObj tlvObj;
+    size_t pending = 0;
+    EBerTlvError err;
+
+    index->data = data;
+    index->size = size;
+    index->count = 0;
+    index->errorOffset = 0;
+
+    // Objects that are not cached are indexed together, up to the next cached one. The last run
+    // holds the object that caused an error, so the index reports it.
+    berTlv_iterBegin(&iter, data, size, NULL, 0);
+    while (cache->bucketCount && berTlv_iterNext(&iter, &tlvObj) == BER_TLV_OK && tlvObj.value)
+    {
+        size_t start = iter.objOffset;
+        size_t end = tlvObj.value + tlvObj.valueSize - data;
+        if (!tlvObj.constructed || end - start < BER_TLV_CACHE_MIN_SIZE)
+            continue;
+
+        if (start > pending && (err = __indexRun(index, pending, start)))
+            return err;
+        pending = end;
+
+        uint64_t hash = berTlv_hash(data + start, end - start);
+        size_t found = __lookup(cache, BER_TLV_CACHE_KIND_INDEX, data + start, end - start, hash);
+        if (found != BER_TLV_CACHE_NONE && __copyEntries(index, &cache->entries[found], start))
+            continue;
+
+        size_t first = index->count;
+        if ((err = __indexRun(index, start, end)))
+            return err;
+
+        // Kept with the offsets of the object alone
+        TBerTlvIndexEntry *stored = __store(cache, BER_TLV_CACHE_KIND_INDEX, data + start, end - start, hash,
+                                            index->entries + first, (index->count - first) * sizeof(TBerTlvIndexEntry));
+        if (stored)
+            __moveEntries(stored, index->count - first, -start, -first);
+    }
+    if (size > pending && (err = __indexRun(index, pending, size)))
+        return err;
+
+    return index->tagTableSize ? berTlv_indexFillTagTable(index) : BER_TLV_OK;
+}
+
+size_t berTlv_cachePrint(TBerTlvCache *cache, uint8_t *data, size_t size, TBerTlvSink *sink, EBerTlvFormat format)
+{
+    if (format == BER_TLV_FORMAT_JSON || !cache->bucketCount || !cache->entryCount)
+        return berTlv_printFormatToSink(data, size, sink, format);
+
+    // Top-level constructed objects are looked up while the data is printed, in a single walk
+    return berTlv_printFormatWithHook(data, size, sink, format, __printCached, cache);
+}
+
+size_t berTlv_cachePrintFromRawData(TBerTlvCache *cache, uint8_t *data, size_t size, char *outputStr)
+{
+    TBerTlvSink sink;
+
+    berTlv_sinkInit(&sink, outputStr, SIZE_MAX, NULL, NULL);
+    return berTlv_cachePrint(cache, data, size, &sink, BER_TLV_FORMAT_TEXT);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Ptivate functions------------------------------------------------------//
+
+/**
+ * @brief Mix 8 bytes of data into the hash.
+ */
+static uint64_t __hashMix(uint64_t hash, uint64_t word)
+{
+    hash ^= word * HASH_PRIME_2;
+    hash = (hash << 31) | (hash >> 33);
+    return hash * HASH_PRIME_1;
+}
+
+/**
+ * @brief Find the cached result of the same bytes, and make it the most recently used.
+ * @return Entry index or BER_TLV_CACHE_NONE.
+ */
+static size_t __lookup(TBerTlvCache *cache, uint8_t kind, const uint8_t *data, size_t size, uint64_t hash)
+{
+    size_t entryIndex = cache->buckets[hash & (cache->bucketCount - 1)];
+
+    while (entryIndex != BER_TLV_CACHE_NONE)
+    {
+        const TBerTlvCacheEntry *entry = &cache->entries[entryIndex];
+
+        if (entry->hash == hash && entry->kind == kind && entry->keySize == size &&
+            !memcmp(entry->blob + entry->resultSize, data, size))
+        {
+            __lruUnlink(cache, entryIndex);
+            __lruPushFront(cache, entryIndex);
+            cache->hits++;
+            return entryIndex;
+        }
+        entryIndex = entry->bucketNext;
+    }
+    cache->misses++;
+    return BER_TLV_CACHE_NONE;
+}
+
+/**
+ * @brief Add a result to the cache, evicting the least recently used entries to make room.
+ * @return The cached copy of the result, NULL if it is not cached.
+ */
+static void *__store(TBerTlvCache *cache, uint8_t kind, const uint8_t *data, size_t size, uint64_t hash,
+                     const void *result, size_t resultSize)
+{
+    size_t blobSize = resultSize + size;
+
+    if (blobSize > cache->budget || cache->entryCount == 0)
+        return NULL;
+
+    uint8_t *blob = malloc(blobSize);
+    if (blob == NULL)
+        return NULL;
+    if (resultSize)
+        memcpy(blob, result, resultSize);
+    memcpy(blob + resultSize, data, size);
+    __insert(cache, kind, blob, size, hash, resultSize);
+    return blob;
+}
+
+/**
+ * @brief Add a blob holding a result followed by the object bytes, within the budget, to the cache. The
+ * least recently used entries are evicted to make room.
+ */
+static void __insert(TBerTlvCache *cache, uint8_t kind, uint8_t *blob, size_t size, uint64_t hash, size_t resultSize)
+{
+    size_t blobSize = resultSize + size;
+
+    while ((cache->used + blobSize > cache->budget || cache->freeHead == BER_TLV_CACHE_NONE) &&
+           cache->lruTail != BER_TLV_CACHE_NONE)
+    {
+        __remove(cache, cache->lruTail);
+        cache->evictions++;
+    }
+
+    size_t entryIndex = cache->freeHead;
+    TBerTlvCacheEntry *entry = &cache->entries[entryIndex];
+    size_t *bucket = &cache->buckets[hash & (cache->bucketCount - 1)];
+
+    cache->freeHead = entry->lruNext;
+    entry->hash = hash;
+    entry->blob = blob;
+    entry->keySize = size;
+    entry->resultSize = resultSize;
+    entry->kind = kind;
+    entry->bucketNext = *bucket;
+    *bucket = entryIndex;
+    __lruPushFront(cache, entryIndex);
+    cache->used += blobSize;
+}
+
+/**
+ * @brief Free an entry and unlink it from its bucket and from the LRU list.
+ */
+static void __remove(TBerTlvCache *cache, size_t entryIndex)
+{
+    TBerTlvCacheEntry *entry = &cache->entries[entryIndex];
+    size_t *link = &cache->buckets[entry->hash & (cache->bucketCount - 1)];
+
+    while (*link != entryIndex)
+    {
+        link = &cache->entries[*link].bucketNext;
+    }
+    *link = entry->bucketNext;
+    __lruUnlink(cache, entryIndex);
+
+    cache->used -= entry->resultSize + entry->keySize;
+    free(entry->blob);
+    entry->blob = NULL;
+    entry->lruNext = cache->freeHead;
+    cache->freeHead = entryIndex;
+}
+
+/**
+ * @brief Unlink an entry from the LRU list.
+ */
+static void __lruUnlink(TBerTlvCache *cache, size_t entryIndex)
+{
+    TBerTlvCacheEntry *entry = &cache->entries[entryIndex];
+
+    if (entry->lruPrev != BER_TLV_CACHE_NONE)
+        cache->entries[entry->lruPrev].lruNext = entry->lruNext;
+    else
+        cache->lruHead = entry->lruNext;
+    if (entry->lruNext != BER_TLV_CACHE_NONE)
+        cache->entries[entry->lruNext].lruPrev = entry->lruPrev;
+    else
+        cache->lruTail = entry->lruPrev;
+}
+
+/**
+ * @brief Insert an entry at the head of the LRU list, as the most recently used.
+ */
+static void __lruPushFront(TBerTlvCache *cache, size_t entryIndex)
+{
+    TBerTlvCacheEntry *entry = &cache->entries[entryIndex];
+
+    entry->lruPrev = BER_TLV_CACHE_NONE;
+    entry->lruNext = cache->lruHead;
+    if (cache->lruHead != BER_TLV_CACHE_NONE)
+        cache->entries[cache->lruHead].lruPrev = entryIndex;
+    else
+        cache->lruTail = entryIndex;
+    cache->lruHead = entryIndex;
+}
+
+/**
+ * @brief Index the objects of a range of the data, appended to the index entries.
+ * @return The result of berTlv_index(), index->errorOffset is set on error.
+ */
+static EBerTlvError __indexRun(TBerTlvIndex *index, size_t start, size_t end)
+{
+    TBerTlvIndex runIndex;
+    TBerTlvIndexEntry *entries = index->entries + index->count;
+
+    berTlv_indexInit(&runIndex, entries, index->capacity - index->count);
+    EBerTlvError err = berTlv_index(index->data + start, end - start, &runIndex);
+
+    __moveEntries(entries, runIndex.count, start, index->count);
+    index->count += runIndex.count;
+    if (err)
+        index->errorOffset = start + runIndex.errorOffset;
+    return err;
+}
+
+/**
+ * @brief Append cached entries to the index, moved to the object offset.
+ * @return false if the index is too small, the object is indexed again to report where it is full.
+ */
+static bool __copyEntries(TBerTlvIndex *index, const TBerTlvCacheEntry *cached, size_t start)
+{
+    size_t count = cached->resultSize / sizeof(TBerTlvIndexEntry);
+    TBerTlvIndexEntry *entries = index->entries + index->count;
+
+    if (count > index->capacity - index->count)
+        return false;
+
+    memcpy(entries, cached->blob, cached->resultSize);
+    __moveEntries(entries, count, start, index->count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        entries[i].obj.value = index->data + entries[i].valueOffset;
+    }
+    index->count += count;
+    return true;
+}
+
+/**
+ * @brief Add deltas to the offsets and parents of index entries, with unsigned wrap-around to subtract them.
+ */
+static void __moveEntries(TBerTlvIndexEntry *entries, size_t count, size_t offsetDelta, size_t parentDelta)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        entries[i].offset += offsetDelta;
+        entries[i].valueOffset += offsetDelta;
+        entries[i].end += offsetDelta;
+        if (entries[i].parent != BER_TLV_NO_PARENT)
+            entries[i].parent += parentDelta;
+    }
+}
+
+/**
+ * @brief Print callback of berTlv_cachePrint(): write the cached text of an object, or print it and keep its text.
+ * @return false for the objects that are not cached, too small or larger than the budget.
+ */
+static bool __printCached(void *userData, uint8_t *data, size_t size, TBerTlvSink *sink, EBerTlvFormat format,
+                          EBerTlvError *errorOut)
+{
+    TBerTlvCache *cache = userData;
+    uint8_t kind = 1 + (uint8_t)format;
+
+    if (size < BER_TLV_CACHE_MIN_SIZE || size > cache->budget)
+        return false;
+
+    uint64_t hash = berTlv_hash(data, size);
+    size_t found = __lookup(cache, kind, data, size, hash);
+    if (found != BER_TLV_CACHE_NONE)
+    {
+        const TBerTlvCacheEntry *cached = &cache->entries[found];
+        berTlv_sinkWrite(sink, (const char *)cached->blob, cached->resultSize);
+        berTlv_statsAddFormatted(cached->resultSize);
+        return true;
+    }
+
+    // Printed into the caller sink through a small buffer, and kept followed by the object bytes. The
+    // printer stops at the first error, the text is then not kept.
+    char buffer[BER_TLV_CACHE_CAPTURE_BUFFER_SIZE];
+    TBerTlvCacheCapture capture = {sink, NULL, 0, 0, cache->budget - size, false};
+    TBerTlvSink captureSink;
+
+    berTlv_sinkInit(&captureSink, buffer, sizeof(buffer), __captureWrite, &capture);
+    berTlv_printFormatWithError(data, size, &captureSink, format, errorOut);
+    if (!*errorOut && !capture.dropped && !sink->error)
+    {
+        char *blob = realloc(capture.text, capture.size + size);
+        if (blob)
+        {
+            memcpy(blob + capture.size, data, size);
+            __insert(cache, kind, (uint8_t *)blob, size, hash, capture.size);
+            capture.text = NULL;
+        }
+    }
+    free(capture.text);
+    return true;
+}
+
+/**
+ * @brief Write callback of the capture sink: forward the text to the caller sink and keep it.
+ */
+static bool __captureWrite(void *userData, const char *str, size_t size)
+{
+    TBerTlvCacheCapture *capture = userData;
+
+    berTlv_sinkWrite(capture->sink, str, size);
+    if (!capture->dropped && capture->size + size > capture->limit)
+        capture->dropped = true;
+    if (!capture->dropped && capture->size + size > capture->capacity)
+    {
+        size_t capacity = capture->capacity ? capture->capacity * 2 : BER_TLV_CACHE_CAPTURE_BUFFER_SIZE;
+        while (capacity < capture->size + size)
+        {
+            capacity *= 2;
+        }
+        char *text = realloc(capture->text, capacity);
+        if (text == NULL)
+            capture->dropped = true;
+        else
+        {
+            capture->text = text;
+            capture->capacity = capacity;
+        }
+    }
+    if (!capture->dropped)
+    {
+        memcpy(capture->text + capture->size, str, size);
+        capture->size += size;
+    }
+    return capture->sink->error;
+}
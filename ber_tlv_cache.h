@@ -0,0 +1,145 @@
+/**
+ * @file
+ * @brief Cache of the index and printed text of repeated constructed BER-TLV objects
+ */
+
+#ifndef __BER_TLV_CACHE_H
+#define __BER_TLV_CACHE_H
+
+#include "ber_tlv.h"
+
+//! Smallest top-level constructed object looked up in the cache, smaller ones are parsed again
+#ifndef BER_TLV_CACHE_MIN_SIZE
+#define BER_TLV_CACHE_MIN_SIZE 16
+#endif
+
+//! No entry, end of a bucket chain or of the LRU list
+#define BER_TLV_CACHE_NONE SIZE_MAX
+
+/**
+ * @brief Cached result of the bytes of a top-level constructed object
+ */
+typedef struct
+{
+    //! berTlv_hash() of the object bytes
+    uint64_t hash;
+    //! Cached result followed by a copy of the object bytes, allocated with malloc()
+    uint8_t *blob;
+    //! Object size in bytes
+    size_t keySize;
+    //! Result size in bytes, index entries or text
+    size_t resultSize;
+    //! 0 for an index, 1 + EBerTlvFormat for printed text
+    uint8_t kind;
+    //! Next entry of the same bucket
+    size_t bucketNext;
+    //! Previous, more recently used, entry
+    size_t lruPrev;
+    //! Next, less recently used, entry. Also links the free entries.
+    size_t lruNext;
+} TBerTlvCacheEntry;
+
+/**
+ * @brief LRU cache of the results of repeated constructed objects, e.g. the same FCI template in many
+ * messages
+ *
+ * Entries and buckets are supplied by the caller, the cached results are allocated with malloc()
+ * within a budget: the least recently used entries are evicted to make room. A cache is not
+ * thread-safe, use one per thread.
+ */
+typedef struct
+{
+    //! Caller supplied entries
+    TBerTlvCacheEntry *entries;
+    //! Number of entries
+    size_t entryCount;
+    //! Caller supplied buckets, first entry of each hash chain
+    size_t *buckets;
+    //! Number of buckets, a power of two
+    size_t bucketCount;
+    //! Maximum bytes allocated for the cached results and object copies
+    size_t budget;
+    //! Bytes currently allocated
+    size_t used;
+    //! Most recently used entry
+    size_t lruHead;
+    //! Least recently used entry, evicted first
+    size_t lruTail;
+    //! First free entry
+    size_t freeHead;
+    //! Objects found in the cache
+    uint64_t hits;
+    //! Objects parsed and added to the cache
+    uint64_t misses;
+    //! Entries evicted to make room
+    uint64_t evictions;
+} TBerTlvCache;
+
+/**
+ * @brief Fast non-cryptographic 64 bits hash of bytes.
+ */
+BER_TLV_API uint64_t berTlv_hash(const uint8_t *data, size_t size);
+
+/**
+ * @brief Initialize an empty cache.
+ * @param cache Cache to be initialized.
+ * @param entries Entries array, the maximum number of cached results.
+ * @param entryCount Number of entries.
+ * @param buckets Buckets array.
+ * @param bucketCount Number of buckets, a power of two.
+ * @param budget Maximum bytes allocated for the cached results.
+ */
+BER_TLV_API void berTlv_cacheInit(TBerTlvCache *cache, TBerTlvCacheEntry *entries, size_t entryCount,
+                                  size_t *buckets, size_t bucketCount, size_t budget);
+
+/**
+ * @brief Free all cached results, the cache is empty and can be used again.
+ */
+BER_TLV_API void berTlv_cacheClear(TBerTlvCache *cache);
+
+/**
+ * @brief Parse a whole raw data array into a flat index, see berTlv_index().
+ *
+ * The entries of each top-level constructed object of at least BER_TLV_CACHE_MIN_SIZE bytes are
+ * copied from the cache when the same bytes were indexed before, and added to it otherwise.
+ * @param cache Cache initialized with berTlv_cacheInit().
+ * @param data Raw data pointer
+ * @param size Data size in bytes
+ * @param index Index initialized with berTlv_indexInit().
+ * @return The result of berTlv_index().
+ */
+BER_TLV_API EBerTlvError berTlv_cacheIndex(TBerTlvCache *cache, uint8_t *data, size_t size, TBerTlvIndex *index);
+
+/**
+ * @brief Print raw data into an output sink, see berTlv_printFormatToSink().
+ *
+ * The text of each valid top-level constructed object of at least BER_TLV_CACHE_MIN_SIZE bytes, and
+ * at most the cache budget, is written from the cache when the same bytes were printed before in
+ * the same format, and added to it otherwise. Larger objects are printed without being hashed.
+ * The text, hex and binary formats don't depend on where the object is, so the text cached from
+ * an object is reused at any offset, in any data.
+ *
+ * BER_TLV_FORMAT_JSON is not cached: each line holds the offset of its object in the data, so the
+ * data is printed with berTlv_printFormatToSink() and the cache is neither read nor updated.
+ * @param cache Cache initialized with berTlv_cacheInit().
+ * @param data Raw data pointer
+ * @param size Data size in bytes
+ * @param sink Output sink.
+ * @param format Output format.
+ * @return Total bytes printed.
+ */
+BER_TLV_API size_t berTlv_cachePrint(TBerTlvCache *cache, uint8_t *data, size_t size, TBerTlvSink *sink,
+                                     EBerTlvFormat format);
+
+/**
+ * @brief Print raw data as BER TLV objects, see berTlv_printFromRawData().
+ * @warning outputStr must be large enough for the whole text.
+ * @param cache Cache initialized with berTlv_cacheInit().
+ * @param data pointer to raw data.
+ * @param size Data size in bytes.
+ * @param outputStr pointer to output string.
+ * @return Total bytes writen.
+ */
+BER_TLV_API size_t berTlv_cachePrintFromRawData(TBerTlvCache *cache, uint8_t *data, size_t size, char *outputStr);
+
+#endif
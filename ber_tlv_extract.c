@@ -0,0 +1,167 @@
+/**
+ * @file
+ * @brief Single pass extraction of requested tags, jumping over the objects that can't hold them
+ */
+
+#include "ber_tlv_extract.h"
+
+#include <string.h>
+
+//------------------------------------------------Static fuctions declaration----------------------------------------------------//
+static size_t __filterBit(uint32_t tag);
+static void __filterAdd(uint64_t *filter, uint32_t tag);
+static bool __filterTest(const uint64_t *filter, uint32_t tag);
+static bool __isContainer(const TBerTlvTagSet *set, uint32_t tag);
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Public functions------------------------------------------------------//
+
+EBerTlvError berTlv_tagSetInit(TBerTlvTagSet *set, const uint32_t *tags, size_t count)
+{
+    memset(set, 0, sizeof(*set));
+    if (count > BER_TLV_EXTRACT_MAX_TAGS)
+        return BER_TLV_ERR_INVALID_ARGUMENT;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        set->tags[i] = tags[i];
+        __filterAdd(set->tagFilter, tags[i]);
+    }
+    set->count = count;
+    return BER_TLV_OK;
+}
+
+EBerTlvError berTlv_tagSetAddContainer(TBerTlvTagSet *set, uint32_t tag)
+{
+    if (set->containerCount == BER_TLV_EXTRACT_MAX_TAGS)
+        return BER_TLV_ERR_INVALID_ARGUMENT;
+
+    set->containers[set->containerCount++] = tag;
+    __filterAdd(set->containerFilter, tag);
+    return BER_TLV_OK;
+}
+
+EBerTlvError berTlv_extractSet(uint8_t *data, size_t size, const TBerTlvTagSet *set, TBerTlvObj *objsOut,
+                               size_t *errorOffset)
+{
+    size_t endStack[BER_TLV_EXTRACT_MAX_DEPTH];
+    size_t depth = 0;
+    size_t position = 0;
+    TBerTlvObj tlvObj;
+    size_t missing = set->count;
+    EBerTlvError err = BER_TLV_OK;
+
+    for (size_t i = 0; i < set->count; ++i)
+    {
+        objsOut[i].value = NULL;
+    }
+
+    while (missing)
+    {
+        // Leave every entered constructed object that ends at the current position
+        while (depth && endStack[depth - 1] == position)
+        {
+            depth--;
+        }
+        size_t limit = depth ? endStack[depth - 1] : size;
+        size_t remainingSize = limit - position;
+        if (remainingSize == 0)
+            break;
+
+        err = berTlv_parseRawData(data + position, &remainingSize, &tlvObj, depth == 0);
+        // Garbage data was skipped, even on error
+        position = limit - remainingSize;
+        if (err || remainingSize == 0)
+            break;
+
+        if (__filterTest(set->tagFilter, tlvObj.tag))
+        {
+            for (size_t i = 0; i < set->count; ++i)
+            {
+                if (set->tags[i] == tlvObj.tag && objsOut[i].value == NULL)
+                {
+                    objsOut[i] = tlvObj;
+                    missing--;
+                }
+            }
+        }
+
+        // Values are jumped over, unless the object may hold requested tags
+        size_t valueOffset = tlvObj.value - data;
+        if (tlvObj.constructed && missing && __isContainer(set, tlvObj.tag))
+        {
+            if (depth == BER_TLV_EXTRACT_MAX_DEPTH)
+            {
+                err = BER_TLV_ERR_DEPTH_OVERFLOW;
+                break;
+            }
+            endStack[depth++] = valueOffset + tlvObj.valueSize;
+            position = valueOffset;
+        }
+        else
+        {
+            position = valueOffset + tlvObj.valueSize;
+        }
+    }
+
+    if (missing == 0)
+        err = BER_TLV_OK;
+    if (errorOffset)
+        *errorOffset = err ? position : 0;
+    return err;
+}
+
+EBerTlvError berTlv_extract(uint8_t *data, size_t size, const uint32_t *tags, size_t count, TBerTlvObj *objsOut)
+{
+    TBerTlvTagSet set;
+    EBerTlvError err = berTlv_tagSetInit(&set, tags, count);
+
+    return err ? err : berTlv_extractSet(data, size, &set, objsOut, NULL);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Ptivate functions------------------------------------------------------//
+
+/**
+ * @brief Bit of a tag in a tag filter, from the high bits of a multiplicative hash.
+ */
+static size_t __filterBit(uint32_t tag)
+{
+    return (uint32_t)(tag * 0x9E3779B1u) >> (32 - 8);
+}
+
+/**
+ * @brief Set the bit of a tag in a tag filter.
+ */
+static void __filterAdd(uint64_t *filter, uint32_t tag)
+{
+    size_t bit = __filterBit(tag);
+    filter[bit / 64] |= 1ULL << (bit % 64);
+}
+
+/**
+ * @brief Test the bit of a tag in a tag filter.
+ * @return false if the tag is not in the filter, true if it may be.
+ */
+static bool __filterTest(const uint64_t *filter, uint32_t tag)
+{
+    size_t bit = __filterBit(tag);
+    return (filter[bit / 64] >> (bit % 64)) & 1;
+}
+
+/**
+ * @brief Check if a constructed object may hold requested tags and is entered.
+ */
+static bool __isContainer(const TBerTlvTagSet *set, uint32_t tag)
+{
+    if (set->containerCount == 0)
+        return true;
+    if (!__filterTest(set->containerFilter, tag))
+        return false;
+    for (size_t i = 0; i < set->containerCount; ++i)
+    {
+        if (set->containers[i] == tag)
+            return true;
+    }
+    return false;
+}
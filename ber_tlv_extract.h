@@ -0,0 +1,102 @@
+/**
+ * @file
+ * @brief Extraction of a few requested tags from BER-TLV data in a single pass
+ */
+
+#ifndef __BER_TLV_EXTRACT_H
+#define __BER_TLV_EXTRACT_H
+
+#include "ber_tlv.h"
+
+//! Maximum number of tags, and of container tags, of a tag set
+#ifndef BER_TLV_EXTRACT_MAX_TAGS
+#define BER_TLV_EXTRACT_MAX_TAGS 32
+#endif
+
+//! Maximum nesting level of berTlv_extractSet(), which keeps one end offset per level on the stack
+#ifndef BER_TLV_EXTRACT_MAX_DEPTH
+#define BER_TLV_EXTRACT_MAX_DEPTH 256
+#endif
+
+//! Number of bits of the tag filters of a tag set
+#define BER_TLV_TAG_FILTER_BITS 256
+
+/**
+ * @brief Precompiled set of requested tags
+ *
+ * A 256 bits filter, one bit per hash of the requested tags, rejects nearly all the other objects
+ * with a single bit test, and only the objects passing it are compared to the tags. Container tags
+ * are the constructed objects that may hold the requested tags: when there are none, every
+ * constructed object is entered.
+ */
+typedef struct
+{
+    //! Requested tags, in the order of the extracted objects
+    uint32_t tags[BER_TLV_EXTRACT_MAX_TAGS];
+    //! Number of requested tags
+    size_t count;
+    //! Bit of the hash of each requested tag
+    uint64_t tagFilter[BER_TLV_TAG_FILTER_BITS / 64];
+    //! Tags of the constructed objects that are entered
+    uint32_t containers[BER_TLV_EXTRACT_MAX_TAGS];
+    //! Number of container tags, 0 to enter every constructed object
+    size_t containerCount;
+    //! Bit of the hash of each container tag
+    uint64_t containerFilter[BER_TLV_TAG_FILTER_BITS / 64];
+} TBerTlvTagSet;
+
+/**
+ * @brief Compile the requested tags into a tag set, without container tags.
+ * @param set Tag set to be initialized.
+ * @param tags Requested tags, e.g. 0x9F02. The same tag can be requested several times.
+ * @param count Number of tags, at most BER_TLV_EXTRACT_MAX_TAGS.
+ * @return BER_TLV_OK or BER_TLV_ERR_INVALID_ARGUMENT if there are too many tags.
+ */
+BER_TLV_API EBerTlvError berTlv_tagSetInit(TBerTlvTagSet *set, const uint32_t *tags, size_t count);
+
+/**
+ * @brief Add the tag of constructed objects that may hold requested tags.
+ *
+ * Once a container tag is added, only the constructed objects with a container tag are entered,
+ * the others are jumped over using their length.
+ * @param set Tag set initialized with berTlv_tagSetInit().
+ * @param tag Tag of a constructed object, e.g. 0x70.
+ * @return BER_TLV_OK or BER_TLV_ERR_INVALID_ARGUMENT if there are already BER_TLV_EXTRACT_MAX_TAGS
+ * container tags.
+ */
+BER_TLV_API EBerTlvError berTlv_tagSetAddContainer(TBerTlvTagSet *set, uint32_t tag);
+
+/**
+ * @brief Find the requested objects of a tag set in a single pass.
+ *
+ * Objects are visited in the order of berTlv_index(): primitive values and the constructed objects
+ * that are not entered are jumped over using their length, so their content is not checked. The
+ * walk stops as soon as every requested object is found.
+ * @param data Raw data pointer
+ * @param size Data size in bytes
+ * @param set Tag set initialized with berTlv_tagSetInit().
+ * @param objsOut Receives the first object found with each requested tag, in the order of the tags.
+ * Its value is NULL if the tag was not found.
+ * @param errorOffset Receives the offset of the object that caused the error. May be NULL.
+ * @return BER_TLV_OK, the error that happened during the data parsing or BER_TLV_ERR_DEPTH_OVERFLOW
+ * beyond BER_TLV_EXTRACT_MAX_DEPTH entered objects. The objects found before the error are kept.
+ */
+BER_TLV_API EBerTlvError berTlv_extractSet(uint8_t *data, size_t size, const TBerTlvTagSet *set,
+                                           TBerTlvObj *objsOut, size_t *errorOffset);
+
+/**
+ * @brief Find a few requested tags in a single pass, entering every constructed object.
+ *
+ * Same as berTlv_extractSet() with a tag set compiled from tags. When the same tags are extracted
+ * from many messages, compile them once with berTlv_tagSetInit() instead.
+ * @param data Raw data pointer
+ * @param size Data size in bytes
+ * @param tags Requested tags.
+ * @param count Number of tags, at most BER_TLV_EXTRACT_MAX_TAGS.
+ * @param objsOut Receives the first object found with each requested tag, see berTlv_extractSet().
+ * @return The result of berTlv_extractSet() or BER_TLV_ERR_INVALID_ARGUMENT if there are too many tags.
+ */
+BER_TLV_API EBerTlvError berTlv_extract(uint8_t *data, size_t size, const uint32_t *tags, size_t count,
+                                        TBerTlvObj *objsOut);
+
+#endif
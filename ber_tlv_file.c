@@ -0,0 +1,110 @@
+/**
+ * @file
+ * @brief Memory mapped file parsing of BER-TLV records
+ */
+
+#include "ber_tlv_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//------------------------------------------------Static fuctions declaration----------------------------------------------------//
+static bool __openFailed(TBerTlvFile *file);
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Public functions------------------------------------------------------//
+
+bool berTlv_fileOpen(TBerTlvFile *file, const char *path)
+{
+    struct stat fileStat;
+
+    file->data = NULL;
+    file->size = 0;
+    file->position = 0;
+    file->error = BER_TLV_OK;
+    file->errorOffset = 0;
+
+    file->fd = open(path, O_RDONLY);
+    if (file->fd < 0)
+        return true;
+
+    if (fstat(file->fd, &fileStat) < 0)
+        return __openFailed(file);
+
+    // Nothing to map for an empty file
+    if (fileStat.st_size == 0)
+        return false;
+
+    void *mapping = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+    if (mapping == MAP_FAILED)
+        return __openFailed(file);
+
+    // Records are parsed from the beginning to the end, let the kernel read ahead aggressively
+    madvise(mapping, fileStat.st_size, MADV_SEQUENTIAL);
+
+    file->data = mapping;
+    file->size = fileStat.st_size;
+    return false;
+}
+
+bool berTlv_fileNextRecord(TBerTlvFile *file, TBerTlvObj *recordOut)
+{
+    size_t remainingSize = file->size - file->position;
+
+    if (remainingSize == 0 || file->error)
+        return false;
+
+    file->error = berTlv_parseRawData(file->data + file->position, &remainingSize, recordOut, true);
+    if (file->error)
+    {
+        file->errorOffset = file->size - remainingSize;
+        return false;
+    }
+    // All remaining bytes were garbage data
+    if (remainingSize == 0)
+    {
+        file->position = file->size;
+        return false;
+    }
+
+    file->position = (recordOut->value - file->data) + recordOut->valueSize;
+    return true;
+}
+
+void berTlv_fileClose(TBerTlvFile *file)
+{
+    if (file->data)
+        munmap(file->data, file->size);
+    if (file->fd >= 0)
+        close(file->fd);
+
+    file->data = NULL;
+    file->size = 0;
+    file->position = 0;
+    file->fd = -1;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Ptivate functions------------------------------------------------------//
+
+/**
+ * @brief Close the descriptor of a file that couldn't be mapped, keeping errno.
+ *
+ * The file is left closed, so that berTlv_fileClose() does nothing, even if the descriptor number is
+ * reused in the meantime.
+ * @return true, the result of berTlv_fileOpen().
+ */
+static bool __openFailed(TBerTlvFile *file)
+{
+    int savedErrno = errno;
+
+    close(file->fd);
+    file->fd = -1;
+    file->data = NULL;
+    file->size = 0;
+    errno = savedErrno;
+    return true;
+}
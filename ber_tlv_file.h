@@ -0,0 +1,62 @@
+/**
+ * @file
+ * @brief Memory mapped file parsing of BER-TLV records
+ */
+
+#ifndef __BER_TLV_FILE_H
+#define __BER_TLV_FILE_H
+
+#include "ber_tlv.h"
+
+/**
+ * @brief Read-only memory mapped file of concatenated BER TLV records
+ * 
+ * Records may be separated by garbage data (0x00 or 0xFF), as in raw data arrays. All objects 
+ * parsed from a file point into the mapped pages and are valid until berTlv_fileClose().
+ */
+typedef struct
+{
+    //! Mapped file content. It is read-only and must not be patched
+    uint8_t *data;
+    //! File size in bytes
+    size_t size;
+    //! Offset of the next byte to be read by berTlv_fileNextRecord()
+    size_t position;
+    //! Error found by berTlv_fileNextRecord() in malformed data
+    EBerTlvError error;
+    //! File offset of the record that caused the error
+    size_t errorOffset;
+    //! File descriptor
+    int fd;
+} TBerTlvFile;
+
+/**
+ * @brief Map a whole file in memory for sequential parsing.
+ * 
+ * data and size can be used directly with any function taking a raw data array, e.g. 
+ * berTlv_index().
+ * @param file File to be initialized.
+ * @param path File path.
+ * @return true if the file couldn't be opened or mapped, errno tells the reason. The file is then
+ * closed, and berTlv_fileClose() does nothing.
+ */
+BER_TLV_API bool berTlv_fileOpen(TBerTlvFile *file, const char *path);
+
+/**
+ * @brief Parse the next top-level record of a file.
+ * 
+ * Garbage data before the record is skipped. As for a constructed object, the record value holds 
+ * its whole content.
+ * @param file File opened with berTlv_fileOpen().
+ * @param recordOut Pointer to the tlv object that will be filled with the record.
+ * @return true if a record was parsed, false at the end of the file or if the data is malformed
+ * (error and errorOffset are set in this case).
+ */
+BER_TLV_API bool berTlv_fileNextRecord(TBerTlvFile *file, TBerTlvObj *recordOut);
+
+/**
+ * @brief Unmap and close a file. Objects parsed from the file are no longer valid.
+ */
+BER_TLV_API void berTlv_fileClose(TBerTlvFile *file);
+
+#endif
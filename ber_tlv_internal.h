@@ -0,0 +1,54 @@
+/**
+ * @file
+ * @brief Encoding constants, SIMD selection and helpers shared by the sources of the BER-TLV lib, not part of its API
+ */
+
+#ifndef __BER_TLV_INTERNAL_H
+#define __BER_TLV_INTERNAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ber_tlv.h"
+
+// Vectorized garbage data skipping and tag search, disabled with -DBER_TLV_NO_SIMD
+#if !defined(BER_TLV_NO_SIMD) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define BER_TLV_SIMD_X86
+#include <immintrin.h>
+#elif !defined(BER_TLV_NO_SIMD) && defined(__aarch64__) && defined(__ARM_NEON)
+#define BER_TLV_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+//! Bit position of TLV object class in the Tag field
+static const uint8_t TAG_CLASS_BIT_POS = 6;
+//! Bits b5 to b1 of the first tag byte all set mean that subsequent tag bytes follow
+static const uint8_t MULTIPLE_BYTES_TAG_MASK = 0x1F;
+//! Bit b8 of a subsequent tag byte set means that another tag byte follows
+static const uint8_t SUBSEQUENT_TAG_BYTE_MASK = 0x80;
+//! Maximum size of the tag field, so that the tag fits in an uint32_t
+static const uint8_t MAX_TAG_SIZE = 4;
+//! Bit mask used to know if the lenght field has multiple bytes.
+static const uint8_t MULTPLES_BYTES_LENGTH_MASK = 0x80;
+//! Maximum number of subsequent length bytes
+static const uint8_t MAX_SUBSEQUENT_LENGTH_BYTES = 4;
+//! Largest value size with 4 subsequent length bytes
+static const size_t MAX_VALUE_SIZE = 0xFFFFFFFF;
+
+/**
+ * @brief Print callback of a top-level constructed object, from its first byte to its end.
+ * @param errorOut Receives the error that interrupted the printing of the object.
+ * @return true if the text of the object was written into sink, the printer then goes on after the object.
+ */
+typedef bool (*TBerTlvPrintObjectFn)(void *userData, uint8_t *data, size_t size, TBerTlvSink *sink,
+                                     EBerTlvFormat format, EBerTlvError *errorOut);
+
+//! berTlv_printFormatToSink() also giving the error that interrupted the printing, BER_TLV_OK if all data was printed
+size_t berTlv_printFormatWithError(uint8_t *data, size_t size, TBerTlvSink *sink, EBerTlvFormat format,
+                                   EBerTlvError *errorOut);
+//! berTlv_printFormatToSink() letting printObject write the text of the top-level constructed objects
+size_t berTlv_printFormatWithHook(uint8_t *data, size_t size, TBerTlvSink *sink, EBerTlvFormat format,
+                                  TBerTlvPrintObjectFn printObject, void *userData);
+//! Count text written without the printer, e.g. from a cache, in the formatted bytes of the calling thread
+void berTlv_statsAddFormatted(size_t count);
+
+#endif
@@ -0,0 +1,219 @@
+/**
+ * @file
+ * @brief In-place patching of primitive values of indexed BER-TLV data
+ */
+
+#include "ber_tlv_patch.h"
+#include "ber_tlv_builder.h"
+#include "ber_tlv_internal.h"
+
+#include <string.h>
+#include <stddef.h>
+
+//! Maximum nesting level of a patched object, the chain of its enclosing objects is kept on the stack
+#ifndef BER_TLV_PATCH_MAX_DEPTH
+#define BER_TLV_PATCH_MAX_DEPTH 64
+#endif
+
+/**
+ * @brief Old and new layout of an object of the patched chain
+ */
+typedef struct
+{
+    //! Entry index
+    size_t entry;
+    //! Offset of the length field before the patch
+    size_t lengthOffset;
+    //! Offset of the value before the patch
+    size_t valueOffset;
+    //! Length field size before the patch
+    uint8_t oldLengthSize;
+    //! New length field size
+    uint8_t lengthSize;
+    //! New value size
+    size_t valueSize;
+    //! Shift of the bytes from the old value offset up to the length field of the next object of the chain
+    ptrdiff_t shift;
+} TBerTlvPatchLevel;
+
+//------------------------------------------------Static fuctions declaration----------------------------------------------------//
+static void __moveSegment(TBerTlvIndex *index, const TBerTlvPatchLevel *chain, size_t chainSize, size_t level,
+                          ptrdiff_t shift);
+static ptrdiff_t __shiftAt(const TBerTlvPatchLevel *chain, size_t chainSize, size_t targetEnd, ptrdiff_t growth,
+                           size_t offset);
+static void __updateEntries(TBerTlvIndex *index, const TBerTlvPatchLevel *chain, size_t chainSize, size_t targetEnd,
+                            ptrdiff_t growth);
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Public functions------------------------------------------------------//
+
+EBerTlvError berTlv_patchValue(TBerTlvIndex *index, size_t entryIndex, const uint8_t *value, size_t valueSize,
+                               size_t capacity)
+{
+    TBerTlvPatchLevel chain[BER_TLV_PATCH_MAX_DEPTH + 1];
+    TBerTlvIndexEntry *entries = index->entries;
+
+    if (entryIndex >= index->count || entries[entryIndex].obj.constructed)
+        return BER_TLV_ERR_INVALID_ARGUMENT;
+
+    // Same size, nothing moves
+    if (valueSize == entries[entryIndex].obj.valueSize)
+    {
+        if (valueSize)
+            memcpy(entries[entryIndex].obj.value, value, valueSize);
+        return BER_TLV_OK;
+    }
+
+    if (entries[entryIndex].depth > BER_TLV_PATCH_MAX_DEPTH)
+        return BER_TLV_ERR_DEPTH_OVERFLOW;
+    if (valueSize > MAX_VALUE_SIZE)
+        return BER_TLV_ERR_BAD_LENGTH_FORM;
+
+    // Chain of the object and its enclosing objects, top-level first
+    size_t chainSize = entries[entryIndex].depth + 1;
+    size_t current = entryIndex;
+    for (size_t i = chainSize; i > 0; --i)
+    {
+        TBerTlvPatchLevel *level = &chain[i - 1];
+        const TBerTlvIndexEntry *entry = &entries[current];
+
+        level->entry = current;
+        level->lengthOffset = entry->offset + entry->obj.tagSize;
+        level->valueOffset = entry->valueOffset;
+        level->oldLengthSize = entry->valueOffset - level->lengthOffset;
+        current = entry->parent;
+    }
+
+    // New sizes from the object up, each length field may grow or shrink with the value
+    ptrdiff_t growth = (ptrdiff_t)valueSize - (ptrdiff_t)entries[entryIndex].obj.valueSize;
+    for (size_t i = chainSize; i > 0; --i)
+    {
+        TBerTlvPatchLevel *level = &chain[i - 1];
+
+        level->valueSize = (i == chainSize) ? valueSize : entries[level->entry].obj.valueSize + growth;
+        if (level->valueSize > MAX_VALUE_SIZE)
+            return BER_TLV_ERR_BAD_LENGTH_FORM;
+        level->lengthSize = berTlv_lengthFieldSize(level->valueSize);
+        growth += (ptrdiff_t)level->lengthSize - level->oldLengthSize;
+    }
+    if (growth > 0 && (size_t)growth > capacity - index->size)
+        return BER_TLV_ERR_NO_SPACE;
+
+    // Shifts from the top-level object down, each length field moves what follows it
+    ptrdiff_t shift = 0;
+    for (size_t i = 0; i < chainSize; ++i)
+    {
+        shift += (ptrdiff_t)chain[i].lengthSize - chain[i].oldLengthSize;
+        chain[i].shift = shift;
+    }
+
+    /*
+     * The bytes kept are the segments of the enclosing objects, from their value up to the length
+     * field of the next object of the chain, and the tail after the object. They keep their order,
+     * so the segments moved to the left can't overwrite anything not moved yet when moved from the
+     * first one, and the segments moved to the right when moved from the last one.
+     */
+    uint8_t *data = index->data;
+    size_t targetEnd = entries[entryIndex].end;
+    for (size_t i = 0; i < chainSize; ++i)
+    {
+        ptrdiff_t segmentShift = (i + 1 < chainSize) ? chain[i].shift : growth;
+        if (segmentShift < 0)
+            __moveSegment(index, chain, chainSize, i, segmentShift);
+    }
+    for (size_t i = chainSize; i > 0; --i)
+    {
+        ptrdiff_t segmentShift = (i < chainSize) ? chain[i - 1].shift : growth;
+        if (segmentShift > 0)
+            __moveSegment(index, chain, chainSize, i - 1, segmentShift);
+    }
+
+    for (size_t i = 0; i < chainSize; ++i)
+    {
+        ptrdiff_t parentShift = i ? chain[i - 1].shift : 0;
+        berTlv_writeLength(data + chain[i].lengthOffset + parentShift, chain[i].valueSize, chain[i].lengthSize);
+    }
+    if (valueSize)
+        memcpy(data + chain[chainSize - 1].valueOffset + chain[chainSize - 1].shift, value, valueSize);
+
+    __updateEntries(index, chain, chainSize, targetEnd, growth);
+    return BER_TLV_OK;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Ptivate functions------------------------------------------------------//
+
+/**
+ * @brief Move the segment of an enclosing object of the chain, or the tail after the object for the
+ * last level.
+ */
+static void __moveSegment(TBerTlvIndex *index, const TBerTlvPatchLevel *chain, size_t chainSize, size_t level,
+                          ptrdiff_t shift)
+{
+    size_t start;
+    size_t end;
+
+    if (level + 1 < chainSize)
+    {
+        start = chain[level].valueOffset;
+        end = chain[level + 1].lengthOffset;
+    }
+    else
+    {
+        start = index->entries[chain[level].entry].end;
+        end = index->size;
+    }
+    memmove(index->data + start + shift, index->data + start, end - start);
+}
+
+/**
+ * @brief Shift of a byte offset of the data before the patch.
+ */
+static ptrdiff_t __shiftAt(const TBerTlvPatchLevel *chain, size_t chainSize, size_t targetEnd, ptrdiff_t growth,
+                           size_t offset)
+{
+    if (offset >= targetEnd)
+        return growth;
+    for (size_t i = chainSize; i > 0; --i)
+    {
+        if (offset >= chain[i - 1].valueOffset)
+            return chain[i - 1].shift;
+    }
+    return 0;
+}
+
+/**
+ * @brief Move the entries after the patched bytes and set the new sizes of the chain objects.
+ */
+static void __updateEntries(TBerTlvIndex *index, const TBerTlvPatchLevel *chain, size_t chainSize, size_t targetEnd,
+                            ptrdiff_t growth)
+{
+    // Entries are in data order, the ones before the top-level object of the chain don't move
+    for (size_t i = chain[0].entry; i < index->count; ++i)
+    {
+        TBerTlvIndexEntry *entry = &index->entries[i];
+
+        entry->offset += __shiftAt(chain, chainSize, targetEnd, growth, entry->offset);
+        entry->valueOffset += __shiftAt(chain, chainSize, targetEnd, growth, entry->valueOffset);
+        entry->end += __shiftAt(chain, chainSize, targetEnd, growth, entry->end);
+        entry->obj.value = index->data + entry->valueOffset;
+    }
+
+    for (size_t i = 0; i < chainSize; ++i)
+    {
+        TBerTlvIndexEntry *entry = &index->entries[chain[i].entry];
+        const uint8_t *lengthP = index->data + entry->offset + entry->obj.tagSize;
+
+        // An empty value of the patched object is at its old end, which had the tail shift
+        entry->valueOffset = chain[i].valueOffset + chain[i].shift;
+        entry->obj.value = index->data + entry->valueOffset;
+        entry->obj.valueSize = chain[i].valueSize;
+        entry->obj.lengthSize = chain[i].lengthSize;
+        entry->obj.lengthValue = 0;
+        for (uint8_t k = 0; k < chain[i].lengthSize; ++k)
+        {
+            entry->obj.lengthValue = (entry->obj.lengthValue << 8) | lengthP[k];
+        }
+    }
+    index->size += growth;
+}
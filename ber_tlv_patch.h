@@ -0,0 +1,31 @@
+/**
+ * @file
+ * @brief In-place patching of primitive values of indexed BER-TLV data
+ */
+
+#ifndef __BER_TLV_PATCH_H
+#define __BER_TLV_PATCH_H
+
+#include "ber_tlv.h"
+
+/**
+ * @brief Replace the value of a primitive object of an index, in place.
+ *
+ * A value of the same size is just copied over the old one. Otherwise only the bytes after the
+ * object are moved, by the size difference, and the length fields of the object and of its
+ * enclosing constructed objects are rewritten, with more or less length bytes if needed. The entries
+ * of the index are updated, so it stays valid.
+ * @param index Index filled by berTlv_index(). Its data is modified.
+ * @param entryIndex Entry of the primitive object.
+ * @param value New value. It must not point into the indexed data.
+ * @param valueSize New value size in bytes.
+ * @param capacity Size of the buffer holding the indexed data, at least index->size.
+ * @return BER_TLV_OK, BER_TLV_ERR_NO_SPACE if the data doesn't fit in capacity anymore,
+ * BER_TLV_ERR_BAD_LENGTH_FORM if a length can't be coded in 4 bytes, BER_TLV_ERR_DEPTH_OVERFLOW
+ * if the object is nested deeper than BER_TLV_PATCH_MAX_DEPTH, or BER_TLV_ERR_INVALID_ARGUMENT
+ * if the entry doesn't exist or is a constructed object. Nothing is changed on error.
+ */
+BER_TLV_API EBerTlvError berTlv_patchValue(TBerTlvIndex *index, size_t entryIndex, const uint8_t *value,
+                                           size_t valueSize, size_t capacity);
+
+#endif
@@ -0,0 +1,1054 @@
+/**
+ * @file
+ * @brief Ingestion pipeline of BER-TLV record streams, io_uring or epoll reads and indexing threads (Linux)
+ */
+
+#include "ber_tlv_pipeline.h"
+#include "ber_tlv_internal.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// io_uring through its system calls, so liburing is not needed. Disabled with -DBER_TLV_NO_IO_URING
+#if !defined(BER_TLV_NO_IO_URING) && __has_include(<linux/io_uring.h>)
+#define BER_TLV_PIPELINE_HAS_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+//! user_data of the read of the wake-up eventfd, sources use their number
+#define BER_TLV_PIPELINE_WAKE_EVENT UINT64_MAX
+//! user_data of the cancellation of the pending reads
+#define BER_TLV_PIPELINE_CANCEL_EVENT (UINT64_MAX - 1)
+//! Buffer of a job that is a stitch buffer, not a read buffer
+#define BER_TLV_PIPELINE_STITCH_JOB SIZE_MAX
+
+/**
+ * @brief Framing states of the top-level record being received
+ */
+enum
+{
+    //! Between records, skipping garbage bytes
+    FRAME_IDLE = 0,
+    //! Waiting for a subsequent tag byte
+    FRAME_TAG_NEXT,
+    //! Waiting for the first length byte
+    FRAME_LENGTH_FIRST,
+    //! Waiting for the subsequent length bytes
+    FRAME_LENGTH_NEXT,
+    //! Skipping the value
+    FRAME_VALUE
+};
+
+/**
+ * @brief Complete records of a buffer, indexed by a worker
+ */
+typedef struct
+{
+    //! Source number
+    size_t source;
+    //! First byte of the records
+    uint8_t *data;
+    //! Size of the records
+    size_t size;
+    //! Offset of data in the stream of the source
+    size_t streamOffset;
+    //! Read buffer released after the job, or BER_TLV_PIPELINE_STITCH_JOB
+    size_t buffer;
+    //! Stitch buffer of the source released after a stitch job
+    uint8_t stitch;
+} TBerTlvPipelineJob;
+
+#ifdef BER_TLV_PIPELINE_HAS_IO_URING
+/**
+ * @brief io_uring instance mapped from the kernel, with the read buffers in a provided buffer ring
+ */
+typedef struct
+{
+    int fd;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned *sqArray;
+    struct io_uring_sqe *sqes;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe *cqes;
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing;
+    size_t cqRingSize;
+    size_t sqesSize;
+    //! Provided buffer ring, group 0
+    struct io_uring_buf_ring *bufRing;
+    unsigned bufMask;
+    uint16_t bufTail;
+    //! Buffers of the ring not taken by a read yet
+    size_t bufAvailable;
+    //! Queued submission entries
+    unsigned toSubmit;
+    //! Requests without completion yet
+    size_t inflight;
+} TBerTlvPipelineRing;
+#endif
+
+/**
+ * @brief State shared by the I/O thread and the workers during berTlv_pipelineRun()
+ */
+typedef struct
+{
+    TBerTlvPipeline *pipeline;
+    //! Protects the jobs, the released buffers and the stitch busy flags
+    pthread_mutex_t lock;
+    //! Signaled when a job is queued or the run is finished
+    pthread_cond_t jobReady;
+    //! Signaled when a job is done
+    pthread_cond_t jobDone;
+    //! Job queue, each job holds a buffer so bufferCount jobs at most
+    TBerTlvPipelineJob *jobs;
+    size_t jobHead;
+    size_t jobCount;
+    //! Read buffers released by the workers, not given back to the backend yet
+    size_t *released;
+    size_t releasedCount;
+    //! Read buffers of the epoll backend not being read
+    size_t *idle;
+    size_t idleCount;
+    //! eventfd written by the workers after releasing a buffer
+    int wakeFd;
+    uint64_t wakeValue;
+    //! Set by a callback that stops the pipeline
+    bool stop;
+    //! No more jobs will be queued
+    bool finished;
+    //! Sources not ended
+    size_t activeCount;
+#ifdef BER_TLV_PIPELINE_HAS_IO_URING
+    TBerTlvPipelineRing *ring;
+#endif
+} TBerTlvPipelineRun;
+
+/**
+ * @brief Worker thread and its index, large enough for any buffer
+ */
+typedef struct
+{
+    TBerTlvPipelineRun *run;
+    pthread_t thread;
+    TBerTlvCtx ctx;
+    TBerTlvIndex index;
+} TBerTlvPipelineWorker;
+
+//------------------------------------------------Static fuctions declaration----------------------------------------------------//
+static size_t __frameRecord(TBerTlvPipelineSource *source, const uint8_t *data, size_t size, size_t pos,
+                            size_t chunkOffset);
+static void __onRead(TBerTlvPipelineRun *run, size_t sourceIndex, size_t buffer, size_t size);
+static void __onEnd(TBerTlvPipelineRun *run, size_t sourceIndex, int ioError);
+static EBerTlvError __onRunError(TBerTlvPipelineRun *run, int ioError);
+static uint8_t *__bufferData(const TBerTlvPipeline *pipeline, size_t buffer);
+static void __pushJob(TBerTlvPipelineRun *run, const TBerTlvPipelineJob *job);
+static uint8_t __acquireStitch(TBerTlvPipelineRun *run, TBerTlvPipelineSource *source);
+static void __recycleBuffer(TBerTlvPipelineRun *run, size_t buffer);
+static void __recycleReleased(TBerTlvPipelineRun *run);
+static bool __isStopped(TBerTlvPipelineRun *run);
+static void *__workerMain(void *arg);
+static EBerTlvError __runEpoll(TBerTlvPipelineRun *run);
+#ifdef BER_TLV_PIPELINE_HAS_IO_URING
+static bool __ringSetup(TBerTlvPipelineRing *ring, const TBerTlvPipeline *pipeline, size_t readBufferCount);
+static void __ringTeardown(TBerTlvPipelineRing *ring);
+static void __ringAddBuffer(TBerTlvPipelineRing *ring, const TBerTlvPipeline *pipeline, size_t buffer);
+static struct io_uring_sqe *__ringSqe(TBerTlvPipelineRing *ring, uint64_t userData);
+static void __ringPostRead(TBerTlvPipelineRun *run, size_t sourceIndex);
+static void __ringPostWake(TBerTlvPipelineRun *run);
+static int __ringEnter(TBerTlvPipelineRing *ring, unsigned minComplete);
+static EBerTlvError __runIoUring(TBerTlvPipelineRun *run);
+#endif
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Public functions------------------------------------------------------//
+
+void berTlv_pipelineInit(TBerTlvPipeline *pipeline, uint8_t *pool, size_t bufferSize, size_t bufferCount,
+                         unsigned workerCount, TBerTlvPipelineFn onIndex, void *userData)
+{
+    pipeline->pool = pool;
+    pipeline->bufferSize = bufferSize;
+    pipeline->bufferCount = bufferCount;
+    pipeline->workerCount = workerCount;
+    pipeline->onIndex = onIndex;
+    pipeline->userData = userData;
+    pipeline->sourceCount = 0;
+    pipeline->backend = BER_TLV_PIPELINE_IO_URING;
+    pipeline->useIoUring = true;
+}
+
+EBerTlvError berTlv_pipelineAddSource(TBerTlvPipeline *pipeline, int fd, size_t *sourceOut)
+{
+    size_t sourceIndex = pipeline->sourceCount;
+
+    // The stitch buffers of all sources and at least one read buffer
+    if (sourceIndex == BER_TLV_PIPELINE_MAX_SOURCES ||
+        pipeline->bufferCount <= (sourceIndex + 1) * BER_TLV_PIPELINE_STITCH_BUFFERS)
+        return BER_TLV_ERR_NO_SPACE;
+
+    TBerTlvPipelineSource *source = &pipeline->sources[sourceIndex];
+    memset(source, 0, sizeof(*source));
+    source->fd = fd;
+    for (size_t i = 0; i < BER_TLV_PIPELINE_STITCH_BUFFERS; ++i)
+    {
+        source->stitchBuffers[i] = sourceIndex * BER_TLV_PIPELINE_STITCH_BUFFERS + i;
+    }
+    pipeline->sourceCount++;
+    if (sourceOut)
+        *sourceOut = sourceIndex;
+    return BER_TLV_OK;
+}
+
+EBerTlvError berTlv_pipelineRun(TBerTlvPipeline *pipeline)
+{
+    TBerTlvPipelineWorker *workers = NULL;
+    TBerTlvIndexEntry *entries = NULL;
+    TBerTlvPipelineRun run;
+    unsigned workerCount = pipeline->workerCount;
+    unsigned startedCount = 0;
+    EBerTlvError err = BER_TLV_OK;
+
+    if (workerCount == 0)
+    {
+        long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+        workerCount = cpuCount > 0 ? (unsigned)cpuCount : 1;
+    }
+    if (workerCount > BER_TLV_PIPELINE_MAX_WORKERS)
+        workerCount = BER_TLV_PIPELINE_MAX_WORKERS;
+
+    memset(&run, 0, sizeof(run));
+    run.pipeline = pipeline;
+    run.activeCount = pipeline->sourceCount;
+    for (size_t i = 0; i < pipeline->sourceCount; ++i)
+    {
+        TBerTlvPipelineSource *source = &pipeline->sources[i];
+
+        source->position = 0;
+        source->error = BER_TLV_OK;
+        source->errorOffset = 0;
+        source->ioError = 0;
+        source->state = FRAME_IDLE;
+        source->stitchUsed = 0;
+        source->ended = false;
+    }
+    if (pipeline->sourceCount == 0)
+        return BER_TLV_OK;
+
+    // Each object has at least a tag and a length byte
+    size_t entryCapacity = pipeline->bufferSize / 2 + 1;
+    run.jobs = malloc(pipeline->bufferCount * sizeof(TBerTlvPipelineJob));
+    run.released = malloc(pipeline->bufferCount * sizeof(size_t));
+    run.idle = malloc(pipeline->bufferCount * sizeof(size_t));
+    workers = calloc(workerCount, sizeof(TBerTlvPipelineWorker));
+    entries = malloc(workerCount * entryCapacity * sizeof(TBerTlvIndexEntry));
+    run.wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (!run.jobs || !run.released || !run.idle || !workers || !entries || run.wakeFd < 0)
+    {
+        err = BER_TLV_ERR_NO_SPACE;
+        goto cleanup;
+    }
+    pthread_mutex_init(&run.lock, NULL);
+    pthread_cond_init(&run.jobReady, NULL);
+    pthread_cond_init(&run.jobDone, NULL);
+
+    for (; startedCount < workerCount; ++startedCount)
+    {
+        TBerTlvPipelineWorker *worker = &workers[startedCount];
+
+        worker->run = &run;
+        berTlv_ctxInit(&worker->ctx, NULL, 0, NULL);
+        berTlv_indexInit(&worker->index, entries + startedCount * entryCapacity, entryCapacity);
+        if (pthread_create(&worker->thread, NULL, __workerMain, worker))
+            break;
+    }
+
+    if (startedCount == 0)
+        err = BER_TLV_ERR_NO_SPACE;
+    else
+    {
+#ifdef BER_TLV_PIPELINE_HAS_IO_URING
+        TBerTlvPipelineRing ring;
+        size_t readBufferCount = pipeline->bufferCount - pipeline->sourceCount * BER_TLV_PIPELINE_STITCH_BUFFERS;
+
+        if (pipeline->useIoUring && __ringSetup(&ring, pipeline, readBufferCount))
+        {
+            pipeline->backend = BER_TLV_PIPELINE_IO_URING;
+            run.ring = &ring;
+            err = __runIoUring(&run);
+            run.ring = NULL;
+            __ringTeardown(&ring);
+        }
+        else
+#endif
+        {
+            pipeline->backend = BER_TLV_PIPELINE_EPOLL;
+            err = __runEpoll(&run);
+        }
+    }
+
+    // The workers index the queued jobs and exit
+    pthread_mutex_lock(&run.lock);
+    run.finished = true;
+    pthread_cond_broadcast(&run.jobReady);
+    pthread_mutex_unlock(&run.lock);
+    for (unsigned i = 0; i < startedCount; ++i)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+    pthread_cond_destroy(&run.jobDone);
+    pthread_cond_destroy(&run.jobReady);
+    pthread_mutex_destroy(&run.lock);
+
+    if (!err && run.stop)
+        err = BER_TLV_ERR_INTERRUPTED;
+    for (size_t i = 0; i < pipeline->sourceCount && !err; ++i)
+    {
+        if (pipeline->sources[i].ioError)
+            err = BER_TLV_ERR_INTERRUPTED;
+        else
+            err = pipeline->sources[i].error;
+    }
+
+cleanup:
+    if (run.wakeFd >= 0)
+        close(run.wakeFd);
+    free(entries);
+    free(workers);
+    free(run.idle);
+    free(run.released);
+    free(run.jobs);
+    return err;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Ptivate functions------------------------------------------------------//
+
+/**
+ * @brief Frame the top-level record being received, jumping over its value.
+ * @param pos Position of the first byte not framed yet.
+ * @param chunkOffset Stream offset of data.
+ * @return Position after the end of the record, or size if the data ends first or the record is malformed, with
+ * source->error set.
+ */
+static size_t __frameRecord(TBerTlvPipelineSource *source, const uint8_t *data, size_t size, size_t pos,
+                            size_t chunkOffset)
+{
+    while (pos < size)
+    {
+        uint8_t byte = data[pos];
+
+        switch (source->state)
+        {
+        case FRAME_IDLE:
+            // Garbage data between records
+            if (byte == 0x00 || byte == 0xFF)
+            {
+                while (++pos < size && (data[pos] == 0x00 || data[pos] == 0xFF))
+                {
+                }
+                break;
+            }
+            source->recordOffset = chunkOffset + pos;
+            pos++;
+            source->tagSize = 1;
+            source->state =
+                ((byte & MULTIPLE_BYTES_TAG_MASK) == MULTIPLE_BYTES_TAG_MASK) ? FRAME_TAG_NEXT : FRAME_LENGTH_FIRST;
+            break;
+
+        case FRAME_TAG_NEXT:
+            pos++;
+            source->tagSize++;
+            if (!(byte & SUBSEQUENT_TAG_BYTE_MASK))
+                source->state = FRAME_LENGTH_FIRST;
+            else if (source->tagSize == MAX_TAG_SIZE)
+                source->error = BER_TLV_ERR_TAG_TOO_LONG;
+            break;
+
+        case FRAME_LENGTH_FIRST:
+            pos++;
+            if (byte & MULTPLES_BYTES_LENGTH_MASK)
+            {
+                source->pendingLengthBytes = byte & ~MULTPLES_BYTES_LENGTH_MASK;
+                // The indefinite form (0x80) is not allowed in BER-TLV data objects
+                if (source->pendingLengthBytes == 0 || source->pendingLengthBytes > MAX_SUBSEQUENT_LENGTH_BYTES)
+                    source->error = BER_TLV_ERR_BAD_LENGTH_FORM;
+                source->remainingSize = 0;
+                source->state = FRAME_LENGTH_NEXT;
+            }
+            else
+            {
+                source->remainingSize = byte;
+                source->state = FRAME_VALUE;
+            }
+            break;
+
+        case FRAME_LENGTH_NEXT:
+            pos++;
+            source->remainingSize = (source->remainingSize << 8) | byte;
+            if (--source->pendingLengthBytes == 0)
+                source->state = FRAME_VALUE;
+            break;
+
+        default:
+            break;
+        }
+
+        if (source->error)
+        {
+            source->errorOffset = source->recordOffset;
+            return size;
+        }
+        if (source->state == FRAME_VALUE)
+        {
+            size_t valueBytes = size - pos;
+
+            if (valueBytes >= source->remainingSize)
+            {
+                source->state = FRAME_IDLE;
+                return pos + source->remainingSize;
+            }
+            source->remainingSize -= valueBytes;
+            return size;
+        }
+    }
+    return pos;
+}
+
+/**
+ * @brief Queue the complete records of a read buffer, and join the records split with the previous and next
+ * reads in the stitch buffers of the source.
+ */
+static void __onRead(TBerTlvPipelineRun *run, size_t sourceIndex, size_t buffer, size_t size)
+{
+    TBerTlvPipeline *pipeline = run->pipeline;
+    TBerTlvPipelineSource *source = &pipeline->sources[sourceIndex];
+    uint8_t *data = __bufferData(pipeline, buffer);
+    size_t chunkOffset = source->position;
+    size_t pos = 0;
+
+    source->position += size;
+
+    // End of the record split with the previous reads
+    if (source->stitchUsed)
+    {
+        uint8_t *stitchData = __bufferData(pipeline, source->stitchBuffers[source->stitchCurrent]);
+
+        pos = __frameRecord(source, data, size, 0, chunkOffset);
+        if (!source->error && pos > pipeline->bufferSize - source->stitchUsed)
+        {
+            source->error = BER_TLV_ERR_NO_SPACE;
+            source->errorOffset = source->recordOffset;
+        }
+        if (!source->error)
+        {
+            memcpy(stitchData + source->stitchUsed, data, pos);
+            source->stitchUsed += pos;
+        }
+        if (!source->error && source->state == FRAME_IDLE)
+        {
+            TBerTlvPipelineJob job = {sourceIndex,
+                                      stitchData,
+                                      source->stitchUsed,
+                                      source->recordOffset,
+                                      BER_TLV_PIPELINE_STITCH_JOB,
+                                      source->stitchCurrent};
+            __pushJob(run, &job);
+            source->stitchUsed = 0;
+        }
+    }
+
+    size_t regionStart = pos;
+    size_t regionEnd = pos;
+    while (!source->error && pos < size)
+    {
+        pos = __frameRecord(source, data, size, pos, chunkOffset);
+        if (source->state == FRAME_IDLE)
+            regionEnd = pos;
+    }
+
+    // Start of a record split with the next reads, copied before the buffer can be released by a worker
+    if (!source->error && source->state != FRAME_IDLE && !source->stitchUsed)
+    {
+        size_t tailStart = source->recordOffset - chunkOffset;
+
+        source->stitchCurrent = __acquireStitch(run, source);
+        memcpy(__bufferData(pipeline, source->stitchBuffers[source->stitchCurrent]), data + tailStart, size - tailStart);
+        source->stitchUsed = size - tailStart;
+        regionEnd = tailStart;
+    }
+
+    if (regionEnd > regionStart)
+    {
+        TBerTlvPipelineJob job = {sourceIndex, data + regionStart, regionEnd - regionStart, chunkOffset + regionStart,
+                                  buffer, 0};
+        __pushJob(run, &job);
+    }
+    else
+        __recycleBuffer(run, buffer);
+
+    if (source->error)
+        __onEnd(run, sourceIndex, 0);
+}
+
+/**
+ * @brief End a source, at end of file, on a read or framing error.
+ */
+static void __onEnd(TBerTlvPipelineRun *run, size_t sourceIndex, int ioError)
+{
+    TBerTlvPipelineSource *source = &run->pipeline->sources[sourceIndex];
+
+    if (source->ended)
+        return;
+    source->ended = true;
+    source->ioError = ioError;
+    if (!ioError && !source->error && source->state != FRAME_IDLE)
+    {
+        source->error = (source->state == FRAME_VALUE) ? BER_TLV_ERR_TRUNCATED_VALUE : BER_TLV_ERR_TRUNCATED_HEADER;
+        source->errorOffset = source->recordOffset;
+    }
+    source->stitchUsed = 0;
+    run->activeCount--;
+}
+
+/**
+ * @brief End the sources not ended yet when the backend can't wait for their reads any more.
+ * @param ioError errno of the failed wait, given to the sources.
+ * @return BER_TLV_ERR_INTERRUPTED, the result of the backend.
+ */
+static EBerTlvError __onRunError(TBerTlvPipelineRun *run, int ioError)
+{
+    for (size_t i = 0; i < run->pipeline->sourceCount; ++i)
+    {
+        __onEnd(run, i, ioError);
+    }
+    return BER_TLV_ERR_INTERRUPTED;
+}
+
+/**
+ * @brief First byte of a pool buffer.
+ */
+static uint8_t *__bufferData(const TBerTlvPipeline *pipeline, size_t buffer)
+{
+    return pipeline->pool + buffer * pipeline->bufferSize;
+}
+
+/**
+ * @brief Queue a job for the workers, marking its stitch buffer busy.
+ */
+static void __pushJob(TBerTlvPipelineRun *run, const TBerTlvPipelineJob *job)
+{
+    pthread_mutex_lock(&run->lock);
+    if (job->buffer == BER_TLV_PIPELINE_STITCH_JOB)
+        run->pipeline->sources[job->source].stitchBusy[job->stitch] = true;
+    run->jobs[(run->jobHead + run->jobCount) % run->pipeline->bufferCount] = *job;
+    run->jobCount++;
+    pthread_cond_signal(&run->jobReady);
+    pthread_mutex_unlock(&run->lock);
+}
+
+/**
+ * @brief Get a stitch buffer of a source whose record is not being indexed, waiting for the workers if needed.
+ */
+static uint8_t __acquireStitch(TBerTlvPipelineRun *run, TBerTlvPipelineSource *source)
+{
+    uint8_t stitch = 0;
+
+    pthread_mutex_lock(&run->lock);
+    for (;;)
+    {
+        while (stitch < BER_TLV_PIPELINE_STITCH_BUFFERS && source->stitchBusy[stitch])
+        {
+            ++stitch;
+        }
+        if (stitch < BER_TLV_PIPELINE_STITCH_BUFFERS)
+            break;
+        pthread_cond_wait(&run->jobDone, &run->lock);
+        stitch = 0;
+    }
+    pthread_mutex_unlock(&run->lock);
+    return stitch;
+}
+
+/**
+ * @brief Give a read buffer back to the backend, from the I/O thread.
+ */
+static void __recycleBuffer(TBerTlvPipelineRun *run, size_t buffer)
+{
+#ifdef BER_TLV_PIPELINE_HAS_IO_URING
+    if (run->ring)
+    {
+        __ringAddBuffer(run->ring, run->pipeline, buffer);
+        return;
+    }
+#endif
+    run->idle[run->idleCount++] = buffer;
+}
+
+/**
+ * @brief Give the read buffers released by the workers back to the backend.
+ */
+static void __recycleReleased(TBerTlvPipelineRun *run)
+{
+    size_t released[64];
+    size_t count;
+
+    do
+    {
+        pthread_mutex_lock(&run->lock);
+        count = run->releasedCount < 64 ? run->releasedCount : 64;
+        run->releasedCount -= count;
+        memcpy(released, run->released + run->releasedCount, count * sizeof(size_t));
+        pthread_mutex_unlock(&run->lock);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            __recycleBuffer(run, released[i]);
+        }
+    } while (count == 64);
+}
+
+/**
+ * @brief Whether a callback stopped the pipeline.
+ */
+static bool __isStopped(TBerTlvPipelineRun *run)
+{
+    return __atomic_load_n(&run->stop, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Worker thread: index the queued jobs, give them to the callback and release their buffer.
+ */
+static void *__workerMain(void *arg)
+{
+    TBerTlvPipelineWorker *worker = arg;
+    TBerTlvPipelineRun *run = worker->run;
+    TBerTlvPipeline *pipeline = run->pipeline;
+    const uint64_t wake = 1;
+
+    pthread_mutex_lock(&run->lock);
+    for (;;)
+    {
+        while (!run->jobCount && !run->finished)
+        {
+            pthread_cond_wait(&run->jobReady, &run->lock);
+        }
+        if (!run->jobCount)
+            break;
+
+        TBerTlvPipelineJob job = run->jobs[run->jobHead];
+        run->jobHead = (run->jobHead + 1) % pipeline->bufferCount;
+        run->jobCount--;
+        pthread_mutex_unlock(&run->lock);
+
+        // Jobs queued after a stop only release their buffer
+        if (!__isStopped(run))
+        {
+            EBerTlvError err = berTlv_ctxIndex(&worker->ctx, job.data, job.size, &worker->index);
+            if (pipeline->onIndex(pipeline->userData, job.source, job.streamOffset, err, &worker->index))
+                __atomic_store_n(&run->stop, true, __ATOMIC_RELEASE);
+        }
+
+        pthread_mutex_lock(&run->lock);
+        if (job.buffer == BER_TLV_PIPELINE_STITCH_JOB)
+            pipeline->sources[job.source].stitchBusy[job.stitch] = false;
+        else
+            run->released[run->releasedCount++] = job.buffer;
+        pthread_cond_signal(&run->jobDone);
+        pthread_mutex_unlock(&run->lock);
+
+        // Nothing to do if the eventfd counter is saturated, the I/O thread is woken up anyway
+        if (write(run->wakeFd, &wake, sizeof(wake)) < 0)
+        {
+        }
+        pthread_mutex_lock(&run->lock);
+    }
+    pthread_mutex_unlock(&run->lock);
+    return NULL;
+}
+
+/**
+ * @brief epoll backend: read each readable source into an idle buffer. Regular files can't be polled, they are
+ * always readable.
+ */
+static EBerTlvError __runEpoll(TBerTlvPipelineRun *run)
+{
+    TBerTlvPipeline *pipeline = run->pipeline;
+    struct epoll_event events[BER_TLV_PIPELINE_MAX_SOURCES + 1];
+    bool ready[BER_TLV_PIPELINE_MAX_SOURCES] = {false};
+    bool alwaysReady[BER_TLV_PIPELINE_MAX_SOURCES] = {false};
+    struct epoll_event event;
+    EBerTlvError err = BER_TLV_OK;
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (epollFd < 0)
+        return BER_TLV_ERR_NO_SPACE;
+
+    run->idleCount = 0;
+    for (size_t i = pipeline->sourceCount * BER_TLV_PIPELINE_STITCH_BUFFERS; i < pipeline->bufferCount; ++i)
+    {
+        run->idle[run->idleCount++] = i;
+    }
+    event.events = EPOLLIN;
+    event.data.u64 = BER_TLV_PIPELINE_WAKE_EVENT;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, run->wakeFd, &event);
+    for (size_t i = 0; i < pipeline->sourceCount; ++i)
+    {
+        event.events = EPOLLIN;
+        event.data.u64 = i;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, pipeline->sources[i].fd, &event))
+            alwaysReady[i] = ready[i] = true;
+    }
+
+    while (run->activeCount && !__isStopped(run))
+    {
+        bool pendingRead = false;
+
+        __recycleReleased(run);
+        // All buffers are being indexed, wait for the workers
+        if (!run->idleCount)
+        {
+            if (read(run->wakeFd, &run->wakeValue, sizeof(run->wakeValue)) < 0 && errno != EINTR)
+                err = __onRunError(run, errno);
+            continue;
+        }
+
+        for (size_t i = 0; i < pipeline->sourceCount && run->idleCount; ++i)
+        {
+            TBerTlvPipelineSource *source = &pipeline->sources[i];
+
+            if (!ready[i] || source->ended)
+                continue;
+
+            size_t buffer = run->idle[--run->idleCount];
+            ssize_t readSize = read(source->fd, __bufferData(pipeline, buffer), pipeline->bufferSize);
+            if (readSize > 0)
+                __onRead(run, i, buffer, (size_t)readSize);
+            else
+            {
+                __recycleBuffer(run, buffer);
+                if (readSize == 0)
+                    __onEnd(run, i, 0);
+                else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    __onEnd(run, i, errno);
+            }
+            ready[i] = alwaysReady[i] && !source->ended;
+            pendingRead |= ready[i];
+        }
+        if (!run->activeCount)
+            break;
+
+        int eventCount = epoll_wait(epollFd, events, BER_TLV_PIPELINE_MAX_SOURCES + 1, pendingRead ? 0 : -1);
+        if (eventCount < 0 && errno != EINTR)
+            err = __onRunError(run, errno);
+        for (int i = 0; i < eventCount; ++i)
+        {
+            if (events[i].data.u64 == BER_TLV_PIPELINE_WAKE_EVENT)
+            {
+                if (read(run->wakeFd, &run->wakeValue, sizeof(run->wakeValue)) < 0)
+                {
+                }
+            }
+            else
+                ready[events[i].data.u64] = true;
+        }
+    }
+
+    close(epollFd);
+    return err;
+}
+
+#ifdef BER_TLV_PIPELINE_HAS_IO_URING
+/**
+ * @brief Create the io_uring instance and register the read buffers as its provided buffer ring.
+ * @return false if io_uring or provided buffer rings are not available.
+ */
+static bool __ringSetup(TBerTlvPipelineRing *ring, const TBerTlvPipeline *pipeline, size_t readBufferCount)
+{
+    struct io_uring_params params;
+    struct io_uring_buf_reg bufReg;
+    unsigned bufEntries = 1;
+
+    // Buffer ids and read sizes of the kernel interface
+    if (readBufferCount > 32768 || pipeline->bufferCount > UINT16_MAX + 1 || pipeline->bufferSize > UINT32_MAX)
+        return false;
+    while (bufEntries < readBufferCount)
+    {
+        bufEntries <<= 1;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    // One read per source, the eventfd read and the cancellation
+    ring->fd = (int)syscall(__NR_io_uring_setup, (unsigned)pipeline->sourceCount + 2, &params);
+    if (ring->fd < 0)
+        return false;
+
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring->cqRingSize > ring->sqRingSize)
+            ring->sqRingSize = ring->cqRingSize;
+        ring->cqRingSize = 0;
+    }
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                        IORING_OFF_SQ_RING);
+    ring->cqRing = ring->cqRingSize ? mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                           ring->fd, IORING_OFF_CQ_RING)
+                                    : ring->sqRing;
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                      IORING_OFF_SQES);
+    if (ring->sqRing == MAP_FAILED || ring->cqRing == MAP_FAILED || ring->sqes == MAP_FAILED ||
+        posix_memalign((void **)&ring->bufRing, (size_t)sysconf(_SC_PAGESIZE), bufEntries * sizeof(struct io_uring_buf)))
+    {
+        ring->bufRing = NULL;
+        __ringTeardown(ring);
+        return false;
+    }
+
+    uint8_t *sq = ring->sqRing;
+    uint8_t *cq = ring->cqRing;
+    ring->sqHead = (unsigned *)(sq + params.sq_off.head);
+    ring->sqTail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sqMask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sqEntries = *(unsigned *)(sq + params.sq_off.ring_entries);
+    ring->sqArray = (unsigned *)(sq + params.sq_off.array);
+    ring->cqHead = (unsigned *)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cqMask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    memset(ring->bufRing, 0, bufEntries * sizeof(struct io_uring_buf));
+    memset(&bufReg, 0, sizeof(bufReg));
+    bufReg.ring_addr = (uintptr_t)ring->bufRing;
+    bufReg.ring_entries = bufEntries;
+    bufReg.bgid = 0;
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &bufReg, 1) < 0)
+    {
+        __ringTeardown(ring);
+        return false;
+    }
+    ring->bufMask = bufEntries - 1;
+
+    for (size_t i = pipeline->bufferCount - readBufferCount; i < pipeline->bufferCount; ++i)
+    {
+        __ringAddBuffer(ring, pipeline, i);
+    }
+    return true;
+}
+
+/**
+ * @brief Unmap and close the io_uring instance, its buffer ring is unregistered with it.
+ */
+static void __ringTeardown(TBerTlvPipelineRing *ring)
+{
+    if (ring->sqes && ring->sqes != MAP_FAILED)
+        munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqRingSize && ring->cqRing && ring->cqRing != MAP_FAILED)
+        munmap(ring->cqRing, ring->cqRingSize);
+    if (ring->sqRing && ring->sqRing != MAP_FAILED)
+        munmap(ring->sqRing, ring->sqRingSize);
+    close(ring->fd);
+    free(ring->bufRing);
+}
+
+/**
+ * @brief Give a read buffer to the kernel, for the next read of any source.
+ */
+static void __ringAddBuffer(TBerTlvPipelineRing *ring, const TBerTlvPipeline *pipeline, size_t buffer)
+{
+    struct io_uring_buf *buf = &ring->bufRing->bufs[ring->bufTail & ring->bufMask];
+
+    buf->addr = (uintptr_t)__bufferData(pipeline, buffer);
+    buf->len = (uint32_t)pipeline->bufferSize;
+    buf->bid = (uint16_t)buffer;
+    ring->bufTail++;
+    ring->bufAvailable++;
+    // The tail shares the first entry, the kernel reads the entries up to it
+    __atomic_store_n(&ring->bufRing->tail, ring->bufTail, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Queue a submission entry. The ring has room for all requests of the pipeline.
+ */
+static struct io_uring_sqe *__ringSqe(TBerTlvPipelineRing *ring, uint64_t userData)
+{
+    unsigned tail = *ring->sqTail;
+    unsigned index = tail & ring->sqMask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = userData;
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring->toSubmit++;
+    ring->inflight++;
+    return sqe;
+}
+
+/**
+ * @brief Post the next read of a source, into a buffer chosen by the kernel when data is available.
+ */
+static void __ringPostRead(TBerTlvPipelineRun *run, size_t sourceIndex)
+{
+    struct io_uring_sqe *sqe = __ringSqe(run->ring, sourceIndex);
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = run->pipeline->sources[sourceIndex].fd;
+    // Current file position, i.e. sequential reads of regular files too
+    sqe->off = (uint64_t)-1;
+    sqe->len = (uint32_t)run->pipeline->bufferSize;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+}
+
+/**
+ * @brief Post the read of the eventfd the workers write after releasing a buffer.
+ */
+static void __ringPostWake(TBerTlvPipelineRun *run)
+{
+    struct io_uring_sqe *sqe = __ringSqe(run->ring, BER_TLV_PIPELINE_WAKE_EVENT);
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = run->wakeFd;
+    sqe->addr = (uintptr_t)&run->wakeValue;
+    sqe->len = sizeof(run->wakeValue);
+}
+
+/**
+ * @brief Submit the queued entries and wait for completions.
+ * @return 0 or -errno.
+ */
+static int __ringEnter(TBerTlvPipelineRing *ring, unsigned minComplete)
+{
+    long submitted;
+
+    do
+    {
+        submitted = syscall(__NR_io_uring_enter, ring->fd, ring->toSubmit, minComplete,
+                            minComplete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    } while (submitted < 0 && errno == EINTR);
+    if (submitted < 0)
+        return -errno;
+    ring->toSubmit -= (unsigned)submitted;
+    return 0;
+}
+
+/**
+ * @brief io_uring backend: one read in flight per source, completed into the provided buffers.
+ *
+ * When io_uring_enter() fails, the sources are ended with its errno and the reads in flight are
+ * cancelled and drained, so that no read lands in the pool after the run.
+ */
+static EBerTlvError __runIoUring(TBerTlvPipelineRun *run)
+{
+    TBerTlvPipeline *pipeline = run->pipeline;
+    TBerTlvPipelineRing *ring = run->ring;
+    bool starved[BER_TLV_PIPELINE_MAX_SOURCES] = {false};
+    bool cancelled = false;
+    EBerTlvError err = BER_TLV_OK;
+
+    __ringPostWake(run);
+    for (size_t i = 0; i < pipeline->sourceCount; ++i)
+    {
+        __ringPostRead(run, i);
+    }
+
+    while (ring->inflight)
+    {
+        // Remaining reads are cancelled once all sources ended or the pipeline is stopped
+        if (!cancelled && (!run->activeCount || __isStopped(run)))
+        {
+            struct io_uring_sqe *sqe = __ringSqe(ring, BER_TLV_PIPELINE_CANCEL_EVENT);
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+            cancelled = true;
+        }
+        int enterError = __ringEnter(ring, 1);
+        if (enterError)
+        {
+            // Already failed while draining, the ring teardown cancels what is left
+            if (err)
+                break;
+            err = __onRunError(run, -enterError);
+            continue;
+        }
+
+        unsigned head = *ring->cqHead;
+        unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head)
+        {
+            const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cqMask];
+            uint64_t userData = cqe->user_data;
+            int res = cqe->res;
+            bool hasBuffer = cqe->flags & IORING_CQE_F_BUFFER;
+            size_t buffer = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+            ring->inflight--;
+            if (hasBuffer)
+                ring->bufAvailable--;
+
+            if (userData == BER_TLV_PIPELINE_CANCEL_EVENT)
+                continue;
+            if (userData == BER_TLV_PIPELINE_WAKE_EVENT)
+            {
+                __recycleReleased(run);
+                if (!cancelled)
+                    __ringPostWake(run);
+                continue;
+            }
+
+            size_t sourceIndex = (size_t)userData;
+            TBerTlvPipelineSource *source = &pipeline->sources[sourceIndex];
+            if (res > 0 && hasBuffer && !cancelled)
+            {
+                __onRead(run, sourceIndex, buffer, (size_t)res);
+                if (!source->ended)
+                    __ringPostRead(run, sourceIndex);
+                continue;
+            }
+
+            if (hasBuffer)
+                __recycleBuffer(run, buffer);
+            if (cancelled)
+                continue;
+            if (res == -ENOBUFS)
+                starved[sourceIndex] = true;
+            else if (res == -EINTR || res == -EAGAIN)
+                __ringPostRead(run, sourceIndex);
+            else
+                __onEnd(run, sourceIndex, res < 0 ? -res : 0);
+        }
+        __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+
+        // Sources without buffer read again once the workers released some
+        for (size_t i = 0; i < pipeline->sourceCount && ring->bufAvailable && !cancelled; ++i)
+        {
+            if (starved[i])
+            {
+                starved[i] = false;
+                __ringPostRead(run, i);
+            }
+        }
+    }
+    return err;
+}
+#endif
+
+#endif
@@ -0,0 +1,153 @@
+/**
+ * @file
+ * @brief Ingestion pipeline of BER-TLV record streams from many file descriptors (Linux)
+ */
+
+#ifndef __BER_TLV_PIPELINE_H
+#define __BER_TLV_PIPELINE_H
+
+#include "ber_tlv.h"
+
+//! Maximum number of sources of a pipeline
+#define BER_TLV_PIPELINE_MAX_SOURCES 64
+//! Maximum number of worker threads of a pipeline
+#define BER_TLV_PIPELINE_MAX_WORKERS 64
+//! Pool buffers kept by each source to join the records split between two reads
+#define BER_TLV_PIPELINE_STITCH_BUFFERS 2
+
+/**
+ * @brief Index callback of the pipeline, called from the worker threads.
+ *
+ * The chunks of a source are indexed in parallel, so they may be received out of order and from
+ * several threads at once. The index and its data are only valid during the callback, the pool
+ * buffer is read again afterwards.
+ * @param userData User data given to berTlv_pipelineInit().
+ * @param source Source number returned by berTlv_pipelineAddSource().
+ * @param streamOffset Offset of the first indexed byte in the stream of the source.
+ * @param error Result of the indexing of the chunk, e.g. an error within a record.
+ * @param index Index of the complete top-level records of the chunk.
+ * @return true to stop the pipeline.
+ */
+typedef bool (*TBerTlvPipelineFn)(void *userData, size_t source, size_t streamOffset, EBerTlvError error,
+                                  const TBerTlvIndex *index);
+
+/**
+ * @brief I/O backend used by berTlv_pipelineRun()
+ */
+typedef enum
+{
+    //! Reads posted to io_uring, with the pool registered as a provided buffer ring
+    BER_TLV_PIPELINE_IO_URING = 0,
+    //! Readiness with epoll and read(), when io_uring is not available
+    BER_TLV_PIPELINE_EPOLL
+} EBerTlvPipelineBackend;
+
+/**
+ * @brief Source of a pipeline, a file descriptor of concatenated top-level records
+ */
+typedef struct
+{
+    //! File descriptor, read until end of file. It is not closed by the pipeline.
+    int fd;
+    //! Bytes read from the source
+    size_t position;
+    //! Framing error of the top-level records, or BER_TLV_ERR_TRUNCATED_* if the stream ended within a record
+    EBerTlvError error;
+    //! Stream offset of the record that caused the error
+    size_t errorOffset;
+    //! errno of the read that failed, 0 if none
+    int ioError;
+    //! Framing state of the record being received
+    uint8_t state;
+    //! Tag bytes of the record being received
+    uint8_t tagSize;
+    //! Length bytes still expected
+    uint8_t pendingLengthBytes;
+    //! Value bytes still expected
+    size_t remainingSize;
+    //! Stream offset of the record being received
+    size_t recordOffset;
+    //! Pool buffers where split records are joined
+    size_t stitchBuffers[BER_TLV_PIPELINE_STITCH_BUFFERS];
+    //! Busy flags of the stitch buffers, set while their record is indexed
+    bool stitchBusy[BER_TLV_PIPELINE_STITCH_BUFFERS];
+    //! Stitch buffer of the record being received
+    uint8_t stitchCurrent;
+    //! Bytes of the record being received in the current stitch buffer, 0 if it is not split
+    size_t stitchUsed;
+    //! No more reads are posted
+    bool ended;
+} TBerTlvPipelineSource;
+
+/**
+ * @brief Ingestion pipeline
+ *
+ * All reads land in a single caller supplied pool of buffers. The calling thread of
+ * berTlv_pipelineRun() posts the reads and frames the top-level records, the worker threads index
+ * the complete records of each buffer where they were read and give the index to the callback.
+ * Only the records split between two reads are copied, into stitch buffers of the pool.
+ */
+typedef struct
+{
+    //! Buffer pool
+    uint8_t *pool;
+    //! Size of each buffer, which is also the maximum size of a record split between two reads
+    size_t bufferSize;
+    //! Number of buffers of the pool
+    size_t bufferCount;
+    //! Number of worker threads
+    unsigned workerCount;
+    //! Index callback
+    TBerTlvPipelineFn onIndex;
+    //! User data given to the index callback
+    void *userData;
+    //! Sources
+    TBerTlvPipelineSource sources[BER_TLV_PIPELINE_MAX_SOURCES];
+    //! Number of sources
+    size_t sourceCount;
+    //! Backend used by the last run
+    EBerTlvPipelineBackend backend;
+    //! Try io_uring first, true by default
+    bool useIoUring;
+} TBerTlvPipeline;
+
+/**
+ * @brief Initialize a pipeline.
+ * @param pipeline Pipeline to be initialized.
+ * @param pool Buffer pool of bufferCount * bufferSize bytes.
+ * @param bufferSize Size of each buffer.
+ * @param bufferCount Number of buffers. BER_TLV_PIPELINE_STITCH_BUFFERS of them are kept by each
+ * source, the others are read buffers.
+ * @param workerCount Number of worker threads, up to BER_TLV_PIPELINE_MAX_WORKERS. 0 uses one thread
+ * per online CPU.
+ * @param onIndex Index callback.
+ * @param userData User data given to the index callback.
+ */
+BER_TLV_API void berTlv_pipelineInit(TBerTlvPipeline *pipeline, uint8_t *pool, size_t bufferSize, size_t bufferCount,
+                                     unsigned workerCount, TBerTlvPipelineFn onIndex, void *userData);
+
+/**
+ * @brief Add a source to a pipeline before it is run.
+ * @param pipeline Pipeline initialized with berTlv_pipelineInit().
+ * @param fd File descriptor: file, pipe or socket.
+ * @param sourceOut Receives the source number given to the callback. May be NULL.
+ * @return BER_TLV_OK or BER_TLV_ERR_NO_SPACE if there are BER_TLV_PIPELINE_MAX_SOURCES sources or
+ * not at least one read buffer left in the pool.
+ */
+BER_TLV_API EBerTlvError berTlv_pipelineAddSource(TBerTlvPipeline *pipeline, int fd, size_t *sourceOut);
+
+/**
+ * @brief Read all sources until end of file, indexing their records on the worker threads.
+ *
+ * io_uring is used when available and pipeline->useIoUring is set, epoll otherwise;
+ * pipeline->backend tells which one. A source stops at its first framing or read error, found in
+ * its error and ioError fields, while the others go on.
+ * @param pipeline Pipeline with its sources.
+ * @return BER_TLV_OK when all sources were read, BER_TLV_ERR_INTERRUPTED if the callback stopped
+ * the pipeline, a read failed or the backend could not wait for the reads (the errno is in the
+ * ioError field of the sources not ended before), the first framing error of a source, or
+ * BER_TLV_ERR_NO_SPACE if the threads or their index entries could not be allocated.
+ */
+BER_TLV_API EBerTlvError berTlv_pipelineRun(TBerTlvPipeline *pipeline);
+
+#endif
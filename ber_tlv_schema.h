@@ -0,0 +1,218 @@
+/**
+ * @file
+ * @brief Compile-time tag schemas and the specialized extractors generated from them
+ *
+ * A schema is an X-macro listing the expected objects of a message profile:
+ *
+ * @code
+ * #define EMV_SCHEMA(X)                                                        \
+ *     X(pan, 0x5A, BER_TLV_CLASS_APPLICATION, false, 10)                       \
+ *     X(track2, 0x57, BER_TLV_CLASS_APPLICATION, false, 19)                    \
+ *     X(amount, 0x9F02, BER_TLV_CLASS_CONTEXT_SPECIFIC, false, 6)
+ *
+ * BER_TLV_SCHEMA_DEFINE(EMV_SCHEMA, TEmvFields, emv_extract)
+ * @endcode
+ *
+ * defines the struct TEmvFields, with one TBerTlvSlice per object, and the extractor
+ * emv_extract(), which fills it in a single pass over the data with a switch on the tag.
+ *
+ * The class and the object type of each tag are checked against the tag encoding at compile time,
+ * so only the value size is checked at runtime.
+ */
+
+#ifndef __BER_TLV_SCHEMA_H
+#define __BER_TLV_SCHEMA_H
+
+#include <string.h>
+#include "ber_tlv.h"
+
+//! Maximum nesting level of the generated extractors, which keep one end offset per level in their walk
+#ifndef BER_TLV_SCHEMA_MAX_DEPTH
+#define BER_TLV_SCHEMA_MAX_DEPTH 256
+#endif
+
+/**
+ * @brief Value of an object found by an extractor
+ */
+typedef struct
+{
+    //! Pointer to the value field in the parsed data. NULL if the object was not found
+    uint8_t *data;
+    //! Size of value field in bytes
+    size_t size;
+} TBerTlvSlice;
+
+/**
+ * @brief Progress of an extractor over the parsed data
+ */
+typedef struct
+{
+    //! Parsed data
+    uint8_t *data;
+    //! Data size in bytes
+    size_t size;
+    //! Offset of the next object
+    size_t position;
+    //! End offset of each constructed object the next object is nested in
+    size_t endStack[BER_TLV_SCHEMA_MAX_DEPTH];
+    //! Nesting level of the next object
+    size_t depth;
+} TBerTlvSchemaWalk;
+
+//! First byte of a packed tag value
+#define BER_TLV_TAG_FIRST_BYTE(tag) \
+    ((uint8_t)((tag) > 0xFFFFFF ? (tag) >> 24 : (tag) > 0xFFFF ? (tag) >> 16 : (tag) > 0xFF ? (tag) >> 8 : (tag)))
+//! Class (EBerTlvClass) coded in a packed tag value
+#define BER_TLV_TAG_CLASS(tag) (BER_TLV_TAG_FIRST_BYTE(tag) >> 6)
+//! true if a packed tag value codes a constructed object
+#define BER_TLV_TAG_IS_CONSTRUCTED(tag) ((BER_TLV_TAG_FIRST_BYTE(tag) & 0x20) != 0)
+//! Number of bytes of a packed tag value
+#define BER_TLV_TAG_SIZE(tag) ((tag) > 0xFFFFFF ? 4 : (tag) > 0xFFFF ? 3 : (tag) > 0xFF ? 2 : 1)
+//! true if the first byte of a packed tag value announces subsequent bytes only when the tag has some, and
+//! bit b8 of the subsequent bytes is set in all but the last one
+#define BER_TLV_TAG_IS_WELL_FORMED(tag)                                             \
+    (((tag) > 0xFF) == ((BER_TLV_TAG_FIRST_BYTE(tag) & 0x1F) == 0x1F) &&            \
+     (BER_TLV_TAG_SIZE(tag) < 2 || ((tag) & 0x80) == 0) &&                          \
+     (BER_TLV_TAG_SIZE(tag) < 3 || ((tag) & 0x8000) != 0) &&                        \
+     (BER_TLV_TAG_SIZE(tag) < 4 || ((tag) & 0x800000) != 0))
+
+//! Schema entry expanded into a struct field
+#define BER_TLV_SCHEMA_FIELD(name, tag, tagClass, constructed, maxSize) TBerTlvSlice name;
+
+//! Schema entry expanded into the compile-time checks of its tag
+#define BER_TLV_SCHEMA_CHECK(name, tag, tagClass, constructed, maxSize)                                      \
+    _Static_assert(BER_TLV_TAG_IS_WELL_FORMED(tag), "Schema field " #name ": bad encoding of tag " #tag);      \
+    _Static_assert(BER_TLV_TAG_CLASS(tag) == (tagClass), "Schema field " #name ": tag " #tag " is not of class " \
+                                                         #tagClass);                                         \
+    _Static_assert(BER_TLV_TAG_IS_CONSTRUCTED(tag) == (constructed), "Schema field " #name ": wrong object "     \
+                                                                     "type of tag " #tag);
+
+//! Schema entry expanded into a case of the extractor switch. The first object with the tag is kept
+#define BER_TLV_SCHEMA_CASE(name, tag, tagClass, constructed, maxSize) \
+    case (tag):                                                          \
+        if (tlvObj.valueSize > (maxSize))                                \
+        {                                                                \
+            err = BER_TLV_ERR_SCHEMA_VIOLATION;                          \
+            break;                                                       \
+        }                                                                \
+        if (fieldsOut->name.data == NULL)                                \
+        {                                                                \
+            fieldsOut->name.data = tlvObj.value;                         \
+            fieldsOut->name.size = tlvObj.valueSize;                     \
+        }                                                                \
+        break;
+
+/**
+ * @brief Define the fields struct and the extractor of a schema.
+ *
+ * The extractor has the prototype
+ * EBerTlvError extractFn(uint8_t *data, size_t size, TFields *fieldsOut, size_t *errorOffset)
+ * and looks for the schema objects at any nesting level. Objects not in the schema are skipped.
+ * It returns BER_TLV_ERR_SCHEMA_VIOLATION if a schema object is longer than its maximum size, and
+ * BER_TLV_ERR_DEPTH_OVERFLOW beyond BER_TLV_SCHEMA_MAX_DEPTH nested constructed objects.
+ * On error, errorOffset (may be NULL) receives the offset of the object that caused it.
+ * @param schema X-macro listing the entries X(name, tag, tagClass, constructed, maxSize)
+ * @param TFields Name of the struct type to be defined
+ * @param extractFn Name of the extractor function to be defined
+ */
+#define BER_TLV_SCHEMA_DEFINE(schema, TFields, extractFn)                                                    \
+    typedef struct                                                                                           \
+    {                                                                                                        \
+        schema(BER_TLV_SCHEMA_FIELD)                                                                         \
+    } TFields;                                                                                               \
+    schema(BER_TLV_SCHEMA_CHECK)                                                                             \
+    static inline EBerTlvError extractFn(uint8_t *data, size_t size, TFields *fieldsOut, size_t *errorOffset) \
+    {                                                                                                        \
+        TBerTlvSchemaWalk walk;                                                                              \
+        TBerTlvObj tlvObj;                                                                                   \
+        EBerTlvError err;                                                                                    \
+                                                                                                             \
+        memset(fieldsOut, 0, sizeof(*fieldsOut));                                                            \
+        berTlv_schemaWalkInit(&walk, data, size);                                                            \
+        while ((err = berTlv_schemaWalkNext(&walk, &tlvObj)) == BER_TLV_OK && tlvObj.value)                  \
+        {                                                                                                    \
+            switch (tlvObj.tag)                                                                              \
+            {                                                                                                \
+                schema(BER_TLV_SCHEMA_CASE)                                                                  \
+            default:                                                                                         \
+                break;                                                                                       \
+            }                                                                                                \
+            if (err)                                                                                         \
+            {                                                                                                \
+                walk.position = tlvObj.value - walk.data - tlvObj.tagSize - tlvObj.lengthSize;               \
+                break;                                                                                       \
+            }                                                                                                \
+        }                                                                                                    \
+        if (err && errorOffset)                                                                              \
+            *errorOffset = walk.position;                                                                    \
+        return err;                                                                                          \
+    }
+
+/**
+ * @brief Start a walk over raw data, used by the generated extractors.
+ */
+static inline void berTlv_schemaWalkInit(TBerTlvSchemaWalk *walk, uint8_t *data, size_t size)
+{
+    walk->data = data;
+    walk->size = size;
+    walk->position = 0;
+    walk->depth = 0;
+}
+
+/**
+ * @brief Parse the next object of a walk, going into constructed objects.
+ *
+ * Garbage data is skipped between top-level records. Nested objects are checked against the end
+ * of their parent, as in berTlv_index().
+ * @param walk Walk started with berTlv_schemaWalkInit().
+ * @param tlvObjOut Next object. Its value is NULL at the end of the data.
+ * @return BER_TLV_OK, the error found in the data or BER_TLV_ERR_DEPTH_OVERFLOW beyond
+ * BER_TLV_SCHEMA_MAX_DEPTH nested constructed objects. walk->position is the offset of the object
+ * that caused the error.
+ */
+static inline EBerTlvError berTlv_schemaWalkNext(TBerTlvSchemaWalk *walk, TBerTlvObj *tlvObjOut)
+{
+    // Leave every constructed object that ends at the current position
+    while (walk->depth && walk->endStack[walk->depth - 1] == walk->position)
+    {
+        walk->depth--;
+    }
+
+    bool isNotInConstructedObject = (walk->depth == 0);
+    size_t limit = isNotInConstructedObject ? walk->size : walk->endStack[walk->depth - 1];
+    size_t remainingSize = limit - walk->position;
+
+    tlvObjOut->value = NULL;
+    if (remainingSize == 0)
+        return BER_TLV_OK;
+
+    EBerTlvError err = berTlv_parseRawData(walk->data + walk->position, &remainingSize, tlvObjOut,
+                                           isNotInConstructedObject);
+    // Garbage data was skipped, even on error
+    walk->position = limit - remainingSize;
+    if (err || remainingSize == 0)
+    {
+        tlvObjOut->value = NULL;
+        return err;
+    }
+
+    size_t headerSize = tlvObjOut->tagSize + tlvObjOut->lengthSize;
+    // Constructed objects are nested in the value, go on parsing from there
+    if (tlvObjOut->constructed)
+    {
+        if (walk->depth == BER_TLV_SCHEMA_MAX_DEPTH)
+        {
+            tlvObjOut->value = NULL;
+            return BER_TLV_ERR_DEPTH_OVERFLOW;
+        }
+        walk->endStack[walk->depth++] = walk->position + headerSize + tlvObjOut->valueSize;
+        walk->position += headerSize;
+    }
+    else
+    {
+        walk->position += headerSize + tlvObjOut->valueSize;
+    }
+    return BER_TLV_OK;
+}
+
+#endif
@@ -0,0 +1,286 @@
+/**
+ * @file
+ * @brief Struct of arrays index of BER-TLV data and vectorized tag scans
+ */
+
+#include "ber_tlv_soa.h"
+#include "ber_tlv_internal.h"
+
+//------------------------------------------------Static fuctions declaration----------------------------------------------------//
+static size_t __findTag(const uint32_t *tags, size_t count, uint32_t tag);
+static size_t __countTag(const uint32_t *tags, size_t count, uint32_t tag);
+static size_t __findTagScalar(const uint32_t *tags, size_t count, uint32_t tag);
+static size_t __countTagScalar(const uint32_t *tags, size_t count, uint32_t tag);
+#if defined(BER_TLV_SIMD_X86)
+static size_t __findTagSse2(const uint32_t *tags, size_t count, uint32_t tag);
+static size_t __findTagAvx2(const uint32_t *tags, size_t count, uint32_t tag);
+static size_t __countTagSse2(const uint32_t *tags, size_t count, uint32_t tag);
+static size_t __countTagAvx2(const uint32_t *tags, size_t count, uint32_t tag);
+#elif defined(BER_TLV_SIMD_NEON)
+static size_t __findTagNeon(const uint32_t *tags, size_t count, uint32_t tag);
+static size_t __countTagNeon(const uint32_t *tags, size_t count, uint32_t tag);
+#endif
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Public functions------------------------------------------------------//
+
+void berTlv_soaInit(TBerTlvSoaIndex *index, uint32_t *tags, uint32_t *offsets, uint32_t *lengths, uint16_t *depths,
+                    size_t capacity)
+{
+    index->data = NULL;
+    index->size = 0;
+    index->tags = tags;
+    index->offsets = offsets;
+    index->lengths = lengths;
+    index->depths = depths;
+    index->capacity = capacity;
+    index->count = 0;
+    index->errorOffset = 0;
+}
+
+EBerTlvError berTlv_soaIndex(uint8_t *data, size_t size, TBerTlvSoaIndex *index)
+{
+    TBerTlvWalker walker;
+    size_t endStack[BER_TLV_SOA_MAX_DEPTH];
+    TBerTlvObj tlvObj;
+    size_t depth;
+    EBerTlvError err;
+
+    index->data = data;
+    index->size = size;
+    index->count = 0;
+    index->errorOffset = 0;
+    if (size > UINT32_MAX)
+        return BER_TLV_ERR_INVALID_ARGUMENT;
+
+    berTlv_walkInit(&walker, data, size, endStack, BER_TLV_SOA_MAX_DEPTH);
+    while ((err = berTlv_walkNext(&walker, &tlvObj, &depth)) == BER_TLV_OK && tlvObj.value)
+    {
+        size_t offset = tlvObj.value - data - tlvObj.tagSize - tlvObj.lengthSize;
+
+        if (index->count == index->capacity)
+        {
+            index->errorOffset = offset;
+            return BER_TLV_ERR_NO_SPACE;
+        }
+        index->tags[index->count] = tlvObj.tag;
+        index->offsets[index->count] = (uint32_t)offset;
+        index->lengths[index->count] = (uint32_t)tlvObj.valueSize;
+        index->depths[index->count] = (uint16_t)depth;
+        index->count++;
+    }
+
+    if (err)
+        index->errorOffset = walker.errorOffset;
+    return err;
+}
+
+size_t berTlv_soaFind(const TBerTlvSoaIndex *index, uint32_t tag, size_t start)
+{
+    if (start >= index->count)
+        return BER_TLV_SOA_NOT_FOUND;
+
+    size_t found = start + __findTag(index->tags + start, index->count - start, tag);
+    return (found < index->count) ? found : BER_TLV_SOA_NOT_FOUND;
+}
+
+size_t berTlv_soaCount(const TBerTlvSoaIndex *index, uint32_t tag)
+{
+    return __countTag(index->tags, index->count, tag);
+}
+
+bool berTlv_soaGet(const TBerTlvSoaIndex *index, size_t entryIndex, TBerTlvObj *tlvObjOut)
+{
+    if (entryIndex >= index->count)
+        return false;
+
+    // The header was already checked against its enclosing object, it is valid up to the data end
+    size_t remainingSize = index->size - index->offsets[entryIndex];
+    berTlv_parseRawData(index->data + index->offsets[entryIndex], &remainingSize, tlvObjOut, false);
+    return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Ptivate functions------------------------------------------------------//
+
+/**
+ * @brief Position of the first tag equal to tag, count if there is none.
+ */
+static size_t __findTag(const uint32_t *tags, size_t count, uint32_t tag)
+{
+#if defined(BER_TLV_SIMD_X86)
+    if (count >= 8 && __builtin_cpu_supports("avx2"))
+        return __findTagAvx2(tags, count, tag);
+    return __findTagSse2(tags, count, tag);
+#elif defined(BER_TLV_SIMD_NEON)
+    return __findTagNeon(tags, count, tag);
+#else
+    return __findTagScalar(tags, count, tag);
+#endif
+}
+
+/**
+ * @brief Number of tags equal to tag.
+ */
+static size_t __countTag(const uint32_t *tags, size_t count, uint32_t tag)
+{
+#if defined(BER_TLV_SIMD_X86)
+    if (count >= 8 && __builtin_cpu_supports("avx2"))
+        return __countTagAvx2(tags, count, tag);
+    return __countTagSse2(tags, count, tag);
+#elif defined(BER_TLV_SIMD_NEON)
+    return __countTagNeon(tags, count, tag);
+#else
+    return __countTagScalar(tags, count, tag);
+#endif
+}
+
+/**
+ * @brief One tag at a time search, also used for the tail of vector implementations.
+ */
+static size_t __findTagScalar(const uint32_t *tags, size_t count, uint32_t tag)
+{
+    size_t i = 0;
+
+    while (i < count && tags[i] != tag)
+    {
+        ++i;
+    }
+    return i;
+}
+
+/**
+ * @brief One tag at a time count, also used for the tail of vector implementations.
+ */
+static size_t __countTagScalar(const uint32_t *tags, size_t count, uint32_t tag)
+{
+    size_t found = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        found += (tags[i] == tag);
+    }
+    return found;
+}
+
+#if defined(BER_TLV_SIMD_X86)
+/**
+ * @brief Tag search comparing 4 tags per step (SSE2, always available on x86-64).
+ */
+static size_t __findTagSse2(const uint32_t *tags, size_t count, uint32_t tag)
+{
+    const __m128i needle = _mm_set1_epi32((int)tag);
+    size_t i = 0;
+
+    while (count - i >= 4)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(tags + i));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(chunk, needle)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+        i += 4;
+    }
+    return i + __findTagScalar(tags + i, count - i, tag);
+}
+
+/**
+ * @brief Tag search comparing 8 tags per step (AVX2, checked at runtime).
+ */
+__attribute__((target("avx2"))) static size_t __findTagAvx2(const uint32_t *tags, size_t count, uint32_t tag)
+{
+    const __m256i needle = _mm256_set1_epi32((int)tag);
+    size_t i = 0;
+
+    while (count - i >= 8)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(tags + i));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(chunk, needle)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+        i += 8;
+    }
+    return i + __findTagSse2(tags + i, count - i, tag);
+}
+
+/**
+ * @brief Tag count comparing 4 tags per step (SSE2). Each lane counts at most count / 4 matches.
+ */
+static size_t __countTagSse2(const uint32_t *tags, size_t count, uint32_t tag)
+{
+    const __m128i needle = _mm_set1_epi32((int)tag);
+    __m128i counts = _mm_setzero_si128();
+    uint32_t lanes[4];
+    size_t i = 0;
+
+    while (count - i >= 4)
+    {
+        // Matching lanes are all ones, i.e. -1
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(tags + i));
+        counts = _mm_sub_epi32(counts, _mm_cmpeq_epi32(chunk, needle));
+        i += 4;
+    }
+    _mm_storeu_si128((__m128i *)lanes, counts);
+    return (size_t)lanes[0] + lanes[1] + lanes[2] + lanes[3] + __countTagScalar(tags + i, count - i, tag);
+}
+
+/**
+ * @brief Tag count comparing 8 tags per step (AVX2, checked at runtime).
+ */
+__attribute__((target("avx2"))) static size_t __countTagAvx2(const uint32_t *tags, size_t count, uint32_t tag)
+{
+    const __m256i needle = _mm256_set1_epi32((int)tag);
+    __m256i counts = _mm256_setzero_si256();
+    uint32_t lanes[8];
+    size_t found = 0;
+    size_t i = 0;
+
+    while (count - i >= 8)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(tags + i));
+        counts = _mm256_sub_epi32(counts, _mm256_cmpeq_epi32(chunk, needle));
+        i += 8;
+    }
+    _mm256_storeu_si256((__m256i *)lanes, counts);
+    for (int lane = 0; lane < 8; ++lane)
+    {
+        found += lanes[lane];
+    }
+    return found + __countTagScalar(tags + i, count - i, tag);
+}
+
+#elif defined(BER_TLV_SIMD_NEON)
+/**
+ * @brief Tag search comparing 4 tags per step (NEON).
+ */
+static size_t __findTagNeon(const uint32_t *tags, size_t count, uint32_t tag)
+{
+    const uint32x4_t needle = vdupq_n_u32(tag);
+    size_t i = 0;
+
+    while (count - i >= 4)
+    {
+        // A lane is all ones only if its tag matches
+        if (vmaxvq_u32(vceqq_u32(vld1q_u32(tags + i), needle)))
+            break;
+        i += 4;
+    }
+    return i + __findTagScalar(tags + i, count - i, tag);
+}
+
+/**
+ * @brief Tag count comparing 4 tags per step (NEON).
+ */
+static size_t __countTagNeon(const uint32_t *tags, size_t count, uint32_t tag)
+{
+    const uint32x4_t needle = vdupq_n_u32(tag);
+    uint32x4_t counts = vdupq_n_u32(0);
+    size_t i = 0;
+
+    while (count - i >= 4)
+    {
+        counts = vsubq_u32(counts, vceqq_u32(vld1q_u32(tags + i), needle));
+        i += 4;
+    }
+    return (size_t)vaddvq_u32(counts) + __countTagScalar(tags + i, count - i, tag);
+}
+#endif
@@ -0,0 +1,101 @@
+/**
+ * @file
+ * @brief Struct of arrays index of BER-TLV data, for scans of the tag column
+ */
+
+#ifndef __BER_TLV_SOA_H
+#define __BER_TLV_SOA_H
+
+#include "ber_tlv.h"
+
+//! Maximum nesting level of berTlv_soaIndex(), which keeps one end offset per level on the stack
+#ifndef BER_TLV_SOA_MAX_DEPTH
+#define BER_TLV_SOA_MAX_DEPTH 256
+#endif
+
+//! Returned by berTlv_soaFind() when no entry has the tag
+#define BER_TLV_SOA_NOT_FOUND SIZE_MAX
+
+/**
+ * @brief Flat index of all BER TLV objects of a raw data array, one caller supplied array per field
+ *
+ * Entries are stored in the order the objects appear in the data, as in a TBerTlvIndex. A tag scan
+ * only reads the tag column, 4 bytes per object instead of a whole TBerTlvIndexEntry. Offsets are
+ * 32 bits, so the indexed data is at most 4 GiB.
+ */
+typedef struct
+{
+    //! Indexed raw data
+    uint8_t *data;
+    //! Indexed data size in bytes
+    size_t size;
+    //! Tag column
+    uint32_t *tags;
+    //! Offset column, first tag byte of each object from the start of the indexed data
+    uint32_t *offsets;
+    //! Length column, value size of each object
+    uint32_t *lengths;
+    //! Depth column, nesting level of each object, 0 for top-level objects
+    uint16_t *depths;
+    //! Number of elements of each column
+    size_t capacity;
+    //! Number of entries filled by berTlv_soaIndex()
+    size_t count;
+    //! Offset of the object that caused the error returned by berTlv_soaIndex()
+    size_t errorOffset;
+} TBerTlvSoaIndex;
+
+/**
+ * @brief Initialize an index over caller supplied columns.
+ * @param index Index to be initialized.
+ * @param tags Tag column.
+ * @param offsets Offset column.
+ * @param lengths Length column.
+ * @param depths Depth column.
+ * @param capacity Number of elements of each column.
+ */
+BER_TLV_API void berTlv_soaInit(TBerTlvSoaIndex *index, uint32_t *tags, uint32_t *offsets, uint32_t *lengths,
+                                uint16_t *depths, size_t capacity);
+
+/**
+ * @brief Parse a whole raw data array into the columns of the index in a single pass.
+ *
+ * The objects are the ones of berTlv_index(). Garbage data is skipped only between top-level
+ * objects.
+ * @param data Raw data pointer
+ * @param size Data size in bytes, at most UINT32_MAX.
+ * @param index Index initialized with berTlv_soaInit().
+ * @return BER_TLV_OK, the error that happened during the data parsing, BER_TLV_ERR_NO_SPACE if the
+ * columns are full, BER_TLV_ERR_DEPTH_OVERFLOW beyond BER_TLV_SOA_MAX_DEPTH nested constructed objects
+ * or BER_TLV_ERR_INVALID_ARGUMENT if the data is too large. On error errorOffset is set and the
+ * entries parsed before the error are kept in the index.
+ */
+BER_TLV_API EBerTlvError berTlv_soaIndex(uint8_t *data, size_t size, TBerTlvSoaIndex *index);
+
+/**
+ * @brief Find the next entry with a tag, comparing several tags per instruction.
+ * @param index Index filled by berTlv_soaIndex().
+ * @param tag Tag to be found, e.g. 0x9F02.
+ * @param start First entry searched, 0 or the previous result + 1 to find the next duplicate.
+ * @return Entry index or BER_TLV_SOA_NOT_FOUND.
+ */
+BER_TLV_API size_t berTlv_soaFind(const TBerTlvSoaIndex *index, uint32_t tag, size_t start);
+
+/**
+ * @brief Count the entries with a tag, comparing several tags per instruction.
+ * @param index Index filled by berTlv_soaIndex().
+ * @param tag Tag to be counted.
+ * @return Number of entries with the tag.
+ */
+BER_TLV_API size_t berTlv_soaCount(const TBerTlvSoaIndex *index, uint32_t tag);
+
+/**
+ * @brief Get the object of an entry, decoded again from its header.
+ * @param index Index filled by berTlv_soaIndex().
+ * @param entryIndex Entry index, below index->count.
+ * @param tlvObjOut Pointer to the tlv object that will be filled.
+ * @return true if the object was filled, false if entryIndex is out of range.
+ */
+BER_TLV_API bool berTlv_soaGet(const TBerTlvSoaIndex *index, size_t entryIndex, TBerTlvObj *tlvObjOut);
+
+#endif
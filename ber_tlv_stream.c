@@ -0,0 +1,276 @@
+/**
+ * @file
+ * @brief Incremental BER-TLV parser for data received in chunks
+ */
+
+#include "ber_tlv_stream.h"
+#include "ber_tlv_internal.h"
+
+#include <string.h>
+
+//! Parser states
+enum
+{
+    //! Waiting for the first tag byte (garbage data is skipped at top-level)
+    STREAM_TAG_FIRST,
+    //! Waiting for a subsequent tag byte
+    STREAM_TAG_NEXT,
+    //! Waiting for the first length byte
+    STREAM_LENGTH_FIRST,
+    //! Waiting for the subsequent length bytes
+    STREAM_LENGTH_NEXT,
+    //! Receiving the value of a primitive object
+    STREAM_VALUE
+};
+
+//! Mask to extract the object type value from the first byte of the tag field
+static const uint8_t TAG_OBJ_TYPE_MASK = 0x20;
+
+//------------------------------------------------Static fuctions declaration----------------------------------------------------//
+static EBerTlvError __onHeaderComplete(TBerTlvStream *stream);
+static EBerTlvError __onPrimitiveComplete(TBerTlvStream *stream);
+static EBerTlvError __closeCompleteLevels(TBerTlvStream *stream);
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Public functions------------------------------------------------------//
+
+void berTlv_streamInit(TBerTlvStream *stream, TBerTlvStreamLevel *stack, size_t stackCapacity, uint8_t *valueBuffer,
+                       size_t valueBufferCapacity, TBerTlvStreamObjFn onObject, void *userData)
+{
+    stream->onObject = onObject;
+    stream->userData = userData;
+    stream->stack = stack;
+    stream->stackCapacity = stackCapacity;
+    stream->valueBuffer = valueBuffer;
+    stream->valueBufferCapacity = valueBufferCapacity;
+    berTlv_streamReset(stream);
+}
+
+void berTlv_streamReset(TBerTlvStream *stream)
+{
+    stream->depth = 0;
+    stream->valueReceived = 0;
+    stream->pendingLengthBytes = 0;
+    stream->state = STREAM_TAG_FIRST;
+    stream->error = BER_TLV_OK;
+    stream->position = 0;
+    stream->objOffset = 0;
+    stream->errorOffset = 0;
+}
+
+EBerTlvError berTlv_streamFeed(TBerTlvStream *stream, uint8_t *data, size_t size)
+{
+    TBerTlvObj *obj = &stream->obj;
+    uint8_t *chunk = data;
+
+    while (size && !stream->error)
+    {
+        switch (stream->state)
+        {
+        case STREAM_TAG_FIRST:
+            if (stream->depth == 0)
+            {
+                while (size && (*data == 0x00 || *data == 0xFF))
+                {
+                    data++;
+                    size--;
+                }
+                if (size == 0)
+                    break;
+            }
+            stream->objOffset = stream->position + (data - chunk);
+            obj->tagClass = *data >> TAG_CLASS_BIT_POS;
+            obj->constructed = (*data & TAG_OBJ_TYPE_MASK) != 0;
+            obj->tagSize = 1;
+            stream->state = ((*data & MULTIPLE_BYTES_TAG_MASK) == MULTIPLE_BYTES_TAG_MASK) ? STREAM_TAG_NEXT : STREAM_LENGTH_FIRST;
+            obj->tag = *data++;
+            size--;
+            break;
+
+        case STREAM_TAG_NEXT:
+            if (obj->tagSize == MAX_TAG_SIZE)
+            {
+                stream->error = BER_TLV_ERR_TAG_TOO_LONG;
+                break;
+            }
+            obj->tag = (obj->tag << 8) | *data;
+            obj->tagSize++;
+            stream->state = (*data & SUBSEQUENT_TAG_BYTE_MASK) ? STREAM_TAG_NEXT : STREAM_LENGTH_FIRST;
+            data++;
+            size--;
+            break;
+
+        case STREAM_LENGTH_FIRST:
+        {
+            uint8_t lengthByte = *data++;
+            size--;
+            obj->lengthValue = lengthByte;
+            if (lengthByte & MULTPLES_BYTES_LENGTH_MASK)
+            {
+                stream->pendingLengthBytes = lengthByte & ~MULTPLES_BYTES_LENGTH_MASK;
+                // The indefinite form (0x80) is not allowed in BER-TLV data objects
+                if (stream->pendingLengthBytes == 0 || stream->pendingLengthBytes > MAX_SUBSEQUENT_LENGTH_BYTES)
+                {
+                    stream->error = BER_TLV_ERR_BAD_LENGTH_FORM;
+                    break;
+                }
+                obj->lengthSize = stream->pendingLengthBytes + 1;
+                obj->valueSize = 0;
+                stream->state = STREAM_LENGTH_NEXT;
+            }
+            else
+            {
+                obj->lengthSize = 1;
+                obj->valueSize = lengthByte;
+                stream->error = __onHeaderComplete(stream);
+            }
+            break;
+        }
+
+        case STREAM_LENGTH_NEXT:
+            obj->lengthValue = (obj->lengthValue << 8) | *data;
+            obj->valueSize = (obj->valueSize << 8) | *data;
+            data++;
+            size--;
+            if (--stream->pendingLengthBytes == 0)
+                stream->error = __onHeaderComplete(stream);
+            break;
+
+        case STREAM_VALUE:
+        {
+            size_t missingSize = obj->valueSize - stream->valueReceived;
+
+            if (stream->valueReceived == 0 && size >= missingSize)
+            {
+                // Whole value in this chunk, no copy
+                obj->value = data;
+                data += missingSize;
+                size -= missingSize;
+                stream->error = __onPrimitiveComplete(stream);
+                break;
+            }
+
+            if (obj->valueSize > stream->valueBufferCapacity)
+            {
+                stream->error = BER_TLV_ERR_NO_SPACE;
+                break;
+            }
+
+            size_t chunkSize = size < missingSize ? size : missingSize;
+            memcpy(stream->valueBuffer + stream->valueReceived, data, chunkSize);
+            stream->valueReceived += chunkSize;
+            data += chunkSize;
+            size -= chunkSize;
+            if (stream->valueReceived == obj->valueSize)
+            {
+                obj->value = stream->valueBuffer;
+                stream->error = __onPrimitiveComplete(stream);
+            }
+            break;
+        }
+        }
+    }
+
+    stream->position += data - chunk;
+    if (stream->error)
+        stream->errorOffset = stream->objOffset;
+    return stream->error;
+}
+
+EBerTlvError berTlv_streamFinish(TBerTlvStream *stream)
+{
+    if (stream->error)
+        return stream->error;
+
+    switch (stream->state)
+    {
+    case STREAM_TAG_FIRST:
+        if (stream->depth == 0)
+            return BER_TLV_OK;
+        // The last constructed object is not complete
+        stream->errorOffset = stream->stack[stream->depth - 1].offset;
+        return BER_TLV_ERR_TRUNCATED_VALUE;
+    case STREAM_VALUE:
+        stream->errorOffset = stream->objOffset;
+        return BER_TLV_ERR_TRUNCATED_VALUE;
+    default:
+        stream->errorOffset = stream->objOffset;
+        return BER_TLV_ERR_TRUNCATED_HEADER;
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Ptivate functions------------------------------------------------------//
+
+/**
+ * @brief Account for a complete header in the enclosing object and start the object value.
+ * @return BER_TLV_OK or the error that happened.
+ */
+static EBerTlvError __onHeaderComplete(TBerTlvStream *stream)
+{
+    TBerTlvObj *obj = &stream->obj;
+    size_t fullObjSize = obj->tagSize + obj->lengthSize + obj->valueSize;
+
+    if (stream->depth)
+    {
+        size_t *parentRemainingSize = &stream->stack[stream->depth - 1].remainingSize;
+        // The object must fit in its enclosing constructed object
+        if (fullObjSize > *parentRemainingSize)
+            return BER_TLV_ERR_TRUNCATED_VALUE;
+        *parentRemainingSize -= fullObjSize;
+    }
+
+    if (obj->constructed)
+    {
+        if (stream->depth == stream->stackCapacity)
+            return BER_TLV_ERR_DEPTH_OVERFLOW;
+        obj->value = NULL;
+        if (stream->onObject(stream->userData, BER_TLV_STREAM_CONSTRUCTED_BEGIN, obj, stream->depth))
+            return BER_TLV_ERR_INTERRUPTED;
+        stream->stack[stream->depth].obj = *obj;
+        stream->stack[stream->depth].offset = stream->objOffset;
+        stream->stack[stream->depth].remainingSize = obj->valueSize;
+        stream->depth++;
+        stream->state = STREAM_TAG_FIRST;
+        // An empty constructed object is complete right away
+        return __closeCompleteLevels(stream);
+    }
+
+    if (obj->valueSize == 0)
+    {
+        obj->value = NULL;
+        return __onPrimitiveComplete(stream);
+    }
+    stream->valueReceived = 0;
+    stream->state = STREAM_VALUE;
+    return BER_TLV_OK;
+}
+
+/**
+ * @brief Report a complete primitive object and close every constructed object that ended with it.
+ * @return BER_TLV_ERR_INTERRUPTED if the callback interrupted the parsing.
+ */
+static EBerTlvError __onPrimitiveComplete(TBerTlvStream *stream)
+{
+    stream->state = STREAM_TAG_FIRST;
+    stream->valueReceived = 0;
+    if (stream->onObject(stream->userData, BER_TLV_STREAM_PRIMITIVE, &stream->obj, stream->depth))
+        return BER_TLV_ERR_INTERRUPTED;
+    return __closeCompleteLevels(stream);
+}
+
+/**
+ * @brief Report the end of every open constructed object whose value was completely received.
+ * @return BER_TLV_ERR_INTERRUPTED if the callback interrupted the parsing.
+ */
+static EBerTlvError __closeCompleteLevels(TBerTlvStream *stream)
+{
+    while (stream->depth && stream->stack[stream->depth - 1].remainingSize == 0)
+    {
+        stream->depth--;
+        TBerTlvStreamLevel *level = &stream->stack[stream->depth];
+        if (stream->onObject(stream->userData, BER_TLV_STREAM_CONSTRUCTED_END, &level->obj, stream->depth))
+            return BER_TLV_ERR_INTERRUPTED;
+    }
+    return BER_TLV_OK;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file
+ * @brief Incremental BER-TLV parser for data received in chunks
+ */
+
+#ifndef __BER_TLV_STREAM_H
+#define __BER_TLV_STREAM_H
+
+#include "ber_tlv.h"
+
+/**
+ * @brief Events reported by the stream parser
+ */
+typedef enum
+{
+    //! A primitive object was completely received
+    BER_TLV_STREAM_PRIMITIVE,
+    //! The header of a constructed object was received, its children follow
+    BER_TLV_STREAM_CONSTRUCTED_BEGIN,
+    //! The last child of a constructed object was received
+    BER_TLV_STREAM_CONSTRUCTED_END
+} EBerTlvStreamEvent;
+
+/**
+ * @brief Object callback of the stream parser.
+ * @param userData User data given to berTlv_streamInit().
+ * @param event Parsing event.
+ * @param tlvObj Parsed object. The value of constructed objects is NULL. The value of primitive
+ * objects is only valid during the callback. BER_TLV_STREAM_CONSTRUCTED_END gives the header of the
+ * constructed object that ended.
+ * @param depth Nesting level of the object, 0 for top-level objects.
+ * @return true to interrupt the parsing.
+ */
+typedef bool (*TBerTlvStreamObjFn)(void *userData, EBerTlvStreamEvent event, const TBerTlvObj *tlvObj, size_t depth);
+
+/**
+ * @brief Open constructed object of the stream parser
+ */
+typedef struct
+{
+    //! Header of the constructed object
+    TBerTlvObj obj;
+    //! Value bytes of the object not received yet
+    size_t remainingSize;
+    //! Stream offset of the object
+    size_t offset;
+} TBerTlvStreamLevel;
+
+/**
+ * @brief State of the stream parser between two berTlv_streamFeed() calls
+ */
+typedef struct
+{
+    //! Object callback
+    TBerTlvStreamObjFn onObject;
+    //! User data given to the object callback
+    void *userData;
+    //! Open constructed objects, from top-level to the innermost one
+    TBerTlvStreamLevel *stack;
+    //! Number of elements of the stack, which is the maximum nesting level
+    size_t stackCapacity;
+    //! Number of open constructed objects
+    size_t depth;
+    //! Buffer used to join primitive values split between two chunks
+    uint8_t *valueBuffer;
+    //! Size of the value buffer in bytes
+    size_t valueBufferCapacity;
+    //! Value bytes of the current object already received
+    size_t valueReceived;
+    //! Object being received
+    TBerTlvObj obj;
+    //! Length bytes still expected
+    uint8_t pendingLengthBytes;
+    //! Current parser state
+    uint8_t state;
+    //! Total bytes fed since the last reset
+    size_t position;
+    //! Stream offset of the object being received
+    size_t objOffset;
+    //! Error that stopped the parsing, BER_TLV_OK while the stream can be fed
+    EBerTlvError error;
+    //! Stream offset of the object that caused the error
+    size_t errorOffset;
+} TBerTlvStream;
+
+/**
+ * @brief Initialize a stream parser.
+ * @param stream Stream parser to be initialized.
+ * @param stack Caller supplied nesting stack, one element per nesting level.
+ * @param stackCapacity Number of elements of the nesting stack.
+ * @param valueBuffer Buffer used to join primitive values split between chunks. Values that are
+ * received in a single chunk are never copied.
+ * @param valueBufferCapacity Size of the value buffer, which is the maximum size of a split value.
+ * @param onObject Object callback.
+ * @param userData User data given to the object callback.
+ */
+BER_TLV_API void berTlv_streamInit(TBerTlvStream *stream, TBerTlvStreamLevel *stack, size_t stackCapacity,
+                                   uint8_t *valueBuffer, size_t valueBufferCapacity, TBerTlvStreamObjFn onObject,
+                                   void *userData);
+
+/**
+ * @brief Parse the next chunk of data.
+ * 
+ * Objects are reported as soon as they are complete. Partial tags, lengths and values are kept 
+ * until the next call. Garbage data is skipped between top-level objects.
+ * @param stream Stream parser.
+ * @param data Chunk pointer.
+ * @param size Chunk size in bytes.
+ * @return BER_TLV_OK or the error that happened, errorOffset is set in this case. The stream 
+ * must be reset before being fed again.
+ */
+BER_TLV_API EBerTlvError berTlv_streamFeed(TBerTlvStream *stream, uint8_t *data, size_t size);
+
+/**
+ * @brief Check that the stream ended between two top-level objects.
+ * @return The stream error, BER_TLV_ERR_TRUNCATED_HEADER or BER_TLV_ERR_TRUNCATED_VALUE if it
+ * stopped in the middle of an object, BER_TLV_OK otherwise.
+ */
+BER_TLV_API EBerTlvError berTlv_streamFinish(TBerTlvStream *stream);
+
+/**
+ * @brief Drop any partial object and error, so a new stream can be parsed.
+ */
+BER_TLV_API void berTlv_streamReset(TBerTlvStream *stream);
+
+#endif
@@ -0,0 +1,1481 @@
+/**
+ * @file
+ * @brief Fuzz harness, corpus generator and differential checks of the BER TLV lib
+ *
+ * Every input is parsed by a reference decoder, written with berTlv_parseRawData() only, and by
+ * each engine of the lib. Any difference, or any sanitizer report, aborts the run.
+ *
+ * Built with -DBER_TLV_FUZZ_LIBFUZZER only LLVMFuzzerTestOneInput() is defined, for libFuzzer.
+ * Otherwise a driver is added:
+ *   ber_tlv_fuzz gen <directory> [count] [seed]  write a structured corpus
+ *   ber_tlv_fuzz diff [count] [seed]             check generated inputs in memory
+ *   ber_tlv_fuzz check                           run the regression cases
+ *   ber_tlv_fuzz <file>...                       check files, e.g. from AFL with @@
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ber_tlv.h"
+#include "ber_tlv_stream.h"
+#include "ber_tlv_batch.h"
+#include "ber_tlv_builder.h"
+#include "ber_tlv_patch.h"
+#include "ber_tlv_soa.h"
+#include "ber_tlv_cache.h"
+#include "ber_tlv_extract.h"
+#include "ber_tlv_arena.h"
+#include "ber_tlv_file.h"
+#include "ber_tlv_pipeline.h"
+#include "ber_tlv_schema.h"
+
+//! Largest checked input, the reference decoder recurses once per nesting level
+#define FUZZ_MAX_INPUT_SIZE 4096
+//! Largest generated input
+#define FUZZ_MAX_GENERATED_SIZE 2048
+//! Default number of generated inputs
+#define FUZZ_DEFAULT_COUNT 10000
+//! Maximum nesting level of the generated objects
+#define FUZZ_MAX_GENERATED_DEPTH 12
+//! Entries of the cache kept between inputs, few so that they are evicted
+#define FUZZ_CACHE_ENTRY_COUNT 16
+//! Memory budget of the cache kept between inputs
+#define FUZZ_CACHE_BUDGET 8192
+//! Block size of the growable arenas, small so that the allocations span several blocks
+#define FUZZ_ARENA_BLOCK_SIZE 256
+//! Size of the file read by the pipeline
+#define FUZZ_PIPELINE_FILE_SIZE (256 * 1024)
+//! Size of the pipeline buffers, the generated records are split between reads
+#define FUZZ_PIPELINE_BUFFER_SIZE 4096
+//! Number of pipeline buffers, 2 of them are the stitch buffers of the file
+#define FUZZ_PIPELINE_BUFFER_COUNT 8
+
+//! Abort with the input offset and the engine that differs from the reference
+#define FUZZ_CHECK(cond, engine, format, args...)                                      \
+    if (!(cond))                                                                       \
+    {                                                                                  \
+        fprintf(stderr, "%s differs from the reference: " format "\n", engine, ##args); \
+        abort();                                                                       \
+    }
+
+/**
+ * @brief Object found by a decoder
+ */
+typedef struct
+{
+    //! Offset of the first tag byte
+    size_t offset;
+    //! Parsed header, its value points into the input
+    TBerTlvObj obj;
+    //! Nesting level
+    size_t depth;
+} TFuzzObj;
+
+/**
+ * @brief Objects found by a decoder, in the order they appear in the data
+ */
+typedef struct
+{
+    //! Objects
+    TFuzzObj *objs;
+    //! Number of objects
+    size_t count;
+    //! Error that stopped the decoding
+    EBerTlvError error;
+    //! Offset of the object that caused the error
+    size_t errorOffset;
+} TFuzzResult;
+
+/**
+ * @brief State of the stream engine callback
+ */
+typedef struct
+{
+    //! Stream, for the object offsets
+    TBerTlvStream *stream;
+    //! Objects received
+    TFuzzResult *result;
+    //! Input fed to the stream
+    const uint8_t *data;
+} TFuzzStreamState;
+
+/**
+ * @brief Objects received by the pipeline callback, from any worker
+ */
+typedef struct
+{
+    //! Objects, with their stream offset
+    TFuzzObj *objs;
+    //! Number of objects
+    size_t count;
+    //! Capacity of objs
+    size_t capacity;
+    //! Chunks indexed with an error
+    size_t errorCount;
+} TFuzzPipelineState;
+
+//! Schema of the regression cases, a primitive in a constructed object
+#define FUZZ_SCHEMA(X)                                       \
+    X(pan, 0x5A, BER_TLV_CLASS_APPLICATION, false, 10)       \
+    X(container, 0xE1, BER_TLV_CLASS_PRIVATE, true, 255)
+
+BER_TLV_SCHEMA_DEFINE(FUZZ_SCHEMA, TFuzzSchemaFields, __fuzzSchemaExtract)
+
+#ifndef BER_TLV_FUZZ_LIBFUZZER
+//! State of the random generator
+static uint64_t randomState = 0x9E3779B97F4A7C15ULL;
+#endif
+//! Cache kept between inputs, with its entries and buckets
+static TBerTlvCache cache;
+static TBerTlvCacheEntry cacheEntries[FUZZ_CACHE_ENTRY_COUNT];
+static size_t cacheBuckets[FUZZ_CACHE_ENTRY_COUNT / 2];
+//! Temporary file the inputs are written to, opened by path through /dev/fd
+static FILE *inputFile;
+
+//------------------------------------------------Static fuctions declaration----------------------------------------------------//
+static void __reference(uint8_t *data, size_t size, TFuzzResult *result);
+static EBerTlvError __referenceLevel(uint8_t *data, size_t base, size_t size, size_t depth, TFuzzResult *result);
+static void __addObj(TFuzzResult *result, size_t offset, const TBerTlvObj *obj, size_t depth);
+static void __compareObj(const char *engine, const TFuzzObj *ref, size_t offset, const TBerTlvObj *obj, size_t depth);
+static void __checkIndex(uint8_t *data, size_t size, const TFuzzResult *ref);
+static void __checkValidate(uint8_t *data, size_t size, const TFuzzResult *ref);
+static void __checkBatch(uint8_t *data, size_t size, const TFuzzResult *ref);
+static void __checkSoa(uint8_t *data, size_t size, const TFuzzResult *ref);
+static void __checkWalker(uint8_t *data, size_t size, const TFuzzResult *ref);
+static void __checkIter(uint8_t *data, size_t size, const TFuzzResult *ref);
+static void __checkCtx(uint8_t *data, size_t size, const TFuzzResult *ref);
+static void __checkStream(uint8_t *data, size_t size, const TFuzzResult *ref);
+static bool __onStreamObject(void *userData, EBerTlvStreamEvent event, const TBerTlvObj *tlvObj, size_t depth);
+static void __checkPrint(uint8_t *data, size_t size);
+static void __checkCache(uint8_t *data, size_t size, const TFuzzResult *ref);
+static void __checkExtract(uint8_t *data, size_t size, const TFuzzResult *ref);
+static void __checkArena(uint8_t *data, size_t size, const TFuzzResult *ref);
+static void __checkFile(uint8_t *data, size_t size, const TFuzzResult *ref);
+static void __checkSchemaWalk(uint8_t *data, size_t size, const TFuzzResult *ref);
+static void __checkBuilder(uint8_t *data, size_t size, const TFuzzResult *ref);
+static void __checkPatch(uint8_t *data, size_t size, const TFuzzResult *ref);
+static void __checkInput(const uint8_t *input, size_t size);
+// Regression cases and corpus generation of the standalone driver
+#ifndef BER_TLV_FUZZ_LIBFUZZER
+static void __regressions(void);
+static void __regressionArenaPrint(void);
+static void __regressionFileOpen(void);
+static void __regressionPipeline(void);
+static void __regressionSchema(void);
+static void __regressionCacheOffset(void);
+static void __regressionBatchShares(void);
+static void __regressionBuilderTags(void);
+static bool __onPipelineIndex(void *userData, size_t source, size_t streamOffset, EBerTlvError error,
+                              const TBerTlvIndex *index);
+static int __compareOffset(const void *a, const void *b);
+static uint32_t __random(uint32_t max);
+static size_t __genObjects(uint8_t *buf, size_t capacity, size_t depth);
+static size_t __genInput(uint8_t *buf, size_t capacity);
+#endif
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Entry points----------------------------------------------------------//
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    __checkInput(data, size);
+    return 0;
+}
+
+#ifndef BER_TLV_FUZZ_LIBFUZZER
+int main(int argc, char **argv)
+{
+    static uint8_t buf[FUZZ_MAX_INPUT_SIZE];
+
+    if (argc > 1 && !strcmp(argv[1], "gen") && argc > 2)
+    {
+        long count = argc > 3 ? atol(argv[3]) : FUZZ_DEFAULT_COUNT;
+        randomState ^= argc > 4 ? strtoull(argv[4], NULL, 0) : 0;
+        for (long i = 0; i < count; ++i)
+        {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/input_%06ld.ber", argv[2], i);
+            FILE *file = fopen(path, "wb");
+            if (file == NULL)
+            {
+                perror(path);
+                return 1;
+            }
+            size_t size = __genInput(buf, FUZZ_MAX_GENERATED_SIZE);
+            fwrite(buf, 1, size, file);
+            fclose(file);
+        }
+        return 0;
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "diff"))
+    {
+        long count = argc > 2 ? atol(argv[2]) : FUZZ_DEFAULT_COUNT;
+        randomState ^= argc > 3 ? strtoull(argv[3], NULL, 0) : 0;
+        for (long i = 0; i < count; ++i)
+        {
+            __checkInput(buf, __genInput(buf, FUZZ_MAX_GENERATED_SIZE));
+        }
+        printf("%ld generated inputs checked\n", count);
+        return 0;
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "check"))
+    {
+        __regressions();
+        printf("regression cases checked\n");
+        return 0;
+    }
+
+    if (argc < 2)
+    {
+        printf("Usage: %s gen <directory> [count] [seed] | diff [count] [seed] | check | <file>...\n", argv[0]);
+        return 1;
+    }
+    for (int i = 1; i < argc; ++i)
+    {
+        FILE *file = fopen(argv[i], "rb");
+        if (file == NULL)
+        {
+            perror(argv[i]);
+            return 1;
+        }
+        size_t size = fread(buf, 1, sizeof(buf), file);
+        fclose(file);
+        __checkInput(buf, size);
+    }
+    return 0;
+}
+#endif
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Differential checks---------------------------------------------------//
+
+/**
+ * @brief Run every engine over one input and compare it with the reference.
+ */
+static void __checkInput(const uint8_t *input, size_t size)
+{
+    if (size > FUZZ_MAX_INPUT_SIZE)
+        size = FUZZ_MAX_INPUT_SIZE;
+
+    // Own copy, the engines take non-const data and the patch check modifies it
+    uint8_t *data = malloc(size ? size : 1);
+    memcpy(data, input, size);
+
+    // Each object takes at least 2 bytes
+    TFuzzResult ref = {malloc((size / 2 + 1) * sizeof(TFuzzObj)), 0, BER_TLV_OK, 0};
+    __reference(data, size, &ref);
+
+    __checkIndex(data, size, &ref);
+    __checkValidate(data, size, &ref);
+    __checkBatch(data, size, &ref);
+    __checkSoa(data, size, &ref);
+    __checkWalker(data, size, &ref);
+    __checkIter(data, size, &ref);
+    __checkCtx(data, size, &ref);
+    __checkStream(data, size, &ref);
+    __checkPrint(data, size);
+    __checkCache(data, size, &ref);
+    __checkExtract(data, size, &ref);
+    __checkArena(data, size, &ref);
+    __checkFile(data, size, &ref);
+    __checkSchemaWalk(data, size, &ref);
+    if (ref.error == BER_TLV_OK)
+    {
+        __checkBuilder(data, size, &ref);
+        __checkPatch(data, size, &ref);
+    }
+
+    free(ref.objs);
+    free(data);
+}
+
+/**
+ * @brief Reference decoder, a plain recursion over berTlv_parseRawData().
+ */
+static void __reference(uint8_t *data, size_t size, TFuzzResult *result)
+{
+    result->count = 0;
+    result->errorOffset = 0;
+    result->error = __referenceLevel(data, 0, size, 0, result);
+}
+
+static EBerTlvError __referenceLevel(uint8_t *data, size_t base, size_t size, size_t depth, TFuzzResult *result)
+{
+    size_t pos = 0;
+
+    while (pos < size)
+    {
+        TBerTlvObj obj;
+        size_t remainingSize = size - pos;
+        EBerTlvError err = berTlv_parseRawData(data + base + pos, &remainingSize, &obj, depth == 0);
+
+        pos = size - remainingSize;
+        if (err)
+        {
+            result->errorOffset = base + pos;
+            return err;
+        }
+        if (remainingSize == 0)
+            break;
+
+        __addObj(result, base + pos, &obj, depth);
+        size_t headerSize = obj.tagSize + obj.lengthSize;
+        if (obj.constructed)
+        {
+            err = __referenceLevel(data, base + pos + headerSize, obj.valueSize, depth + 1, result);
+            if (err)
+                return err;
+        }
+        pos += headerSize + obj.valueSize;
+    }
+    return BER_TLV_OK;
+}
+
+static void __addObj(TFuzzResult *result, size_t offset, const TBerTlvObj *obj, size_t depth)
+{
+    TFuzzObj *fuzzObj = &result->objs[result->count++];
+
+    fuzzObj->offset = offset;
+    fuzzObj->obj = *obj;
+    fuzzObj->depth = depth;
+}
+
+static void __compareObj(const char *engine, const TFuzzObj *ref, size_t offset, const TBerTlvObj *obj, size_t depth)
+{
+    FUZZ_CHECK(offset == ref->offset, engine, "object at %zu, expected at %zu", offset, ref->offset);
+    FUZZ_CHECK(obj->tag == ref->obj.tag && obj->tagSize == ref->obj.tagSize, engine, "tag 0x%X at %zu", obj->tag,
+               offset);
+    FUZZ_CHECK(obj->tagClass == ref->obj.tagClass && obj->constructed == ref->obj.constructed, engine,
+               "tag class or type at %zu", offset);
+    FUZZ_CHECK(obj->lengthSize == ref->obj.lengthSize && obj->lengthValue == ref->obj.lengthValue, engine,
+               "length field at %zu", offset);
+    FUZZ_CHECK(obj->valueSize == ref->obj.valueSize, engine, "value size %zu at %zu", obj->valueSize, offset);
+    FUZZ_CHECK(depth == ref->depth, engine, "depth %zu at %zu", depth, offset);
+}
+
+static void __checkIndex(uint8_t *data, size_t size, const TFuzzResult *ref)
+{
+    TBerTlvIndex index;
+    size_t tagTable[64];
+
+    berTlv_indexInit(&index, malloc((size / 2 + 1) * sizeof(TBerTlvIndexEntry)), size / 2 + 1);
+    berTlv_indexSetTagTable(&index, tagTable, 64);
+    EBerTlvError err = berTlv_index(data, size, &index);
+
+    // A full tag table is not an error of the reference
+    if (err != BER_TLV_ERR_NO_SPACE)
+    {
+        FUZZ_CHECK(err == ref->error, "index", "error %d, expected %d", err, ref->error);
+        FUZZ_CHECK(!err || index.errorOffset == ref->errorOffset, "index", "error at %zu", index.errorOffset);
+        FUZZ_CHECK(index.count == ref->count, "index", "%zu objects, expected %zu", index.count, ref->count);
+    }
+    for (size_t i = 0; i < index.count; ++i)
+    {
+        const TBerTlvIndexEntry *entry = &index.entries[i];
+        __compareObj("index", &ref->objs[i], entry->offset, &entry->obj, entry->depth);
+        FUZZ_CHECK(entry->obj.value == data + entry->valueOffset, "index", "value pointer at %zu", entry->offset);
+
+        TBerTlvObj found;
+        FUZZ_CHECK(err || berTlv_find(&index, entry->obj.tag, &found), "index", "tag 0x%X not found", entry->obj.tag);
+    }
+    free(index.entries);
+}
+
+static void __checkValidate(uint8_t *data, size_t size, const TFuzzResult *ref)
+{
+    size_t errorOffset;
+    EBerTlvError err = berTlv_validate(data, size, &errorOffset);
+
+    // Deeper nesting than the validator stack is reported as an overflow
+    if (err == BER_TLV_ERR_DEPTH_OVERFLOW)
+        return;
+    FUZZ_CHECK(err == ref->error, "validate", "error %d, expected %d", err, ref->error);
+    FUZZ_CHECK(!err || errorOffset == ref->errorOffset, "validate", "error at %zu, expected %zu", errorOffset,
+               ref->errorOffset);
+}
+
+static void __checkBatch(uint8_t *data, size_t size, const TFuzzResult *ref)
+{
+    TBerTlvIndex index;
+    unsigned threadCount = 1 + (size ? data[size / 2] % 4 : 0);
+
+    // The documented bound, exactly
+    berTlv_indexInit(&index, malloc((size / 2 + 1) * sizeof(TBerTlvIndexEntry)), size / 2);
+    EBerTlvError err = berTlv_batchIndex(data, size, &index, threadCount);
+
+    FUZZ_CHECK(err == ref->error, "batch", "error %d, expected %d with %u threads", err, ref->error, threadCount);
+    FUZZ_CHECK(!err || index.errorOffset == ref->errorOffset, "batch", "error at %zu", index.errorOffset);
+    FUZZ_CHECK(index.count == ref->count, "batch", "%zu objects, expected %zu", index.count, ref->count);
+    for (size_t i = 0; i < index.count; ++i)
+    {
+        const TBerTlvIndexEntry *entry = &index.entries[i];
+        __compareObj("batch", &ref->objs[i], entry->offset, &entry->obj, entry->depth);
+        FUZZ_CHECK(entry->parent == BER_TLV_NO_PARENT || entry->parent < i, "batch", "parent of %zu", i);
+    }
+    free(index.entries);
+}
+
+static void __checkSoa(uint8_t *data, size_t size, const TFuzzResult *ref)
+{
+    TBerTlvSoaIndex index;
+    size_t capacity = size / 2 + 1;
+    TBerTlvObj obj;
+
+    berTlv_soaInit(&index, malloc(capacity * sizeof(uint32_t)), malloc(capacity * sizeof(uint32_t)),
+                   malloc(capacity * sizeof(uint32_t)), malloc(capacity * sizeof(uint16_t)), capacity);
+    EBerTlvError err = berTlv_soaIndex(data, size, &index);
+
+    // Deeper nesting than the index stack is reported as an overflow
+    if (err != BER_TLV_ERR_DEPTH_OVERFLOW)
+    {
+        FUZZ_CHECK(err == ref->error, "soa", "error %d, expected %d", err, ref->error);
+        FUZZ_CHECK(!err || index.errorOffset == ref->errorOffset, "soa", "error at %zu", index.errorOffset);
+        FUZZ_CHECK(index.count == ref->count, "soa", "%zu objects, expected %zu", index.count, ref->count);
+    }
+    for (size_t i = 0; i < index.count; ++i)
+    {
+        FUZZ_CHECK(berTlv_soaGet(&index, i, &obj), "soa", "entry %zu", i);
+        __compareObj("soa", &ref->objs[i], index.offsets[i], &obj, index.depths[i]);
+        FUZZ_CHECK(index.tags[i] == obj.tag && index.lengths[i] == obj.valueSize, "soa", "columns at %zu",
+                   (size_t)index.offsets[i]);
+
+        // First entry and number of entries with the tag, the scalar way
+        size_t first = i;
+        size_t count = 0;
+        for (size_t j = 0; j < index.count; ++j)
+        {
+            first = (index.tags[j] == obj.tag && j < first) ? j : first;
+            count += (index.tags[j] == obj.tag);
+        }
+        FUZZ_CHECK(berTlv_soaFind(&index, obj.tag, 0) == first && berTlv_soaFind(&index, obj.tag, i) == i, "soa",
+                   "find tag 0x%X", obj.tag);
+        FUZZ_CHECK(berTlv_soaCount(&index, obj.tag) == count, "soa", "count tag 0x%X", obj.tag);
+    }
+    // Its last byte would be followed by a fifth tag byte
+    FUZZ_CHECK(berTlv_soaFind(&index, 0xFFFFFFFF, 0) == BER_TLV_SOA_NOT_FOUND &&
+                   !berTlv_soaGet(&index, index.count, &obj),
+               "soa", "tag 0xFFFFFFFF found");
+    free(index.tags);
+    free(index.offsets);
+    free(index.lengths);
+    free(index.depths);
+}
+
+static void __checkWalker(uint8_t *data, size_t size, const TFuzzResult *ref)
+{
+    TBerTlvWalker walker;
+    TBerTlvObj obj;
+    size_t depth;
+    size_t count = 0;
+    size_t *endStack = malloc((size / 2 + 1) * sizeof(size_t));
+    EBerTlvError err;
+
+    berTlv_walkInit(&walker, data, size, endStack, size / 2 + 1);
+    while ((err = berTlv_walkNext(&walker, &obj, &depth)) == BER_TLV_OK && obj.value)
+    {
+        FUZZ_CHECK(count < ref->count, "walker", "more than %zu objects", ref->count);
+        __compareObj("walker", &ref->objs[count], obj.value - data - obj.tagSize - obj.lengthSize, &obj, depth);
+        count++;
+    }
+
+    FUZZ_CHECK(err == ref->error, "walker", "error %d, expected %d", err, ref->error);
+    FUZZ_CHECK(!err || walker.errorOffset == ref->errorOffset, "walker", "error at %zu", walker.errorOffset);
+    FUZZ_CHECK(count == ref->count, "walker", "%zu objects, expected %zu", count, ref->count);
+    free(endStack);
+}
+
+/**
+ * @brief The context functions give the results of the functions without context.
+ */
+static void __checkCtx(uint8_t *data, size_t size, const TFuzzResult *ref)
+{
+    TBerTlvCtx ctx;
+    TBerTlvObj obj;
+    TBerTlvIndex index;
+    size_t depth;
+    size_t count = 0;
+    size_t *endStack = malloc((size / 2 + 1) * sizeof(size_t));
+    EBerTlvError err;
+
+    berTlv_ctxInit(&ctx, endStack, size / 2 + 1, NULL);
+    berTlv_ctxBegin(&ctx, data, size);
+    while ((err = berTlv_ctxNext(&ctx, &obj, &depth)) == BER_TLV_OK && obj.value)
+    {
+        FUZZ_CHECK(count < ref->count, "ctx", "more than %zu objects", ref->count);
+        __compareObj("ctx", &ref->objs[count], obj.value - data - obj.tagSize - obj.lengthSize, &obj, depth);
+        count++;
+    }
+    FUZZ_CHECK(err == ref->error && ctx.error == err, "ctx", "error %d, expected %d", err, ref->error);
+    FUZZ_CHECK(!err || ctx.errorOffset == ref->errorOffset, "ctx", "error at %zu", ctx.errorOffset);
+    FUZZ_CHECK(count == ref->count, "ctx", "%zu objects, expected %zu", count, ref->count);
+
+    berTlv_indexInit(&index, malloc((size / 2 + 1) * sizeof(TBerTlvIndexEntry)), size / 2 + 1);
+    err = berTlv_ctxIndex(&ctx, data, size, &index);
+    FUZZ_CHECK(err == ref->error && index.count == ref->count, "ctx index", "error %d, expected %d", err, ref->error);
+    FUZZ_CHECK(!err || ctx.errorOffset == ref->errorOffset, "ctx index", "error at %zu", ctx.errorOffset);
+    free(index.entries);
+
+    err = berTlv_ctxValidate(&ctx, data, size);
+    FUZZ_CHECK(err == BER_TLV_ERR_DEPTH_OVERFLOW || err == ref->error, "ctx validate", "error %d, expected %d", err,
+               ref->error);
+
+    size_t length = berTlv_printToBuffer(data, size, NULL, 0);
+    char *expected = malloc(length + 1);
+    char *output = malloc(length + 1);
+    TBerTlvSink sink;
+
+    berTlv_printToBuffer(data, size, expected, length + 1);
+    berTlv_sinkInit(&sink, output, length, NULL, NULL);
+    FUZZ_CHECK(berTlv_ctxPrint(&ctx, data, size, &sink, BER_TLV_FORMAT_TEXT) == length &&
+                   !memcmp(expected, output, length),
+               "ctx print", "%zu bytes", length);
+    free(output);
+    free(expected);
+    free(endStack);
+}
+
+static void __checkIter(uint8_t *data, size_t size, const TFuzzResult *ref)
+{
+    TBerTlvIter iter;
+    TBerTlvObj obj;
+    size_t count = 0;
+    size_t *endStack = malloc((size / 2 + 1) * sizeof(size_t));
+    EBerTlvError err;
+
+    berTlv_iterBegin(&iter, data, size, endStack, size / 2 + 1);
+    while ((err = berTlv_iterNext(&iter, &obj)) == BER_TLV_OK && obj.value)
+    {
+        FUZZ_CHECK(count < ref->count, "iter", "more than %zu objects", ref->count);
+        __compareObj("iter", &ref->objs[count], iter.objOffset, &obj, iter.depth);
+        count++;
+        err = berTlv_iterEnter(&iter);
+        if (err)
+            break;
+    }
+
+    FUZZ_CHECK(err == ref->error, "iter", "error %d, expected %d", err, ref->error);
+    FUZZ_CHECK(!err || iter.errorOffset == ref->errorOffset, "iter", "error at %zu", iter.errorOffset);
+    FUZZ_CHECK(count == ref->count, "iter", "%zu objects, expected %zu", count, ref->count);
+
+    // Skipping every constructed object returns the top-level objects only
+    size_t topLevel = 0;
+    berTlv_iterBegin(&iter, data, size, endStack, size / 2 + 1);
+    while (berTlv_iterNext(&iter, &obj) == BER_TLV_OK && obj.value)
+    {
+        while (topLevel < ref->count && ref->objs[topLevel].depth)
+        {
+            topLevel++;
+        }
+        // Skipped objects may hold the error that stopped the reference
+        if (topLevel == ref->count && ref->error)
+            break;
+        FUZZ_CHECK(topLevel < ref->count, "iter", "top-level object at %zu", iter.objOffset);
+        __compareObj("iter", &ref->objs[topLevel++], iter.objOffset, &obj, 0);
+    }
+    free(endStack);
+}
+
+/**
+ * @brief The stream reads the headers before checking them against the enclosing object, so it
+ * may report another error code than the reference: only the objects and the fact that an error
+ * happened are compared. It also reports constructed objects before their value is received, so
+ * on malformed data it may report more objects, from the object that caused the error on.
+ */
+static void __checkStream(uint8_t *data, size_t size, const TFuzzResult *ref)
+{
+    TBerTlvStream stream;
+    TFuzzResult result = {malloc((size / 2 + 1) * sizeof(TFuzzObj)), 0, BER_TLV_OK, 0};
+    TFuzzStreamState state = {&stream, &result, data};
+    TBerTlvStreamLevel *stack = malloc((size / 2 + 1) * sizeof(TBerTlvStreamLevel));
+    uint8_t *valueBuffer = malloc(size ? size : 1);
+    size_t pos = 0;
+    EBerTlvError err = BER_TLV_OK;
+
+    berTlv_streamInit(&stream, stack, size / 2 + 1, valueBuffer, size, __onStreamObject, &state);
+    // Chunk sizes from the data itself, so a failing input replays the same way
+    while (pos < size && !err)
+    {
+        size_t chunkSize = 1 + data[pos] % 17;
+        if (chunkSize > size - pos)
+            chunkSize = size - pos;
+        err = berTlv_streamFeed(&stream, data + pos, chunkSize);
+        pos += chunkSize;
+    }
+    if (!err)
+        err = berTlv_streamFinish(&stream);
+
+    FUZZ_CHECK(!err == !ref->error, "stream", "error %d, expected %d", err, ref->error);
+    FUZZ_CHECK(result.count >= ref->count, "stream", "%zu objects, expected %zu", result.count, ref->count);
+    for (size_t i = 0; i < ref->count; ++i)
+    {
+        __compareObj("stream", &ref->objs[i], result.objs[i].offset, &result.objs[i].obj, result.objs[i].depth);
+    }
+    // Constructed objects whose value is not complete are already reported
+    for (size_t i = ref->count; i < result.count; ++i)
+    {
+        FUZZ_CHECK(ref->error && result.objs[i].offset >= ref->errorOffset, "stream", "object at %zu",
+                   result.objs[i].offset);
+    }
+
+    free(valueBuffer);
+    free(stack);
+    free(result.objs);
+}
+
+static bool __onStreamObject(void *userData, EBerTlvStreamEvent event, const TBerTlvObj *tlvObj, size_t depth)
+{
+    TFuzzStreamState *state = userData;
+    size_t offset = state->stream->objOffset;
+
+    // Constructed objects are compared when their header is complete
+    if (event == BER_TLV_STREAM_CONSTRUCTED_END)
+        return false;
+
+    size_t valueOffset = offset + tlvObj->tagSize + tlvObj->lengthSize;
+    FUZZ_CHECK(tlvObj->constructed || tlvObj->valueSize == 0 ||
+                   !memcmp(tlvObj->value, state->data + valueOffset, tlvObj->valueSize),
+               "stream", "value at %zu", offset);
+    __addObj(state->result, offset, tlvObj, depth);
+    return false;
+}
+
+/**
+ * @brief All printing functions write the same text, and a small buffer gets its beginning.
+ */
+static void __checkPrint(uint8_t *data, size_t size)
+{
+    size_t length = berTlv_printToBuffer(data, size, NULL, 0);
+    char *full = malloc(length + 1);
+    char *raw = malloc(length + 1);
+    size_t capacity = size ? 1 + data[0] * length / 255 : 1;
+    char *small = malloc(capacity);
+
+    FUZZ_CHECK(berTlv_printToBuffer(data, size, full, length + 1) == length, "print", "first length %zu", length);
+    FUZZ_CHECK(berTlv_printFromRawData(data, size, raw) == length && !memcmp(full, raw, length), "print",
+               "raw data output");
+    FUZZ_CHECK(berTlv_printToBuffer(data, size, small, capacity) == length, "print", "length with capacity %zu",
+               capacity);
+    FUZZ_CHECK(strlen(small) == (capacity <= length ? capacity - 1 : length) && !memcmp(full, small, strlen(small)),
+               "print", "output truncated to %zu bytes", capacity);
+
+    free(small);
+    free(raw);
+    free(full);
+
+    // Same checks of the other formats through sinks
+    for (int format = BER_TLV_FORMAT_HEX; format < BER_TLV_FORMAT_COUNT; ++format)
+    {
+        TBerTlvSink sink;
+
+        berTlv_sinkInit(&sink, NULL, 0, NULL, NULL);
+        length = berTlv_printFormatToSink(data, size, &sink, format);
+        full = malloc(length + 1);
+        small = malloc(capacity);
+        berTlv_sinkInit(&sink, full, length, NULL, NULL);
+        FUZZ_CHECK(berTlv_printFormatToSink(data, size, &sink, format) == length && !sink.truncated, "print",
+                   "format %d length %zu", format, length);
+        berTlv_sinkInit(&sink, small, capacity, NULL, NULL);
+        FUZZ_CHECK(berTlv_printFormatToSink(data, size, &sink, format) == length && !memcmp(full, small, sink.used) &&
+                       sink.used == (capacity < length ? capacity : length),
+                   "print", "format %d truncated to %zu bytes", format, capacity);
+        free(small);
+        free(full);
+    }
+}
+
+/**
+ * @brief The cached index and text are the same as without cache, when added and when found in it.
+ */
+static void __checkCache(uint8_t *data, size_t size, const TFuzzResult *ref)
+{
+    if (cache.entries == NULL)
+        berTlv_cacheInit(&cache, cacheEntries, FUZZ_CACHE_ENTRY_COUNT, cacheBuckets, FUZZ_CACHE_ENTRY_COUNT / 2,
+                         FUZZ_CACHE_BUDGET);
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        TBerTlvIndex index;
+
+        berTlv_indexInit(&index, malloc((size / 2 + 1) * sizeof(TBerTlvIndexEntry)), size / 2 + 1);
+        EBerTlvError err = berTlv_cacheIndex(&cache, data, size, &index);
+
+        FUZZ_CHECK(err == ref->error, "cache index", "error %d, expected %d at pass %d", err, ref->error, pass);
+        FUZZ_CHECK(!err || index.errorOffset == ref->errorOffset, "cache index", "error at %zu", index.errorOffset);
+        FUZZ_CHECK(index.count == ref->count, "cache index", "%zu objects, expected %zu", index.count, ref->count);
+        for (size_t i = 0; i < index.count; ++i)
+        {
+            const TBerTlvIndexEntry *entry = &index.entries[i];
+            __compareObj("cache index", &ref->objs[i], entry->offset, &entry->obj, entry->depth);
+            FUZZ_CHECK(entry->obj.value == data + entry->valueOffset, "cache index", "value pointer at %zu",
+                       entry->offset);
+            FUZZ_CHECK(entry->parent == BER_TLV_NO_PARENT ? entry->depth == 0
+                                                          : entry->parent < i &&
+                                                                index.entries[entry->parent].depth + 1 == entry->depth,
+                       "cache index", "parent of %zu", i);
+        }
+        free(index.entries);
+    }
+
+    for (int format = BER_TLV_FORMAT_TEXT; format < BER_TLV_FORMAT_COUNT; ++format)
+    {
+        TBerTlvSink sink;
+
+        berTlv_sinkInit(&sink, NULL, 0, NULL, NULL);
+        size_t length = berTlv_printFormatToSink(data, size, &sink, format);
+        char *full = malloc(length + 1);
+        char *cached = malloc(length + 1);
+
+        berTlv_sinkInit(&sink, full, length + 1, NULL, NULL);
+        berTlv_printFormatToSink(data, size, &sink, format);
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            berTlv_sinkInit(&sink, cached, length + 1, NULL, NULL);
+            FUZZ_CHECK(berTlv_cachePrint(&cache, data, size, &sink, format) == length && !memcmp(full, cached, length),
+                       "cache print", "format %d at pass %d", format, pass);
+        }
+        free(cached);
+        free(full);
+    }
+}
+
+/**
+ * @brief The extracted objects are the first ones of the reference with the requested tags.
+ */
+static void __checkExtract(uint8_t *data, size_t size, const TFuzzResult *ref)
+{
+    // Tags of a few objects spread over the data, one of them twice, and for odd sizes a tag that is not in it
+    uint32_t tags[5] = {0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF};
+    size_t first[5];
+    TBerTlvObj objs[5];
+    size_t errorOffset;
+    bool allFound = true;
+
+    for (size_t i = 0; i < 3 && ref->count; ++i)
+    {
+        tags[i] = ref->objs[(i * 7 + (size ? data[size - 1] : 0)) % ref->count].obj.tag;
+    }
+    tags[3] = tags[0];
+    tags[4] = (size % 2) ? 0xFFFFFFFF : tags[1];
+    for (size_t i = 0; i < 5; ++i)
+    {
+        first[i] = 0;
+        while (first[i] < ref->count && ref->objs[first[i]].obj.tag != tags[i])
+        {
+            first[i]++;
+        }
+        allFound &= first[i] < ref->count;
+    }
+
+    TBerTlvTagSet set;
+    berTlv_tagSetInit(&set, tags, 5);
+    EBerTlvError err = berTlv_extractSet(data, size, &set, objs, &errorOffset);
+
+    // The walk goes up to the error of the reference only if a tag is missing before
+    FUZZ_CHECK(err == (allFound ? BER_TLV_OK : ref->error), "extract", "error %d, expected %d", err, ref->error);
+    FUZZ_CHECK(!err || errorOffset == ref->errorOffset, "extract", "error at %zu, expected %zu", errorOffset,
+               ref->errorOffset);
+    for (size_t i = 0; i < 5; ++i)
+    {
+        FUZZ_CHECK((objs[i].value != NULL) == (first[i] < ref->count), "extract", "tag 0x%X found", tags[i]);
+        if (objs[i].value)
+            __compareObj("extract", &ref->objs[first[i]], ref->objs[first[i]].offset, &objs[i],
+                         ref->objs[first[i]].depth);
+    }
+
+    // With a container tag found nowhere, only the top-level objects are visited
+    if (ref->error)
+        return;
+    berTlv_tagSetAddContainer(&set, 0xFFFFFFFF);
+    err = berTlv_extractSet(data, size, &set, objs, NULL);
+    FUZZ_CHECK(!err, "extract", "error %d without entering objects", err);
+    for (size_t i = 0; i < 5; ++i)
+    {
+        size_t topLevel = 0;
+        while (topLevel < ref->count && (ref->objs[topLevel].depth || ref->objs[topLevel].obj.tag != tags[i]))
+        {
+            topLevel++;
+        }
+        FUZZ_CHECK((objs[i].value != NULL) == (topLevel < ref->count), "extract", "top-level tag 0x%X found",
+                   tags[i]);
+        if (objs[i].value)
+            __compareObj("extract", &ref->objs[topLevel], ref->objs[topLevel].offset, &objs[i], 0);
+    }
+}
+
+/**
+ * @brief Index and text allocated from arenas are the same as without arena, in a fresh and in a reset arena.
+ */
+static void __checkArena(uint8_t *data, size_t size, const TFuzzResult *ref)
+{
+    TBerTlvArena arena;
+    size_t expectedLength = berTlv_printToBuffer(data, size, NULL, 0);
+    char *expected = malloc(expectedLength + 1);
+
+    berTlv_printToBuffer(data, size, expected, expectedLength + 1);
+    berTlv_arenaInitGrowable(&arena, FUZZ_ARENA_BLOCK_SIZE);
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        TBerTlvIndex index;
+        size_t length = 0;
+
+        FUZZ_CHECK(berTlv_arenaIndexInit(&arena, &index, size / 2 + 1, 16) == BER_TLV_OK, "arena", "index at pass %d",
+                   pass);
+        EBerTlvError err = berTlv_index(data, size, &index);
+        // A full tag table is not an error of the reference
+        if (err != BER_TLV_ERR_NO_SPACE)
+        {
+            FUZZ_CHECK(err == ref->error, "arena", "error %d, expected %d", err, ref->error);
+            FUZZ_CHECK(index.count == ref->count, "arena", "%zu objects, expected %zu", index.count, ref->count);
+        }
+        for (size_t i = 0; i < index.count; ++i)
+        {
+            __compareObj("arena", &ref->objs[i], index.entries[i].offset, &index.entries[i].obj, index.entries[i].depth);
+        }
+
+        char *text = berTlv_arenaPrint(&arena, data, size, &length);
+        FUZZ_CHECK(text && length == expectedLength && strlen(text) == length && !memcmp(text, expected, length), "arena",
+                   "print of %zu bytes at pass %d", length, pass);
+        berTlv_arenaReset(&arena);
+    }
+    berTlv_arenaFree(&arena);
+
+    // A fixed arena gives the whole text or nothing
+    uint64_t buffer[64];
+    size_t length = 0;
+    berTlv_arenaInit(&arena, buffer, sizeof(buffer) - (size ? data[0] % sizeof(buffer) : 0));
+    char *text = berTlv_arenaPrint(&arena, data, size, &length);
+    FUZZ_CHECK(!text || (length == expectedLength && !strcmp(text, expected)), "arena", "print in a fixed arena");
+    free(expected);
+}
+
+/**
+ * @brief The records of a mapped file are the top-level objects of the reference.
+ */
+static void __checkFile(uint8_t *data, size_t size, const TFuzzResult *ref)
+{
+    char path[32];
+    TBerTlvFile file;
+    TBerTlvObj record;
+    size_t next = 0;
+
+    if (inputFile == NULL)
+        inputFile = tmpfile();
+    FUZZ_CHECK(inputFile && !ftruncate(fileno(inputFile), 0) && pwrite(fileno(inputFile), data, size, 0) == (ssize_t)size,
+               "file", "temporary file not written");
+    snprintf(path, sizeof(path), "/dev/fd/%d", fileno(inputFile));
+    FUZZ_CHECK(!berTlv_fileOpen(&file, path) && file.size == size, "file", "%zu bytes mapped, expected %zu", file.size,
+               size);
+
+    while (berTlv_fileNextRecord(&file, &record))
+    {
+        while (next < ref->count && ref->objs[next].depth)
+        {
+            next++;
+        }
+        size_t offset = record.value - file.data - record.lengthSize - record.tagSize;
+        // The reference stops at the first error, also inside a record, the file only checks the top level
+        if (ref->error && (next == ref->count || offset >= ref->errorOffset))
+            break;
+        FUZZ_CHECK(next < ref->count, "file", "record at %zu not in the reference", offset);
+        __compareObj("file", &ref->objs[next++], offset, &record, 0);
+        FUZZ_CHECK(!memcmp(record.value, data + (record.value - file.data), record.valueSize), "file",
+                   "value of the record at %zu", offset);
+    }
+    if (!ref->error)
+    {
+        while (next < ref->count && ref->objs[next].depth)
+        {
+            next++;
+        }
+        FUZZ_CHECK(!file.error && next == ref->count, "file", "error %d, %zu records missing", file.error,
+                   ref->count - next);
+    }
+    else if (file.error && file.errorOffset <= ref->errorOffset)
+    {
+        FUZZ_CHECK(file.error == ref->error && file.errorOffset == ref->errorOffset, "file",
+                   "error %d at %zu, expected %d at %zu", file.error, file.errorOffset, ref->error, ref->errorOffset);
+    }
+    berTlv_fileClose(&file);
+}
+
+/**
+ * @brief The walk of the schema extractors visits the objects of the reference, each checked against its parent.
+ */
+static void __checkSchemaWalk(uint8_t *data, size_t size, const TFuzzResult *ref)
+{
+    TBerTlvSchemaWalk walk;
+    TBerTlvObj obj;
+    size_t count = 0;
+    EBerTlvError err;
+
+    berTlv_schemaWalkInit(&walk, data, size);
+    while ((err = berTlv_schemaWalkNext(&walk, &obj)) == BER_TLV_OK && obj.value)
+    {
+        size_t offset = obj.value - data - obj.tagSize - obj.lengthSize;
+        FUZZ_CHECK(count < ref->count, "schema walk", "object at %zu not in the reference", offset);
+        __compareObj("schema walk", &ref->objs[count++], offset, &obj, walk.depth - obj.constructed);
+    }
+    // Deeper nesting than the walk stack is reported as an overflow
+    if (err == BER_TLV_ERR_DEPTH_OVERFLOW)
+        return;
+    FUZZ_CHECK(err == ref->error, "schema walk", "error %d, expected %d", err, ref->error);
+    FUZZ_CHECK(!err || walk.position == ref->errorOffset, "schema walk", "error at %zu, expected %zu", walk.position,
+               ref->errorOffset);
+    FUZZ_CHECK(count == ref->count, "schema walk", "%zu objects, expected %zu", count, ref->count);
+}
+
+/**
+ * @brief Valid data rebuilt from its objects parses to the same objects.
+ */
+static void __checkBuilder(uint8_t *data, size_t size, const TFuzzResult *ref)
+{
+    TBerTlvBuilder builder;
+    size_t *openStack = malloc((size / 2 + 1) * sizeof(size_t));
+    // Minimum length forms and no garbage data make the rebuilt data at most as large
+    uint8_t *buffer = malloc(size ? size : 1);
+    size_t builtSize;
+
+    // Rebuilt from the objects of the reference only
+    (void)data;
+    berTlv_builderInit(&builder, buffer, size, openStack, size / 2 + 1);
+    for (size_t i = 0; i < ref->count; ++i)
+    {
+        const TFuzzObj *fuzzObj = &ref->objs[i];
+        while (builder.depth > fuzzObj->depth && !builder.error)
+        {
+            berTlv_builderClose(&builder);
+        }
+        if (fuzzObj->obj.constructed)
+            berTlv_builderOpen(&builder, fuzzObj->obj.tag, fuzzObj->obj.valueSize);
+        else
+            berTlv_builderAdd(&builder, fuzzObj->obj.tag, fuzzObj->obj.value, fuzzObj->obj.valueSize);
+    }
+    EBerTlvError err = berTlv_builderFinish(&builder, &builtSize);
+    FUZZ_CHECK(err == BER_TLV_OK, "builder", "error %d", err);
+
+    TFuzzResult result = {malloc((builtSize / 2 + 1) * sizeof(TFuzzObj)), 0, BER_TLV_OK, 0};
+    __reference(buffer, builtSize, &result);
+    FUZZ_CHECK(result.error == BER_TLV_OK && result.count == ref->count, "builder", "%zu objects rebuilt, expected %zu",
+               result.count, ref->count);
+    for (size_t i = 0; i < result.count; ++i)
+    {
+        const TBerTlvObj *obj = &result.objs[i].obj;
+        const TBerTlvObj *refObj = &ref->objs[i].obj;
+        FUZZ_CHECK(obj->tag == refObj->tag && result.objs[i].depth == ref->objs[i].depth, "builder", "object %zu", i);
+        // Constructed values shrink when the original data has longer length forms than needed
+        FUZZ_CHECK(obj->constructed || (obj->valueSize == refObj->valueSize &&
+                                        (!obj->valueSize || !memcmp(obj->value, refObj->value, obj->valueSize))),
+                   "builder", "value of object %zu", i);
+    }
+
+    free(result.objs);
+    free(buffer);
+    free(openStack);
+}
+
+/**
+ * @brief A patched index is the same as the index of the patched data.
+ */
+static void __checkPatch(uint8_t *data, size_t size, const TFuzzResult *ref)
+{
+    size_t target = 0;
+    while (target < ref->count && ref->objs[target].obj.constructed)
+    {
+        target++;
+    }
+    if (target == ref->count)
+        return;
+
+    // New value size from the data, crossing the length form boundaries
+    size_t valueSize = size ? (data[size - 1] * 7u) % 300 : 0;
+    // Each enclosing object may get up to 4 more length bytes
+    size_t capacity = size + valueSize + 4 * (size / 2 + 1);
+    uint8_t *buffer = malloc(capacity);
+    uint8_t *value = malloc(valueSize ? valueSize : 1);
+    TBerTlvIndex index;
+    TBerTlvIndex patched;
+
+    memcpy(buffer, data, size);
+    memset(value, 0x5A, valueSize);
+    berTlv_indexInit(&index, malloc((size / 2 + 1) * sizeof(TBerTlvIndexEntry)), size / 2 + 1);
+    berTlv_index(buffer, size, &index);
+
+    EBerTlvError err = berTlv_patchValue(&index, target, value, valueSize, capacity);
+    if (err == BER_TLV_OK)
+    {
+        berTlv_indexInit(&patched, malloc((index.size / 2 + 1) * sizeof(TBerTlvIndexEntry)), index.size / 2 + 1);
+        FUZZ_CHECK(berTlv_index(buffer, index.size, &patched) == BER_TLV_OK && patched.count == index.count, "patch",
+                   "%zu objects after the patch, expected %zu", patched.count, index.count);
+        for (size_t i = 0; i < index.count; ++i)
+        {
+            const TBerTlvIndexEntry *entry = &index.entries[i];
+            const TBerTlvIndexEntry *expected = &patched.entries[i];
+            FUZZ_CHECK(entry->offset == expected->offset && entry->valueOffset == expected->valueOffset &&
+                           entry->end == expected->end && entry->parent == expected->parent,
+                       "patch", "entry %zu", i);
+            FUZZ_CHECK(entry->obj.value == expected->obj.value && entry->obj.valueSize == expected->obj.valueSize &&
+                           entry->obj.lengthSize == expected->obj.lengthSize &&
+                           entry->obj.lengthValue == expected->obj.lengthValue,
+                       "patch", "object of entry %zu", i);
+        }
+        FUZZ_CHECK(!valueSize || !memcmp(index.entries[target].obj.value, value, valueSize), "patch", "new value");
+        free(patched.entries);
+    }
+    else
+    {
+        FUZZ_CHECK(err == BER_TLV_ERR_DEPTH_OVERFLOW, "patch", "error %d", err);
+    }
+
+    free(index.entries);
+    free(value);
+    free(buffer);
+}
+
+#ifndef BER_TLV_FUZZ_LIBFUZZER
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Regression cases------------------------------------------------------//
+
+/**
+ * @brief Run the cases of the bugs found so far, the inputs they need are not generated.
+ */
+static void __regressions(void)
+{
+    __regressionArenaPrint();
+    __regressionFileOpen();
+    __regressionPipeline();
+    __regressionSchema();
+    __regressionCacheOffset();
+    __regressionBatchShares();
+    __regressionBuilderTags();
+}
+
+/**
+ * @brief The first text printed in a growable arena, before any block is allocated, is complete.
+ */
+static void __regressionArenaPrint(void)
+{
+    uint8_t data[] = {0x70, 0x08, 0x5A, 0x02, 0x12, 0x34, 0x9F, 0x02, 0x01, 0x56};
+    size_t expectedLength = berTlv_printToBuffer(data, sizeof(data), NULL, 0);
+    TBerTlvArena arena;
+    size_t length = 0;
+
+    berTlv_arenaInitGrowable(&arena, FUZZ_ARENA_BLOCK_SIZE);
+    char *text = berTlv_arenaPrint(&arena, data, sizeof(data), &length);
+    FUZZ_CHECK(text && length == expectedLength && strlen(text) == length, "arena",
+               "first print of %zu bytes in a fresh arena, %zu expected", text ? strlen(text) : 0, expectedLength);
+    berTlv_arenaFree(&arena);
+}
+
+/**
+ * @brief A file that can't be opened or mapped is left closed, and closing it does not close a reused descriptor.
+ * An empty file has no records.
+ */
+static void __regressionFileOpen(void)
+{
+    TBerTlvFile file;
+    TBerTlvObj record;
+
+    FUZZ_CHECK(berTlv_fileOpen(&file, "/nonexistent/ber_tlv_fuzz") && file.fd == -1 && file.data == NULL, "file",
+               "missing file opened");
+    berTlv_fileClose(&file);
+
+    // A directory is opened but can't be mapped
+    if (berTlv_fileOpen(&file, "/"))
+    {
+        FUZZ_CHECK(file.fd == -1 && file.data == NULL, "file", "descriptor %d kept after a mapping error", file.fd);
+        int reused = open("/dev/null", O_RDONLY);
+        berTlv_fileClose(&file);
+        FUZZ_CHECK(fcntl(reused, F_GETFD) != -1, "file", "reused descriptor %d closed", reused);
+        close(reused);
+    }
+    else
+    {
+        berTlv_fileClose(&file);
+    }
+
+    char path[32];
+    FILE *empty = tmpfile();
+    snprintf(path, sizeof(path), "/dev/fd/%d", empty ? fileno(empty) : -1);
+    FUZZ_CHECK(empty && !berTlv_fileOpen(&file, path) && file.size == 0, "file", "empty file not opened");
+    FUZZ_CHECK(!berTlv_fileNextRecord(&file, &record) && file.error == BER_TLV_OK, "file", "record in an empty file");
+    berTlv_fileClose(&file);
+    FUZZ_CHECK(file.fd == -1, "file", "empty file not closed");
+    fclose(empty);
+}
+
+/**
+ * @brief The pipeline gives the objects of berTlv_index() over the same file, with io_uring (or its epoll
+ * fallback) and with epoll, records split between two reads included.
+ */
+static void __regressionPipeline(void)
+{
+    static uint8_t data[FUZZ_PIPELINE_FILE_SIZE];
+    static uint8_t record[FUZZ_MAX_GENERATED_SIZE];
+    static uint8_t pool[FUZZ_PIPELINE_BUFFER_COUNT * FUZZ_PIPELINE_BUFFER_SIZE];
+    size_t size = 0;
+
+    // Valid generated records up to the file size
+    for (;;)
+    {
+        size_t recordSize = __genObjects(record, sizeof(record), 0);
+        if (size + recordSize > sizeof(data))
+            break;
+        if (berTlv_validate(record, recordSize, NULL) == BER_TLV_OK)
+        {
+            memcpy(data + size, record, recordSize);
+            size += recordSize;
+        }
+    }
+
+    TBerTlvIndex index;
+    berTlv_indexInit(&index, malloc((size / 2 + 1) * sizeof(TBerTlvIndexEntry)), size / 2 + 1);
+    FUZZ_CHECK(berTlv_index(data, size, &index) == BER_TLV_OK, "pipeline", "generated file not indexed");
+
+    FILE *file = tmpfile();
+    FUZZ_CHECK(file && fwrite(data, 1, size, file) == size && !fflush(file), "pipeline", "file not written");
+    for (int useIoUring = 1; useIoUring >= 0; --useIoUring)
+    {
+        TBerTlvPipeline pipeline;
+        TFuzzPipelineState state = {malloc(index.count * sizeof(TFuzzObj)), 0, index.count, 0};
+        const char *engine = useIoUring ? "pipeline io_uring" : "pipeline epoll";
+
+        lseek(fileno(file), 0, SEEK_SET);
+        berTlv_pipelineInit(&pipeline, pool, FUZZ_PIPELINE_BUFFER_SIZE, FUZZ_PIPELINE_BUFFER_COUNT, 2,
+                            __onPipelineIndex, &state);
+        pipeline.useIoUring = useIoUring;
+        berTlv_pipelineAddSource(&pipeline, fileno(file), NULL);
+        EBerTlvError err = berTlv_pipelineRun(&pipeline);
+
+        FUZZ_CHECK(err == BER_TLV_OK && !state.errorCount, engine, "error %d, %zu chunks with an error", err,
+                   state.errorCount);
+        FUZZ_CHECK(pipeline.sources[0].position == size, engine, "%zu bytes read, expected %zu",
+                   pipeline.sources[0].position, size);
+        FUZZ_CHECK(state.count == index.count, engine, "%zu objects, expected %zu", state.count, index.count);
+        qsort(state.objs, state.count, sizeof(TFuzzObj), __compareOffset);
+        for (size_t i = 0; i < state.count; ++i)
+        {
+            const TBerTlvIndexEntry *entry = &index.entries[i];
+            TFuzzObj expected = {entry->offset, entry->obj, entry->depth};
+            __compareObj(engine, &expected, state.objs[i].offset, &state.objs[i].obj, state.objs[i].depth);
+        }
+        free(state.objs);
+    }
+    fclose(file);
+    free(index.entries);
+}
+
+/**
+ * @brief Pipeline callback keeping the indexed objects with their stream offset.
+ */
+static bool __onPipelineIndex(void *userData, size_t source, size_t streamOffset, EBerTlvError error,
+                              const TBerTlvIndex *index)
+{
+    TFuzzPipelineState *state = userData;
+
+    (void)source;
+    if (error)
+        __atomic_fetch_add(&state->errorCount, 1, __ATOMIC_RELAXED);
+    size_t first = __atomic_fetch_add(&state->count, index->count, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < index->count && first + i < state->capacity; ++i)
+    {
+        const TBerTlvIndexEntry *entry = &index->entries[i];
+        TFuzzObj *fuzzObj = &state->objs[first + i];
+
+        fuzzObj->offset = streamOffset + entry->offset;
+        fuzzObj->obj = entry->obj;
+        // The value points into a pool buffer that is read again after the callback
+        fuzzObj->obj.value = NULL;
+        fuzzObj->depth = entry->depth;
+    }
+    return false;
+}
+
+static int __compareOffset(const void *a, const void *b)
+{
+    size_t offsetA = ((const TFuzzObj *)a)->offset;
+    size_t offsetB = ((const TFuzzObj *)b)->offset;
+    return (offsetA > offsetB) - (offsetA < offsetB);
+}
+
+/**
+ * @brief A child that overruns its parent but not its record is rejected by the schema extractors as by the index,
+ * and the tag encoding checks look at every subsequent tag byte.
+ */
+static void __regressionSchema(void)
+{
+    // The 3 bytes value of 0x5A is in the record, not in its 2 bytes parent 0xE1
+    uint8_t data[] = {0x70, 0x07, 0xE1, 0x02, 0x5A, 0x03, 0x11, 0x22, 0x33};
+    TFuzzSchemaFields fields;
+    TBerTlvIndex index;
+    TBerTlvIndexEntry entries[8];
+    size_t errorOffset = 0;
+
+    berTlv_indexInit(&index, entries, 8);
+    EBerTlvError expected = berTlv_index(data, sizeof(data), &index);
+    EBerTlvError err = __fuzzSchemaExtract(data, sizeof(data), &fields, &errorOffset);
+    FUZZ_CHECK(expected == BER_TLV_ERR_TRUNCATED_VALUE && err == expected && errorOffset == index.errorOffset,
+               "schema", "error %d at %zu, expected %d at %zu", err, errorOffset, expected, index.errorOffset);
+    FUZZ_CHECK(fields.pan.data == NULL, "schema", "value of a child overrunning its parent extracted");
+
+    // Sibling after a nested constructed object, at the level of its parent
+    uint8_t nested[] = {0x70, 0x09, 0xE1, 0x02, 0xE1, 0x00, 0x5A, 0x03, 0x11, 0x22, 0x33};
+    FUZZ_CHECK(__fuzzSchemaExtract(nested, sizeof(nested), &fields, NULL) == BER_TLV_OK && fields.pan.size == 3 &&
+                   fields.container.size == 2,
+               "schema", "sibling of a nested constructed object");
+
+    FUZZ_CHECK(BER_TLV_TAG_IS_WELL_FORMED(0x5A) && BER_TLV_TAG_IS_WELL_FORMED(0x9F02) &&
+                   BER_TLV_TAG_IS_WELL_FORMED(0xDF8101) && BER_TLV_TAG_IS_WELL_FORMED(0xFF818201),
+               "schema", "well formed tag rejected");
+    FUZZ_CHECK(!BER_TLV_TAG_IS_WELL_FORMED(0x1F) && !BER_TLV_TAG_IS_WELL_FORMED(0x5A01) &&
+                   !BER_TLV_TAG_IS_WELL_FORMED(0x9F81) && !BER_TLV_TAG_IS_WELL_FORMED(0xDF0101) &&
+                   !BER_TLV_TAG_IS_WELL_FORMED(0xFF810201),
+               "schema", "tag with a bad subsequent byte accepted");
+}
+
+/**
+ * @brief The text of an object cached at one offset is the text printed without cache at another one, and is
+ * counted as formatted text. JSON lines, which hold the offsets, don't use the cache.
+ */
+static void __regressionCacheOffset(void)
+{
+    uint8_t first[] = {0x70, 0x13, 0x5A, 0x08, 0x47, 0x61, 0x73, 0x90, 0x01, 0x01, 0x00, 0x10,
+                       0x9F, 0x02, 0x06, 0x00, 0x00, 0x00, 0x01, 0x23, 0x45};
+    // Same record after padding and another record
+    uint8_t second[3 + 4 + sizeof(first)] = {0x00, 0x00, 0xFF, 0x82, 0x02, 0x19, 0x80};
+    TBerTlvCache offsetCache;
+    TBerTlvCacheEntry entries[8];
+    size_t buckets[4];
+
+    memcpy(second + 7, first, sizeof(first));
+    FUZZ_CHECK(berTlv_validate(second, sizeof(second), NULL) == BER_TLV_OK, "cache print", "invalid records");
+    berTlv_cacheInit(&offsetCache, entries, 8, buckets, 4, 4096);
+    for (int format = BER_TLV_FORMAT_TEXT; format < BER_TLV_FORMAT_COUNT; ++format)
+    {
+        char expected[1024];
+        char cached[1024];
+        TBerTlvSink sink;
+
+        berTlv_sinkInit(&sink, expected, sizeof(expected), NULL, NULL);
+        size_t length = berTlv_printFormatToSink(second, sizeof(second), &sink, format);
+        berTlv_sinkInit(&sink, cached, sizeof(cached), NULL, NULL);
+        berTlv_cachePrint(&offsetCache, first, sizeof(first), &sink, format);
+
+        uint64_t hits = offsetCache.hits;
+        size_t used = offsetCache.used;
+        TBerTlvStats stats;
+        berTlv_statsReset();
+        berTlv_sinkInit(&sink, cached, sizeof(cached), NULL, NULL);
+        FUZZ_CHECK(berTlv_cachePrint(&offsetCache, second, sizeof(second), &sink, format) == length &&
+                       !memcmp(cached, expected, length),
+                   "cache print", "format %d of a record cached at another offset", format);
+        // Also the cached text is formatted text, the counters are all 0 without BER_TLV_STATS
+        berTlv_statsGet(&stats);
+        FUZZ_CHECK(stats.bytesFormatted == 0 || stats.bytesFormatted == length, "cache print",
+                   "%llu formatted bytes counted, %zu printed", (unsigned long long)stats.bytesFormatted, length);
+        if (format == BER_TLV_FORMAT_JSON)
+        {
+            FUZZ_CHECK(offsetCache.hits == hits && offsetCache.used == used, "cache print", "JSON lines cached");
+        }
+        else
+        {
+            FUZZ_CHECK(offsetCache.hits == hits + 1, "cache print", "format %d not found in the cache", format);
+        }
+    }
+    berTlv_cacheClear(&offsetCache);
+}
+
+/**
+ * @brief An index of size / 2 entries holds a batch however the objects are spread over the chunks.
+ */
+static void __regressionBatchShares(void)
+{
+    // The first chunk holds an object in its 2 bytes
+    uint8_t data[] = {0x01, 0x00, 0x02, 0x01, 0x00};
+    TBerTlvIndex index;
+    TBerTlvIndexEntry entries[sizeof(data) / 2];
+
+    for (unsigned threadCount = 1; threadCount <= 3; ++threadCount)
+    {
+        berTlv_indexInit(&index, entries, sizeof(data) / 2);
+        EBerTlvError err = berTlv_batchIndex(data, sizeof(data), &index, threadCount);
+        FUZZ_CHECK(err == BER_TLV_OK && index.count == 2 && index.entries[1].offset == 2, "batch",
+                   "error %d with %zu objects and %u threads", err, index.count, threadCount);
+    }
+
+    // Too small for the shares of both chunks
+    berTlv_indexInit(&index, entries, 1);
+    uint8_t single[] = {0x01, 0x00, 0x00, 0x00, 0x00};
+    EBerTlvError err = berTlv_batchIndex(single, sizeof(single), &index, 2);
+    FUZZ_CHECK(err == BER_TLV_OK && index.count == 1, "batch", "error %d in a small index", err);
+}
+
+/**
+ * @brief The builder writes only tags that read back: well formed, not starting with a padding byte, and
+ * constructed for the opened objects.
+ */
+static void __regressionBuilderTags(void)
+{
+    static const uint32_t badTags[] = {0x00, 0x1F, 0x9F81, 0x5A01, 0xFF01, 0xDF0101};
+    static const uint32_t primitiveTags[] = {0x5A, 0x9F02, 0xDF8101};
+    uint8_t buffer[16];
+    size_t openStack[2];
+    TBerTlvBuilder builder;
+
+    for (size_t i = 0; i < sizeof(badTags) / sizeof(badTags[0]); ++i)
+    {
+        berTlv_builderInit(&builder, buffer, sizeof(buffer), openStack, 2);
+        EBerTlvError err = berTlv_builderAdd(&builder, badTags[i], buffer, 1);
+        FUZZ_CHECK(err == BER_TLV_ERR_INVALID_ARGUMENT && builder.size == 0, "builder", "tag 0x%X written",
+                   (unsigned)badTags[i]);
+        berTlv_builderInit(&builder, buffer, sizeof(buffer), openStack, 2);
+        FUZZ_CHECK(berTlv_builderReserve(&builder, badTags[i], 1) == NULL && builder.size == 0, "builder",
+                   "tag 0x%X reserved", (unsigned)badTags[i]);
+    }
+    for (size_t i = 0; i < sizeof(primitiveTags) / sizeof(primitiveTags[0]); ++i)
+    {
+        berTlv_builderInit(&builder, buffer, sizeof(buffer), openStack, 2);
+        EBerTlvError err = berTlv_builderOpen(&builder, primitiveTags[i], 0);
+        FUZZ_CHECK(err == BER_TLV_ERR_INVALID_ARGUMENT && builder.size == 0 && builder.depth == 0, "builder",
+                   "primitive tag 0x%X opened", (unsigned)primitiveTags[i]);
+    }
+
+    // Padding is only skipped between top-level objects
+    size_t size = 0;
+    berTlv_builderInit(&builder, buffer, sizeof(buffer), openStack, 2);
+    berTlv_builderOpen(&builder, 0xBF8101, 6);
+    berTlv_builderAdd(&builder, 0x9F02, buffer, 1);
+    berTlv_builderAdd(&builder, 0x00, NULL, 0);
+    FUZZ_CHECK(berTlv_builderFinish(&builder, &size) == BER_TLV_OK && size == 10, "builder",
+               "well formed tags rejected");
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------//
+//-------------------------------------------------------Corpus generation-----------------------------------------------------//
+
+/**
+ * @brief Xorshift random number in [0, max)
+ */
+static uint32_t __random(uint32_t max)
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return (uint32_t)(randomState >> 32) % max;
+}
+
+/**
+ * @brief Write random objects: 1 to 4 tag bytes, short or long length forms, not always the
+ * minimum one, and nested constructed objects.
+ * @return Bytes written.
+ */
+static size_t __genObjects(uint8_t *buf, size_t capacity, size_t depth)
+{
+    size_t size = 0;
+    uint32_t count = 1 + __random(depth ? 4 : 8);
+
+    for (uint32_t n = 0; n < count; ++n)
+    {
+        // Room for the largest header
+        if (capacity - size < 16)
+            break;
+
+        uint8_t *header = buf + size;
+        bool constructed = depth < FUZZ_MAX_GENERATED_DEPTH && __random(3) == 0;
+        uint8_t tagSize = (__random(4) == 0) ? 1 + __random(4) : 1;
+        size_t headerSize = 0;
+
+        // Class and type bits, then subsequent tag bytes with bit b8 set but the last one
+        uint8_t firstTagByte = (__random(4) << 6) | (constructed ? 0x20 : 0);
+        firstTagByte |= (tagSize > 1) ? 0x1F : 1 + __random(0x1E);
+        header[headerSize++] = firstTagByte;
+        for (uint8_t i = 1; i < tagSize; ++i)
+        {
+            header[headerSize++] = (i + 1 < tagSize ? 0x80 : 0) | (1 + __random(0x7F));
+        }
+
+        // Length form chosen before the value size is known, fixed up below
+        uint8_t subsequentLengthBytes = (__random(3) == 0) ? 1 + __random(4) : 0;
+        size_t lengthOffset = headerSize;
+        headerSize += 1 + subsequentLengthBytes;
+
+        size_t available = capacity - size - headerSize;
+        size_t maxValueSize = subsequentLengthBytes ? available : (available < 0x7F ? available : 0x7F);
+        size_t valueSize;
+        if (constructed)
+        {
+            valueSize = __genObjects(header + headerSize, maxValueSize, depth + 1);
+        }
+        else
+        {
+            valueSize = __random(subsequentLengthBytes ? 300 : 0x80);
+            if (valueSize > maxValueSize)
+                valueSize = maxValueSize;
+            for (size_t i = 0; i < valueSize; ++i)
+            {
+                header[headerSize + i] = __random(256);
+            }
+        }
+
+        if (subsequentLengthBytes)
+        {
+            header[lengthOffset] = 0x80 | subsequentLengthBytes;
+            for (uint8_t i = subsequentLengthBytes; i > 0; --i)
+            {
+                header[lengthOffset + i] = (valueSize >> (8 * (subsequentLengthBytes - i))) & 0xFF;
+            }
+        }
+        else
+        {
+            header[lengthOffset] = valueSize;
+        }
+        size += headerSize + valueSize;
+
+        // Garbage data is only allowed between top-level objects
+        if (depth == 0 && __random(3) == 0)
+        {
+            size_t padding = __random(48);
+            uint8_t padByte = __random(2) ? 0x00 : 0xFF;
+            if (padding > capacity - size)
+                padding = capacity - size;
+            memset(buf + size, padByte, padding);
+            size += padding;
+        }
+    }
+    return size;
+}
+
+/**
+ * @brief Write a random input, sometimes malformed.
+ * @return Input size in bytes.
+ */
+static size_t __genInput(uint8_t *buf, size_t capacity)
+{
+    size_t size = __genObjects(buf, capacity, 0);
+
+    switch (__random(8))
+    {
+    case 0:
+        // Truncated anywhere
+        if (size)
+            size = __random(size);
+        break;
+    case 1:
+        // One corrupted byte, which may be a tag or a length byte
+        if (size)
+            buf[__random(size)] = __random(256);
+        break;
+    case 2:
+        // Indefinite length form, or too many tag or length bytes
+        if (size > 2)
+            buf[1 + __random(size - 1)] = (__random(2) ? 0x80 : 0x85 + __random(0x7B));
+        break;
+    default:
+        break;
+    }
+    return size;
+}
+#endif